@@ -75,17 +75,13 @@ void Connection::ConnectionFailed(ConnectionFailedReason reason){
 
 void Connection::ConnectionClosed(){
 	if(GetParentServer()){
-		const denServer::Connections &connections = GetParentServer()->GetConnections();
-		denServer::Connections::const_iterator iter;
-		for(iter = connections.cbegin(); iter != connections.cend(); iter++){
-			if(iter->get() != this){
-				denMessage::Ref lm(denMessage::Pool().Get());
-				denMessageWriter(lm->Item())
-					.WriteByte((uint8_t)MessageCode::dropClient)
-					.WriteUShort((uint16_t)id);
-				(*iter)->SendReliableMessage(lm);
-			}
-		}
+		denMessage::Ref lm(denMessage::Pool().Get());
+		denMessageWriter(lm->Item())
+			.WriteByte((uint8_t)MessageCode::dropClient)
+			.WriteUShort((uint16_t)id);
+		GetParentServer()->BroadcastReliable(lm, [this](const denConnection &connection){
+			return &connection != this;
+		});
 		
 	}else{
 		app.quit = true;
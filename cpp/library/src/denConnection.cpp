@@ -35,8 +35,24 @@
 
 // #define DO_SPECIAL_DEBUG
 
+// default datagram size. long message parts of 1357 bytes plus 4 bytes header
+static const int vDefaultDatagramSize = 1361;
+
+// probed path MTU sizes excluding IP and UDP headers. covers IPv6 minimum MTU, common
+// tunnel MTUs, PPPoE, ethernet and jumbo frames for IPv6 and IPv4. larger sizes possible
+// on loopback are not probed. a full reliable window of such datagrams overflows the
+// socket send buffer
+static const int vMtuProbeSizes[] = {1232, 1372, 1392, 1452, 1464, 1472, 8952, 8972};
+static const int vMtuProbeSizeCount = sizeof(vMtuProbeSizes) / sizeof(int);
+static const int vMtuProbeAttempts = 3;
+
 denConnection::denConnection() :
+pConnectCookie(0),
 pConnectionState(ConnectionState::disconnected),
+pMemoryTransport(false),
+pPeerSocket(false),
+pResolveAsync(false),
+pAddressResolver(denAddressResolver::Shared()),
 pConnectResendInterval(1.0f),
 pConnectTimeout(5.0f),
 pReliableResendInterval(0.5f),
@@ -45,10 +61,18 @@ pElapsedConnectResend(0.0f),
 pElapsedConnectTimeout(0.0f),
 pProtocol(denProtocol::Protocols::DENetworkProtocol),
 pNextLinkIdentifier(0),
+pWriteLinkUpdatesPending(false),
 pReliableNumberSend(0),
 pReliableNumberRecv(0),
 pReliableWindowSize(10),
-pLongMessagePartSize(1357),
+pDatagramSize(vDefaultDatagramSize),
+pReceiveBatchSize(16),
+pPathMtuDiscovery(false),
+pMtuProbePending(false),
+pMtuProbeAttempt(0),
+pMtuProbeAcked(0),
+pMtuProbeLimit(0),
+pElapsedMtuProbe(0.0f),
 pParentServer(nullptr){
 }
 
@@ -73,6 +97,18 @@ void denConnection::SetReliableTimeout(float timeout){
 	pReliableTimeout = std::max(timeout, 0.01f);
 }
 
+void denConnection::SetResolveAsync(bool resolveAsync){
+	pResolveAsync = resolveAsync;
+}
+
+void denConnection::SetAddressResolver(const denAddressResolver::Ref &resolver){
+	pAddressResolver = resolver ? resolver : denAddressResolver::Shared();
+}
+
+void denConnection::SetPathMtuDiscovery(bool discovery){
+	pPathMtuDiscovery = discovery;
+}
+
 void denConnection::SetLogger(const denLogger::Ref &logger){
 	pLogger = logger;
 }
@@ -82,30 +118,55 @@ void denConnection::ConnectTo(const std::string &address){
 		throw std::invalid_argument("already connected");
 	}
 	
-	const denSocketAddress realRemoteAddress(ResolveAddress(address));
+	if(!pResolveAsync){
+		const denSocketAddress realRemoteAddress(ResolveAddress(address));
+		pRemoteAddress = address;
+		pElapsedConnectTimeout = 0.0f;
+		pConnectToAddress(realRemoteAddress);
+		return;
+	}
+	
+	pResolveRequest = pAddressResolver->ResolveAsync(address);
+	pRemoteAddress = address;
+	pConnectionState = ConnectionState::connecting;
+	pElapsedConnectResend = 0.0f;
+	pElapsedConnectTimeout = 0.0f;
+	
+	if(pLogger){
+		std::stringstream s;
+		s << "Connection: Resolving " << address;
+		pLogger->Log(denLogger::LogSeverity::info, s.str());
+	}
 	
+	if(pResolveRequest->IsFinished()){
+		pFinishResolve(); // cached
+	}
+}
+
+void denConnection::pConnectToAddress(const denSocketAddress &realRemoteAddress){
+	pMemoryTransport = realRemoteAddress.type == denSocketAddress::Type::memory;
 	pSocket = CreateSocket();
 	
-	if(realRemoteAddress.type == denSocketAddress::Type::ipv6){
+	switch(realRemoteAddress.type){
+	case denSocketAddress::Type::ipv6:
 		pSocket->SetAddress(denSocketAddress::IPv6Any());
+		break;
 		
-	}else{
+	case denSocketAddress::Type::memory:
+		pSocket->SetAddress(denSocketAddress::MemoryAny());
+		break;
+		
+	default:
 		pSocket->SetAddress(denSocketAddress::IPv4Any());
+		break;
 	}
 	
 	pSocket->Bind();
+	pSocket->Connect(realRemoteAddress);
 	
 	pLocalAddress = pSocket->GetAddress().ToString();
-	
-	const denMessage::Ref connectRequest(denMessage::Pool().Get());
-	{
-	denMessageWriter writer(connectRequest->Item());
-	writer.WriteByte((uint8_t)denProtocol::CommandCodes::connectionRequest);
-	writer.WriteUShort( 1 ); // version
-	writer.WriteUShort((uint8_t)denProtocol::Protocols::DENetworkProtocol);
-	}
 	pRealRemoteAddress = realRemoteAddress;
-	pRemoteAddress = address;
+	pConnectCookie = 0;
 	
 	if(pLogger){
 		std::stringstream s;
@@ -113,11 +174,11 @@ void denConnection::ConnectTo(const std::string &address){
 		pLogger->Log(denLogger::LogSeverity::info, s.str());
 	}
 	
-	pSocket->SendDatagram(connectRequest->Item(), pRealRemoteAddress);
+	pQueueConnectRequest();
+	pSocket->FlushDatagrams();
 	
 	pConnectionState = ConnectionState::connecting;
 	pElapsedConnectResend = 0.0f;
-	pElapsedConnectTimeout = 0.0f;
 }
 
 void denConnection::Disconnect(){
@@ -135,15 +196,9 @@ void denConnection::SendMessage(const denMessage::Ref &message){
 		throw std::invalid_argument("not connected");
 	}
 	
-	// send message
-	const denMessage::Ref unrealMessage(denMessage::Pool().Get());
-	{
-	denMessageWriter writer(unrealMessage->Item());
-	writer.WriteByte((uint8_t)denProtocol::CommandCodes::message);
-	writer.Write(message->Item());
-	}
-	
-	pSocket->SendDatagram(unrealMessage->Item(), pRealRemoteAddress);
+	// send message. the payload is send directly from the message without copying
+	const uint8_t header = (uint8_t)denProtocol::CommandCodes::message;
+	pQueueDatagram(denEgressScheduler::Priority::realtime, &header, 1, message, 0, message->Item().GetLength());
 }
 
 void denConnection::SendReliableMessage(const denMessage::Ref &message){
@@ -159,9 +214,11 @@ void denConnection::SendReliableMessage(const denMessage::Ref &message){
 		throw std::invalid_argument("not connected");
 	}
 	
-	const int partCount = (int)((length - 1) / pLongMessagePartSize + 1);
+	// parts reference the message payload and are send with their header in front of it.
+	// the message is not copied and must not be modified afterwards
+	const size_t partSize = (size_t)pDatagramSize - 4;
+	const int partCount = (int)((length - 1) / partSize + 1);
 	if(partCount > 1){
-		const uint8_t * const data = (uint8_t*)message->Item().GetData().c_str();
 		size_t offset = 0;
 		int i;
 		
@@ -179,15 +236,17 @@ void denConnection::SendReliableMessage(const denMessage::Ref &message){
 				flags |= (uint8_t)denProtocol::LongMessageFlags::last;
 			}
 			
-			const size_t partLength = std::min(pLongMessagePartSize, length - offset);
+			const size_t partLength = std::min(partSize, length - offset);
 			
-			{
-			denMessageWriter writer(realMessage->Item().message->Item());
-			writer.WriteByte((uint8_t)denProtocol::CommandCodes::reliableMessageLong);
-			writer.WriteUShort((uint16_t)realMessage->Item().number);
-			writer.WriteByte(flags);
-			writer.Write(data + offset, partLength);
-			}
+			denRealMessage &part = realMessage->Item();
+			part.header[0] = (uint8_t)denProtocol::CommandCodes::reliableMessageLong;
+			part.header[1] = (uint8_t)part.number;
+			part.header[2] = (uint8_t)(part.number >> 8);
+			part.header[3] = flags;
+			part.headerLength = 4;
+			part.payload = message;
+			part.payloadOffset = offset;
+			part.payloadLength = partLength;
 			
 			pReliableMessagesSend.push_back(realMessage);
 			
@@ -211,12 +270,14 @@ void denConnection::SendReliableMessage(const denMessage::Ref &message){
 		realMessage->Item().number = (pReliableNumberSend + pReliableMessagesSend.size()) % 65535;
 		realMessage->Item().state = denRealMessage::State::pending;
 		
-		{
-		denMessageWriter writer(realMessage->Item().message->Item());
-		writer.WriteByte((uint8_t)denProtocol::CommandCodes::reliableMessage);
-		writer.WriteUShort((uint16_t)realMessage->Item().number);
-		writer.Write(message->Item());
-		}
+		denRealMessage &single = realMessage->Item();
+		single.header[0] = (uint8_t)denProtocol::CommandCodes::reliableMessage;
+		single.header[1] = (uint8_t)single.number;
+		single.header[2] = (uint8_t)(single.number >> 8);
+		single.headerLength = 3;
+		single.payload = message;
+		single.payloadOffset = 0;
+		single.payloadLength = length;
 		
 		pReliableMessagesSend.push_back(realMessage);
 #ifdef DO_SPECIAL_DEBUG
@@ -230,7 +291,7 @@ void denConnection::SendReliableMessage(const denMessage::Ref &message){
 		
 		// if the message fits into the window send it right now
 		if(pReliableMessagesSend.size() <= (size_t)pReliableWindowSize){
-			pSocket->SendDatagram(realMessage->Item().message->Item(), pRealRemoteAddress);
+			pQueueRealMessage(realMessage->Item());
 			
 			realMessage->Item().state = denRealMessage::State::send;
 			realMessage->Item().elapsedResend = 0.0f;
@@ -256,6 +317,9 @@ void denConnection::LinkState(const denMessage::Ref &message, const denState::Re
 		throw std::invalid_argument("not connected");
 	}
 	
+	// state links are shared with connections updated by other server threads
+	const denServer::StatesLock lockStates(pParentServer, true);
+	
 	// check if a link exists with this state already that is not broken
 	StateLinks::const_iterator iterLink(std::find_if(pStateLinks.cbegin(),
 	pStateLinks.cend(), [&](const denStateLink::Ref &each){
@@ -270,17 +334,18 @@ void denConnection::LinkState(const denMessage::Ref &message, const denState::Re
 	if(iterLink == pStateLinks.cend()){
 		const int lastNextLinkIdentifier = pNextLinkIdentifier;
 		
-		while(std::find_if(pStateLinks.cbegin(), pStateLinks.cend(), [&](const denStateLink::Ref &each){
-			return each->GetIdentifier() == pNextLinkIdentifier;
-		}) != pStateLinks.cend()){
+		while(pIsLinkIdentifierUsed(pNextLinkIdentifier)){
 			pNextLinkIdentifier = (pNextLinkIdentifier + 1) % 65535;
 			if(pNextLinkIdentifier == lastNextLinkIdentifier){
 				throw std::invalid_argument("too many state links");
 			}
 		}
 		
+		// advance the identifier. link traffic of dropped links can be still in flight.
+		// reusing identifiers late keeps it from being applied to a different state
 		const denStateLink::Ref link(std::make_shared<denStateLink>(*this, *state));
 		link->SetIdentifier(pNextLinkIdentifier);
+		pNextLinkIdentifier = (pNextLinkIdentifier + 1) % 65535;
 		pStateLinks.push_back(link);
 		iterLink = std::prev(pStateLinks.cend());
 		
@@ -292,6 +357,7 @@ void denConnection::LinkState(const denMessage::Ref &message, const denState::Re
 	realMessage->Item().type = denProtocol::CommandCodes::reliableLinkState;
 	realMessage->Item().number = (pReliableNumberSend + pReliableMessagesSend.size()) % 65535;
 	realMessage->Item().state = denRealMessage::State::pending;
+	realMessage->Item().payload.reset();
 	
 	{
 	denMessageWriter writer(realMessage->Item().message->Item());
@@ -308,7 +374,7 @@ void denConnection::LinkState(const denMessage::Ref &message, const denState::Re
 	
 	// if the message fits into the window send it right now
 	if(pReliableMessagesSend.size() <= (size_t)pReliableWindowSize){
-		pSocket->SendDatagram(realMessage->Item().message->Item(), pRealRemoteAddress);
+		pQueueRealMessage(realMessage->Item());
 		
 		realMessage->Item().state = denRealMessage::State::send;
 		realMessage->Item().elapsedResend = 0.0f;
@@ -318,39 +384,128 @@ void denConnection::LinkState(const denMessage::Ref &message, const denState::Re
 	(*iterLink)->SetLinkState(denStateLink::State::listening);
 }
 
+void denConnection::UnlinkState(const denState::Ref &state){
+	if(!state){
+		throw std::invalid_argument("state is nullptr");
+	}
+	if(!GetCanUnlinkStates()){
+		throw std::invalid_argument("remote side does not support unlinking states");
+	}
+	
+	const denServer::StatesLock lockStates(pParentServer, true);
+	
+	StateLinks::iterator iterLink(std::find_if(pStateLinks.begin(),
+	pStateLinks.end(), [&](const denStateLink::Ref &each){
+		return state.get() == each->GetState();
+	}));
+	
+	if(iterLink == pStateLinks.end()){
+		return;
+	}
+	
+	const int identifier = (*iterLink)->GetIdentifier();
+	pDropStateLink(iterLink);
+	
+	if(pConnectionState != ConnectionState::connected){
+		return;
+	}
+	
+	// add message. send reliable to keep it in order with link state messages
+	const denRealMessage::Ref realMessage(denRealMessage::Pool().Get());
+	realMessage->Item().type = denProtocol::CommandCodes::reliableLinkDrop;
+	realMessage->Item().number = (pReliableNumberSend + pReliableMessagesSend.size()) % 65535;
+	realMessage->Item().state = denRealMessage::State::pending;
+	realMessage->Item().payload.reset();
+	
+	{
+	denMessageWriter writer(realMessage->Item().message->Item());
+	writer.WriteByte((uint8_t)denProtocol::CommandCodes::reliableLinkDrop);
+	writer.WriteUShort((uint16_t)realMessage->Item().number);
+	writer.WriteUShort((uint16_t)identifier);
+	}
+	
+	pReliableMessagesSend.push_back(realMessage);
+	
+	// the identifier is not reused before the remote side dropped the link
+	pDroppedLinks.push_back({realMessage->Item().number, identifier});
+	
+	// if the message fits into the window send it right now
+	if(pReliableMessagesSend.size() <= (size_t)pReliableWindowSize){
+		pQueueRealMessage(realMessage->Item());
+		
+		realMessage->Item().state = denRealMessage::State::send;
+		realMessage->Item().elapsedResend = 0.0f;
+		realMessage->Item().elapsedTimeout = 0.0f;
+	}
+}
+
+bool denConnection::IsStateLinked(const denState::Ref &state) const{
+	const denServer::StatesLock lockStates(pParentServer, false);
+	
+	return std::find_if(pStateLinks.cbegin(), pStateLinks.cend(), [&](const denStateLink::Ref &each){
+		return state.get() == each->GetState() && each->GetLinkState() != denStateLink::State::down;
+	}) != pStateLinks.cend();
+}
+
 void denConnection::Update(float elapsedTime){
 	if(pConnectionState == ConnectionState::disconnected){
 		return;
 	}
 	
-	if(!pParentServer){
-		while(true){
-			if(pConnectionState == ConnectionState::disconnected){
-				return;
-			}
+	// server connections receive only if they use a per-peer socket. the server
+	// receives for them otherwise
+	if((!pParentServer || pPeerSocket) && pSocket){
+		while(pConnectionState != ConnectionState::disconnected){
+			pReceivedDatagrams.clear();
 			
 			try{
-				denSocketAddress addressReceive;
-				const denMessage::Ref message(pSocket->ReceiveDatagram(addressReceive));
-				if(!message){
+				if(pSocket->ReceiveDatagrams(pReceivedDatagrams, pReceiveBatchSize) == 0){
 					break;
 				}
 				
-				denMessageReader reader(message->Item());
-				ProcessDatagram(reader);
-				
 			}catch(const std::exception &e){
 				if(pLogger){
 					pLogger->Log(denLogger::LogSeverity::error,
 						std::string("Connection: Update[1]: ") + e.what());
 				}
+				break;
+			}
+			
+			denSocket::Datagrams::const_iterator iter;
+			for(iter = pReceivedDatagrams.cbegin(); iter != pReceivedDatagrams.cend(); iter++){
+				if(pConnectionState == ConnectionState::disconnected){
+					break;
+				}
+				
+				try{
+					denMessageReader reader(iter->message);
+					ProcessDatagram(reader);
+					
+				}catch(const std::exception &e){
+					if(pLogger){
+						pLogger->Log(denLogger::LogSeverity::error,
+							std::string("Connection: Update[1]: ") + e.what());
+					}
+				}
 			}
 		}
+		
+		pReceivedDatagrams.clear();
+		
+		if(pConnectionState == ConnectionState::disconnected){
+			return;
+		}
 	}
 	
 	try{
 		if( pUpdateTimeouts(elapsedTime) ){
-			pUpdateStates();
+			if(pParentServer && pParentServer->pSerializeThreadPool){
+				// server writes link updates of all connections in parallel afterwards
+				pWriteLinkUpdatesPending = true;
+				
+			}else{
+				pUpdateStates();
+			}
 		}
 		
 	}catch(const std::exception &e){
@@ -359,14 +514,51 @@ void denConnection::Update(float elapsedTime){
 				std::string("Connection: Update[2]: ") + e.what());
 		}
 	}
+	
+	if((!pParentServer || pPeerSocket) && pSocket){
+		try{
+			pSocket->FlushDatagrams();
+			
+		}catch(const std::exception &e){
+			if(pLogger){
+				pLogger->Log(denLogger::LogSeverity::error,
+					std::string("Connection: Update[3]: ") + e.what());
+			}
+		}
+	}
+}
+
+bool denConnection::WaitForActivity(float timeout){
+	if(pParentServer){
+		throw std::runtime_error("connection is owned by a server");
+	}
+	if(pConnectionState == ConnectionState::disconnected){
+		return false;
+	}
+	
+	const float deadline = pNextDeadline();
+	if(deadline >= 0.0f && (timeout < 0.0f || deadline < timeout)){
+		timeout = deadline;
+	}
+	
+	if(pResolveRequest){
+		pResolveRequest->Wait(timeout);
+		return false;
+	}
+	if(!pSocket){
+		return false;
+	}
+	
+	return pSocket->WaitForDatagram(timeout);
 }
 
 denSocket::Ref denConnection::CreateSocket(){
-	return denSocketShared::CreateSocket();
+	return denSocketShared::CreateSocket(pMemoryTransport
+		? denSocketShared::Backend::memory : denSocketShared::Backend::platform);
 }
 
 denSocketAddress denConnection::ResolveAddress(const std::string &address){
-	return denSocketShared::ResolveAddress(address);
+	return pAddressResolver->Resolve(address);
 }
 
 void denConnection::ConnectionEstablished(){
@@ -384,20 +576,45 @@ void denConnection::MessageProgress(size_t){
 void denConnection::MessageReceived(const denMessage::Ref &){
 }
 
+void denConnection::MessageViewReceived(const denMessageView &view){
+	if(view.GetOffset() == 0 && view.GetLength() == view.GetMessage()->Item().GetLength()){
+		MessageReceived(view.GetMessage());
+		
+	}else{
+		MessageReceived(view.Copy());
+	}
+}
+
 denState::Ref denConnection::CreateState(const denMessage::Ref &, bool){
 	return nullptr;
 }
 
+void denConnection::StateUnlinked(denState &){
+}
+
 bool denConnection::Matches(denSocket *bnSocket, const denSocketAddress &address) const{
-	return pSocket.get() == bnSocket && address == pRealRemoteAddress;
+	return (pSocket.get() == bnSocket || pPeerSocket) && address == pRealRemoteAddress;
 }
 
 void denConnection::ProcessDatagram(denMessageReader& reader){
-	switch((denProtocol::CommandCodes)reader.ReadByte()){
+	const denProtocol::CommandCodes command = (denProtocol::CommandCodes)reader.ReadByte();
+	
+	// the client received the connection ack and answered. the ack has been send
+	// already hence probes do not overtake it
+	if(pMtuProbePending && command != denProtocol::CommandCodes::connectionRequest){
+		pMtuProbePending = false;
+		pStartMtuProbe();
+	}
+	
+	switch(command){
 	case denProtocol::CommandCodes::connectionAck:
 		pProcessConnectionAck(reader);
 		break;
 		
+	case denProtocol::CommandCodes::connectionCookie:
+		pProcessConnectionCookie(reader);
+		break;
+		
 	case denProtocol::CommandCodes::connectionClose:
 		pProcessConnectionClose(reader);
 		break;
@@ -426,6 +643,10 @@ void denConnection::ProcessDatagram(denMessageReader& reader){
 		pProcessLinkDown(reader);
 		break;
 		
+	case denProtocol::CommandCodes::reliableLinkDrop:
+		pProcessReliableLinkDrop(reader);
+		break;
+		
 	case denProtocol::CommandCodes::linkUpdate:
 		pProcessLinkUpdate(reader);
 		break;
@@ -438,6 +659,14 @@ void denConnection::ProcessDatagram(denMessageReader& reader){
 		pProcessReliableLinkStateLong(reader);
 		break;
 		
+	case denProtocol::CommandCodes::mtuProbe:
+		pProcessMtuProbe(reader);
+		break;
+		
+	case denProtocol::CommandCodes::mtuProbeAck:
+		pProcessMtuProbeAck(reader);
+		break;
+		
 	default:
 		// throw std::invalid_argument("Invalid command code");
 		break;
@@ -447,8 +676,9 @@ void denConnection::ProcessDatagram(denMessageReader& reader){
 
 
 void denConnection::AcceptConnection(denServer &server, const denSocket::Ref &bnSocket,
-const denSocketAddress &address, denProtocol::Protocols protocol){
+const denSocketAddress &address, denProtocol::Protocols protocol, bool peerSocket){
 	pSocket = bnSocket;
+	pPeerSocket = peerSocket;
 	pRealRemoteAddress = address;
 	pRemoteAddress = address.ToString();
 	pConnectionState = ConnectionState::connected;
@@ -458,10 +688,43 @@ const denSocketAddress &address, denProtocol::Protocols protocol){
 	pParentServer = &server;
 	
 	ConnectionEstablished();
+	
+	// the client has not yet proven to own the address. probing now would send large
+	// datagrams to whatever address a connection request has been spoofed with
+	pMtuProbePending = pPathMtuDiscovery && pConnectionState == ConnectionState::connected;
+}
+
+bool denConnection::pFinishResolve(){
+	const denAddressResolver::Request::Ref request(pResolveRequest);
+	pResolveRequest.reset();
+	
+	if(!request->HasFailed()){
+		try{
+			pConnectToAddress(request->GetResult());
+			return true;
+			
+		}catch(const std::exception &e){
+			pCloseSocket();
+			if(pLogger){
+				pLogger->Log(denLogger::LogSeverity::error, std::string("Connection: Connect failed: ") + e.what());
+			}
+			ConnectionFailed(ConnectionFailedReason::generic);
+			return false;
+		}
+	}
+	
+	pCloseSocket();
+	if(pLogger){
+		std::stringstream s;
+		s << "Connection: Connection failed (resolve address: " << request->GetError() << ")";
+		pLogger->Log(denLogger::LogSeverity::info, s.str());
+	}
+	ConnectionFailed(ConnectionFailedReason::resolveFailed);
+	return false;
 }
 
 void denConnection::pDisconnect(bool notify, bool remoteClosed){
-	if(!pSocket || pConnectionState == ConnectionState::disconnected){
+	if((!pSocket && !pResolveRequest) || pConnectionState == ConnectionState::disconnected){
 		return;
 	}
 	
@@ -481,12 +744,15 @@ void denConnection::pDisconnect(bool notify, bool remoteClosed){
 			denMessageWriter writer(connectionClose->Item());
 			writer.WriteByte((uint8_t)denProtocol::CommandCodes::connectionClose);
 			}
-			pSocket->SendDatagram(connectionClose->Item(), pRealRemoteAddress);
+			pSocket->QueueDatagram(connectionClose, pRealRemoteAddress);
 		}
 	}
 	
 	pClearStates();
 	
+	for(const denRealMessage::Ref &each : pReliableMessagesSend){
+		each->Item().payload.reset();
+	}
 	pReliableMessagesRecv.clear();
 	pReliableMessagesSend.clear();
 	pReliableNumberSend = 0;
@@ -509,7 +775,9 @@ void denConnection::pDisconnect(bool notify, bool remoteClosed){
 }
 
 void denConnection::pClearStates(){
+	const denServer::StatesLock lockStates(pParentServer, true);
 	pModifiedStateLinks.clear();
+	pDroppedLinks.clear();
 	
 	StateLinks::const_iterator iterLink;
 	for(iterLink = pStateLinks.cbegin(); iterLink != pStateLinks.cend(); iterLink++){
@@ -531,7 +799,26 @@ void denConnection::pCloseSocket(){
 	pConnectionState = ConnectionState::disconnected;
 	pElapsedConnectResend = 0.0f;
 	pElapsedConnectTimeout = 0.0f;
+	
+	if(pSocket && (!pParentServer || pPeerSocket)){
+		// shared server sockets are flushed by the server
+		try{
+			pSocket->FlushDatagrams();
+			
+		}catch(const std::exception &){
+		}
+	}
+	
 	pSocket.reset();
+	pEgressFlow.reset();
+	pPeerSocket = false;
+	pLinkUpdates.clear();
+	pWriteLinkUpdatesPending = false;
+	pResolveRequest.reset();
+	pDatagramSize = vDefaultDatagramSize;
+	pMtuProbePending = false;
+	pMtuProbeAttempt = 0;
+	pMtuProbeAcked = 0;
 }
 
 void denConnection::pRemoveConnectionFromParentServer(){
@@ -539,50 +826,55 @@ void denConnection::pRemoveConnectionFromParentServer(){
 		return;
 	}
 	
-	denServer::Connections &connections = pParentServer->pConnections;
+	denServer &server = *pParentServer;
 	pParentServer = nullptr;
-	// below this point has to be save against this-pointer being potentially deleted
+	// below this point has to be save against this-pointer being potentially deleted.
+	// the owning shard drops the connection during its next update
 	
-	denServer::Connections::iterator iter(std::find_if(connections.begin(),
-		connections.end(), [&](const denConnection::Ref &each){
-			return each.get() == this;
-		}));
-	if(iter != connections.end()){
-		connections.erase(iter);
+	const std::lock_guard<std::mutex> guard(server.pMutexConnections);
+	server.pConnections.erase(pParentServerEntry);
+}
+
+void denConnection::pQueueConnectRequest(){
+	const denMessage::Ref connectRequest(denMessage::Pool().Get());
+	{
+	denMessageWriter writer(connectRequest->Item());
+	writer.WriteByte((uint8_t)denProtocol::CommandCodes::connectionRequest);
+	writer.WriteUShort(2); // protocol count
+	writer.WriteUShort((uint16_t)denProtocol::Protocols::DENetworkProtocol2);
+	writer.WriteUShort((uint16_t)denProtocol::Protocols::DENetworkProtocol);
+	writer.WriteULong(pConnectCookie);
 	}
+	pSocket->QueueDatagram(connectRequest, pRealRemoteAddress);
 }
 
 void denConnection::pUpdateStates(){
-	int linkCount = (int)pModifiedStateLinks.size();
-	if(linkCount == 0){
-		return;
-	}
+	pWriteLinkUpdates();
+	pQueueLinkUpdates();
+}
+
+void denConnection::pWriteLinkUpdates(){
+	pWriteLinkUpdatesPending = false;
 	
-	ModifiedStateLinks::iterator iter;
-	int changedCount = 0;
-	for(iter = pModifiedStateLinks.begin(); iter != pModifiedStateLinks.end(); iter++){
-		if((*iter)->GetLinkState() == denStateLink::State::up && (*iter)->GetChanged()){
-			changedCount++;
-		}
-	}
-	if(changedCount == 0){
+	// other server threads modifying states add to the modified state links
+	const denServer::StatesLock lockStates(pParentServer, false);
+	if(pModifiedStateLinks.empty()){
 		return;
 	}
-	changedCount = std::min(changedCount, 255);
 	
-	const denMessage::Ref updateMessage(denMessage::Pool().Get());
-	{
-	denMessageWriter writer(updateMessage->Item());
-	writer.WriteByte((uint8_t)denProtocol::CommandCodes::linkUpdate);
-	writer.WriteByte((uint8_t)changedCount);
+	// links are written one by one and appended to the update datagram as long as the
+	// datagram stays inside the datagram size. larger updates use multiple datagrams
+	const denMessage::Ref linkMessage(denMessage::Pool().Get());
+	denMessage::Ref updateMessage;
+	int linkCount = 0;
 	
+	ModifiedStateLinks::iterator iter;
 	for(iter = pModifiedStateLinks.begin(); iter != pModifiedStateLinks.end(); ){
 		if((*iter)->GetLinkState() != denStateLink::State::up || !(*iter)->GetChanged()){
 			iter++;
 			continue;
 		}
 		
-		writer.WriteUShort((uint16_t)((*iter)->GetIdentifier()));
 		denState * const state = (*iter)->GetState();
 		if(!state){
 			//throw std::invalid_argument("state link droppped");
@@ -590,18 +882,139 @@ void denConnection::pUpdateStates(){
 			continue;
 		}
 		
+		{
+		denMessageWriter writer(linkMessage->Item());
+		writer.WriteUShort((uint16_t)((*iter)->GetIdentifier()));
 		state->LinkWriteValues(writer, **iter);
+		}
 		
 		pModifiedStateLinks.erase(ModifiedStateLinks::iterator(iter++));
 		
-		changedCount--;
-		if(changedCount == 0){
+		const size_t linkLength = linkMessage->Item().GetLength();
+		if(updateMessage && (linkCount == 255
+		|| updateMessage->Item().GetLength() + linkLength > (size_t)pDatagramSize)){
+			pAddLinkUpdate(updateMessage, linkCount);
+			updateMessage.reset();
+		}
+		
+		if(!updateMessage){
+			updateMessage = denMessage::Pool().Get();
+			updateMessage->Item().SetLength(2);
+			linkCount = 0;
+		}
+		
+		denMessage &message = updateMessage->Item();
+		const size_t offset = message.GetLength();
+		message.SetLengthRetain(offset + linkLength);
+		memcpy((char*)message.GetData().c_str() + offset, linkMessage->Item().GetData().c_str(), linkLength);
+		linkCount++;
+	}
+	
+	if(updateMessage){
+		pAddLinkUpdate(updateMessage, linkCount);
+	}
+}
+
+void denConnection::pAddLinkUpdate(const denMessage::Ref &message, int linkCount){
+	uint8_t * const data = (uint8_t*)message->Item().GetData().c_str();
+	data[0] = (uint8_t)denProtocol::CommandCodes::linkUpdate;
+	data[1] = (uint8_t)linkCount;
+	pLinkUpdates.push_back(message);
+}
+
+void denConnection::pQueueLinkUpdates(){
+	if(pSocket && pConnectionState == ConnectionState::connected){
+		std::vector<denMessage::Ref>::const_iterator iter;
+		for(iter = pLinkUpdates.cbegin(); iter != pLinkUpdates.cend(); iter++){
+			pQueueDatagram(denEgressScheduler::Priority::realtime, *iter);
+		}
+	}
+	pLinkUpdates.clear();
+}
+
+void denConnection::pStartMtuProbe(){
+	pMtuProbeAttempt = 1;
+	pMtuProbeAcked = 0;
+	pMtuProbeLimit = 0;
+	pElapsedMtuProbe = 0.0f;
+	pSendMtuProbes();
+}
+
+void denConnection::pUpdateMtuProbe(float elapsedTime){
+	if(pMtuProbeAttempt == 0){
+		return;
+	}
+	
+	pElapsedMtuProbe += elapsedTime;
+	if(pElapsedMtuProbe <= pReliableResendInterval){
+		return;
+	}
+	
+	pElapsedMtuProbe = 0.0f;
+	if(pMtuProbeAttempt == vMtuProbeAttempts){
+		pFinishMtuProbe();
+		return;
+	}
+	
+	pMtuProbeAttempt++;
+	pSendMtuProbes();
+}
+
+void denConnection::pSendMtuProbes(){
+	// probes are send all at once. lost probes are resend with the next attempt.
+	// probes are send right away with fragmentation disabled bypassing the send queue
+	const denMessage::Ref probe(denMessage::Pool().Get());
+	denMessage &message = probe->Item();
+	int i;
+	
+	for(i=0; i<vMtuProbeSizeCount; i++){
+		const int size = vMtuProbeSizes[i];
+		if(size <= pMtuProbeAcked){
+			continue;
+		}
+		if(pMtuProbeLimit > 0 && size >= pMtuProbeLimit){
+			break;
+		}
+		
+		message.SetLength(size);
+		uint8_t * const data = (uint8_t*)message.GetData().c_str();
+		memset(data, 0, size);
+		data[0] = (uint8_t)denProtocol::CommandCodes::mtuProbe;
+		data[1] = (uint8_t)size;
+		data[2] = (uint8_t)(size >> 8);
+		
+		if(!pSocket->SendProbeDatagram(message, pRealRemoteAddress)){
+			pMtuProbeLimit = size; // larger than the known path MTU
 			break;
 		}
 	}
+}
+
+void denConnection::pFinishMtuProbe(){
+	pMtuProbeAttempt = 0;
+	
+	if(pMtuProbeAcked == 0){
+		if(pLogger){
+			pLogger->Log(denLogger::LogSeverity::info,
+				"Connection: Path MTU discovery not supported by remote connection");
+		}
+		return;
 	}
 	
-	pSocket->SendDatagram(updateMessage->Item(), pRealRemoteAddress);
+	pSetDatagramSize(pMtuProbeAcked);
+	
+	if(pLogger){
+		std::stringstream s;
+		s << "Connection: Path MTU discovered (" << pMtuProbeAcked << " bytes)";
+		pLogger->Log(denLogger::LogSeverity::info, s.str());
+	}
+}
+
+void denConnection::pSetDatagramSize(int size){
+	pDatagramSize = size;
+	if(pSocket && pSocket->IsConnected()){
+		pSocket->SetPathDatagramSize(size);
+	}
 }
 
 bool denConnection::pUpdateTimeouts(float elapsedTime){
@@ -626,10 +1039,11 @@ bool denConnection::pUpdateTimeouts(float elapsedTime){
 			message.elapsedResend += elapsedTime;
 			if(message.elapsedResend > pReliableResendInterval){
 				message.elapsedResend = 0.0f;
-				pSocket->SendDatagram(message.message->Item(), pRealRemoteAddress);
+				pQueueRealMessage(message);
 			}
 		}
 		}
+		pUpdateMtuProbe(elapsedTime);
 		return true;
 		
 	case ConnectionState::connecting:
@@ -644,21 +1058,17 @@ bool denConnection::pUpdateTimeouts(float elapsedTime){
 			return false;
 		}
 		
+		if(pResolveRequest){
+			return pResolveRequest->IsFinished() && pFinishResolve();
+		}
+		
 		pElapsedConnectResend += elapsedTime;
 		if(pElapsedConnectResend > pConnectResendInterval){
 			if(pLogger){
 				pLogger->Log(denLogger::LogSeverity::debug, "Connection: Resend connect request");
 			}
 			pElapsedConnectResend = 0.0f;
-			
-			const denMessage::Ref connectRequest(denMessage::Pool().Get());
-			{
-			denMessageWriter writer(connectRequest->Item());
-			writer.WriteByte((uint8_t)denProtocol::CommandCodes::connectionRequest);
-			writer.WriteUShort( 1 ); // version
-			writer.WriteUShort((uint8_t)denProtocol::Protocols::DENetworkProtocol);
-			}
-			pSocket->SendDatagram(connectRequest->Item(), pRealRemoteAddress);
+			pQueueConnectRequest();
 		}
 		return true;
 		
@@ -667,8 +1077,54 @@ bool denConnection::pUpdateTimeouts(float elapsedTime){
 	}
 }
 
+float denConnection::pNextDeadline() const{
+	float deadline = -1.0f;
+	
+	switch(pConnectionState){
+	case ConnectionState::connected:
+		for(const denRealMessage::Ref &eachMessage : pReliableMessagesSend){
+			const denRealMessage &message = eachMessage->Item();
+			if(message.state != denRealMessage::State::send){
+				continue;
+			}
+			
+			const float next = std::max(std::min(pReliableTimeout - message.elapsedTimeout,
+				pReliableResendInterval - message.elapsedResend), 0.0f);
+			if(deadline < 0.0f || next < deadline){
+				deadline = next;
+			}
+		}
+		
+		if(pMtuProbeAttempt > 0){
+			const float next = std::max(pReliableResendInterval - pElapsedMtuProbe, 0.0f);
+			if(deadline < 0.0f || next < deadline){
+				deadline = next;
+			}
+		}
+		break;
+		
+	case ConnectionState::connecting:
+		if(pResolveRequest){
+			deadline = std::max(pConnectTimeout - pElapsedConnectTimeout, 0.0f);
+			
+		}else{
+			deadline = std::max(std::min(pConnectTimeout - pElapsedConnectTimeout,
+				pConnectResendInterval - pElapsedConnectResend), 0.0f);
+		}
+		break;
+		
+	default:
+		return -1.0f;
+	}
+	
+	// timers trigger once exceeding the interval. waiting for a short moment longer
+	// avoids waking up just before the deadline
+	return deadline < 0.0f ? deadline : deadline + 0.001f;
+}
+
 
 void denConnection::pInvalidateState(const denState::Ref &state){
+	const denServer::StatesLock lockStates(pParentServer, true);
 	StateLinks::iterator iter;
 	for(iter = pStateLinks.begin(); iter != pStateLinks.end(); ){
 		denStateLink * const link = iter->get();
@@ -687,6 +1143,32 @@ void denConnection::pInvalidateState(const denState::Ref &state){
 	}
 }
 
+void denConnection::pDropStateLink(StateLinks::iterator iterLink){
+	const denStateLink::Ref link(*iterLink);
+	pStateLinks.erase(iterLink);
+	
+	// modified state links hold raw pointers. remove the link before it is freed
+	pModifiedStateLinks.remove(link.get());
+	
+	denState * const state = link->GetState();
+	if(state){
+		denState::StateLinks::iterator iterState(state->FindLink(link.get()));
+		if(iterState != state->pLinks.end()){
+			state->pLinks.erase(iterState);
+		}
+		link->pState = nullptr;
+	}
+}
+
+bool denConnection::pIsLinkIdentifierUsed(int identifier) const{
+	return std::find_if(pStateLinks.cbegin(), pStateLinks.cend(), [&](const denStateLink::Ref &each){
+		return each->GetIdentifier() == identifier;
+	}) != pStateLinks.cend()
+	|| std::find_if(pDroppedLinks.cbegin(), pDroppedLinks.cend(), [&](const DroppedLink &each){
+		return each.identifier == identifier;
+	}) != pDroppedLinks.cend();
+}
+
 void denConnection::pAddModifiedStateLink(denStateLink *link){
 	pModifiedStateLinks.push_back(link);
 }
@@ -698,27 +1180,37 @@ void denConnection::pProcessQueuedMessages(){
 	}));
 	
 	while(iter != pReliableMessagesRecv.cend()){
+		// views handed to the application can outlive the pooled real message. hand over
+		// the retained message and give the real message a fresh one
+		denMessage::Ref message(denMessage::Pool().Get());
+		message.swap((*iter)->Item().message);
+		
 		switch((*iter)->Item().type){
 		case denProtocol::CommandCodes::reliableMessage:{
-			denMessageReader reader((*iter)->Item().message->Item());
+			denMessageReader reader(message);
 			pProcessReliableMessageMessage(reader);
 			}break;
 			
 		case denProtocol::CommandCodes::reliableMessageLong:{
-			denMessageReader reader((*iter)->Item().message->Item());
+			denMessageReader reader(message);
 			pProcessReliableMessageMessageLong(reader);
 			}break;
 			
 		case denProtocol::CommandCodes::reliableLinkState:{
-			denMessageReader reader((*iter)->Item().message->Item());
+			denMessageReader reader(message);
 			pProcessLinkState(reader);
 			}break;
 			
 		case denProtocol::CommandCodes::reliableLinkStateLong:{
-			denMessageReader reader((*iter)->Item().message->Item());
+			denMessageReader reader(message);
 			pProcessLinkStateLong(reader);
 			}break;
 			
+		case denProtocol::CommandCodes::reliableLinkDrop:{
+			denMessageReader reader(message);
+			pProcessLinkDrop(reader);
+			}break;
+			
 		default:
 			break;
 		}
@@ -749,6 +1241,10 @@ void denConnection::pProcessConnectionAck(denMessageReader &reader){
 			pLogger->Log(denLogger::LogSeverity::info, "Connection: Connection established");
 		}
 		ConnectionEstablished();
+		
+		if(pPathMtuDiscovery && pConnectionState == ConnectionState::connected){
+			pStartMtuProbe();
+		}
 		break;
 		
 	case denProtocol::ConnectionAck::rejected:
@@ -776,17 +1272,27 @@ void denConnection::pProcessConnectionAck(denMessageReader &reader){
 	}
 }
 
+void denConnection::pProcessConnectionCookie(denMessageReader &reader){
+	if(pConnectionState != ConnectionState::connecting || !pSocket){
+		return;
+	}
+	
+	// answer right away instead of waiting for the next resend
+	pConnectCookie = reader.ReadULong();
+	pElapsedConnectResend = 0.0f;
+	pQueueConnectRequest();
+	
+	if(pLogger){
+		pLogger->Log(denLogger::LogSeverity::debug, "Connection: Resend connect request with cookie");
+	}
+}
+
 void denConnection::pProcessConnectionClose(denMessageReader&){
 	pDisconnect(true, true);
 }
 
 void denConnection::pProcessMessage(denMessageReader &reader){
-	const denMessage::Ref message(denMessage::Pool().Get());
-	message->Item().SetLength(reader.GetLength() - reader.GetPosition());
-	message->Item().SetTimestamp(std::chrono::system_clock::now());
-	reader.Read(message->Item());
-	
-	MessageReceived(message);
+	MessageViewReceived(reader.ReadView());
 }
 
 void denConnection::pProcessReliableMessage(denMessageReader &reader){
@@ -827,7 +1333,7 @@ void denConnection::pProcessReliableMessage(denMessageReader &reader){
 	ackWriter.WriteUShort((uint16_t)number);
 	ackWriter.WriteByte((uint8_t)denProtocol::ReliableAck::success);
 	}
-	pSocket->SendDatagram(ackMessage->Item(), pRealRemoteAddress);
+	pSocket->QueueDatagram(ackMessage, pRealRemoteAddress);
 	
 	if(number == pReliableNumberRecv){
 		pProcessReliableMessageMessage(reader);
@@ -840,19 +1346,16 @@ void denConnection::pProcessReliableMessage(denMessageReader &reader){
 }
 
 void denConnection::pProcessReliableMessageMessage(denMessageReader &reader){
-	denMessage::Ref message(denMessage::Pool().Get());
-	message->Item().SetLength(reader.GetLength() - reader.GetPosition());
-	message->Item().SetTimestamp(std::chrono::system_clock::now());
-	reader.Read(message->Item());
+	const denMessageView view(reader.ReadView());
 	
 #ifdef DO_SPECIAL_DEBUG
 	if(GetLogger()){
 		std::stringstream ss;
-		ss << "pProcessReliableMessageMessage: len=" << message->Item().GetLength();
+		ss << "pProcessReliableMessageMessage: len=" << view.GetLength();
 		GetLogger()->Log(denLogger::LogSeverity::info, ss.str());
 	}
 #endif
-	MessageReceived(message);
+	MessageViewReceived(view);
 }
 
 void denConnection::pProcessReliableAck(denMessageReader &reader){
@@ -886,6 +1389,14 @@ void denConnection::pProcessReliableAck(denMessageReader &reader){
 	
 	switch(code){
 	case denProtocol::ReliableAck::success:
+		if(message->Item().type == denProtocol::CommandCodes::reliableLinkDrop){
+			// links are added by other server threads too
+			const denServer::StatesLock lockStates(pParentServer, true);
+			pDroppedLinks.remove_if([&](const DroppedLink &each){
+				return each.number == number;
+			});
+		}
+		
 		message->Item().state = denRealMessage::State::done;
 		pRemoveSendReliablesDone();
 		break;
@@ -895,7 +1406,7 @@ void denConnection::pProcessReliableAck(denMessageReader &reader){
 			pLogger->Log(denLogger::LogSeverity::debug, "Connection: Reliable ACK failed, resend");
 		}
 		message->Item().elapsedResend = 0.0f;
-		pSocket->SendDatagram(message->Item().message->Item(), pRealRemoteAddress);
+		pQueueRealMessage(message->Item());
 		break;
 	}
 }
@@ -927,7 +1438,7 @@ void denConnection::pProcessReliableLinkState(denMessageReader &reader){
 	ackWriter.WriteUShort((uint16_t)number);
 	ackWriter.WriteByte((uint8_t)denProtocol::ReliableAck::success);
 	}
-	pSocket->SendDatagram(ackMessage->Item(), pRealRemoteAddress);
+	pSocket->QueueDatagram(ackMessage, pRealRemoteAddress);
 	
 	if(number == pReliableNumberRecv){
 		pProcessLinkState(reader);
@@ -989,10 +1500,74 @@ void denConnection::pProcessLinkDown(denMessageReader &reader){
 	(*iterLink)->SetLinkState(denStateLink::State::down);
 }
 
+void denConnection::pProcessReliableLinkDrop(denMessageReader &reader){
+	if(pConnectionState != ConnectionState::connected){
+		//throw std::invalid_argument("Link drop: not connected.");
+		return;
+	}
+	
+	const int number = reader.ReadUShort();
+	bool validNumber;
+	
+	if( number < pReliableNumberRecv ){
+		validNumber = number < (pReliableNumberRecv + pReliableWindowSize) % 65535;
+		
+	}else{
+		validNumber = number < pReliableNumberRecv + pReliableWindowSize;
+	}
+	if( ! validNumber ){
+		//throw std::invalid_argument("Link drop: invalid sequence number.");
+		return;
+	}
+	
+	const denMessage::Ref ackMessage(denMessage::Pool().Get());
+	{
+	denMessageWriter ackWriter(ackMessage->Item());
+	ackWriter.WriteByte((uint8_t)denProtocol::CommandCodes::reliableAck);
+	ackWriter.WriteUShort((uint16_t)number);
+	ackWriter.WriteByte((uint8_t)denProtocol::ReliableAck::success);
+	}
+	pSocket->QueueDatagram(ackMessage, pRealRemoteAddress);
+	
+	if(number == pReliableNumberRecv){
+		pProcessLinkDrop(reader);
+		pReliableNumberRecv = (pReliableNumberRecv + 1) % 65535;
+		pProcessQueuedMessages();
+		
+	}else{
+		pAddReliableReceive(denProtocol::CommandCodes::reliableLinkDrop, number, reader);
+	}
+}
+
+void denConnection::pProcessLinkDrop(denMessageReader &reader){
+	const int identifier = reader.ReadUShort();
+	
+	const denServer::StatesLock lockStates(pParentServer, true);
+	
+	StateLinks::iterator iterLink(std::find_if(pStateLinks.begin(),
+	pStateLinks.end(), [&](const denStateLink::Ref &each){
+		return each->GetIdentifier() == identifier;
+	}));
+	
+	if(iterLink == pStateLinks.end()){
+		//throw std::invalid_argument("drop link with identifier absent");
+		return;
+	}
+	
+	denState * const state = (*iterLink)->GetState();
+	pDropStateLink(iterLink);
+	
+	if(state){
+		StateUnlinked(*state);
+	}
+}
+
 void denConnection::pProcessLinkState(denMessageReader &reader){
 	const int identifier = reader.ReadUShort();
 	const bool readOnly = reader.ReadByte() == 1; // flags: 0x1=readOnly
 	
+	const denServer::StatesLock lockStates(pParentServer, true);
+	
 	StateLinks::const_iterator iterLink(std::find_if(pStateLinks.cbegin(),
 	pStateLinks.cend(), [&](const denStateLink::Ref &each){
 		return each->GetIdentifier() == identifier;
@@ -1006,7 +1581,7 @@ void denConnection::pProcessLinkState(denMessageReader &reader){
 	// create linked network state
 	denMessage::Ref message(denMessage::Pool().Get());
 	message->Item().SetLength(reader.ReadUShort());
-	message->Item().SetTimestamp(std::chrono::system_clock::now());
+	message->Item().SetTimestamp(reader.GetTimestamp());
 	reader.Read(message->Item());
 	
 	const denState::Ref state(CreateState(message, readOnly));
@@ -1037,7 +1612,7 @@ void denConnection::pProcessLinkState(denMessageReader &reader){
 	writer.WriteByte((uint8_t)code);
 	writer.WriteUShort((uint16_t)identifier);
 	}
-	pSocket->SendDatagram(message->Item(), pRealRemoteAddress);
+	pSocket->QueueDatagram(message, pRealRemoteAddress);
 }
 
 void denConnection::pProcessLinkUpdate(denMessageReader &reader){
@@ -1046,6 +1621,9 @@ void denConnection::pProcessLinkUpdate(denMessageReader &reader){
 		return;
 	}
 	
+	// reading values marks the links of other connections modified
+	const denServer::StatesLock lockStates(pParentServer, true);
+	
 	const int count = reader.ReadByte();
 	int i;
 	for(i=0; i<count; i++){
@@ -1111,7 +1689,7 @@ void denConnection::pProcessReliableMessageLong(denMessageReader &reader){
 	ackWriter.WriteUShort((uint16_t)number);
 	ackWriter.WriteByte((uint8_t)denProtocol::ReliableAck::success);
 	}
-	pSocket->SendDatagram(ackMessage->Item(), pRealRemoteAddress);
+	pSocket->QueueDatagram(ackMessage, pRealRemoteAddress);
 	
 	if(number == pReliableNumberRecv){
 		pProcessReliableMessageMessageLong(reader);
@@ -1153,8 +1731,8 @@ void denConnection::pProcessReliableMessageMessageLong(denMessageReader &reader)
 			GetLogger()->Log(denLogger::LogSeverity::info, ss.str());
 		}
 #endif
-		message->Item().SetTimestamp(std::chrono::system_clock::now());
-		MessageReceived(message);
+		message->Item().SetTimestamp(reader.GetTimestamp()); // receive time of last part
+		MessageViewReceived(denMessageView(message, 0, message->Item().GetLength()));
 		
 	}else{
 #ifdef DO_SPECIAL_DEBUG
@@ -1193,7 +1771,7 @@ void denConnection::pProcessReliableLinkStateLong(denMessageReader &reader){
 	ackWriter.WriteUShort((uint16_t)number);
 	ackWriter.WriteByte((uint8_t)denProtocol::ReliableAck::success);
 	}
-	pSocket->SendDatagram(ackMessage->Item(), pRealRemoteAddress);
+	pSocket->QueueDatagram(ackMessage, pRealRemoteAddress);
 	
 	if(number == pReliableNumberRecv){
 		pProcessLinkStateLong(reader);
@@ -1209,6 +1787,8 @@ void denConnection::pProcessLinkStateLong(denMessageReader &reader){
 	const int identifier = reader.ReadUShort();
 	const uint8_t flags = reader.ReadByte();
 	
+	const denServer::StatesLock lockStates(pParentServer, true);
+	
 	StateLinks::const_iterator iterLink(std::find_if(pStateLinks.cbegin(),
 	pStateLinks.cend(), [&](const denStateLink::Ref &each){
 		return each->GetIdentifier() == identifier;
@@ -1292,12 +1872,14 @@ void denConnection::pProcessLinkStateLong(denMessageReader &reader){
 	writer.WriteByte((uint8_t)code);
 	writer.WriteUShort((uint16_t)identifier);
 	}
-	pSocket->SendDatagram(message->Item(), pRealRemoteAddress);
+	pSocket->QueueDatagram(message, pRealRemoteAddress);
 }
 
 void denConnection::pAddReliableReceive(denProtocol::CommandCodes type, int number, denMessageReader &reader){
 	denRealMessage::Ref message(denRealMessage::Pool().Get());
+	message->Item().payload.reset();
 	message->Item().message->Item().SetLength(reader.GetLength() - reader.GetPosition());
+	message->Item().message->Item().SetTimestamp(reader.GetTimestamp());
 	reader.Read(message->Item().message->Item());
 	
 	message->Item().type = type;
@@ -1315,6 +1897,7 @@ void denConnection::pRemoveSendReliablesDone(){
 			break;
 		}
 		
+		pReliableMessagesSend.front()->Item().payload.reset();
 		pReliableMessagesSend.pop_front();
 		pReliableNumberSend = (pReliableNumberSend + 1) % 65535;
 		anyRemoved = true;
@@ -1352,10 +1935,77 @@ void denConnection::pSendPendingReliables(){
 			GetLogger()->Log(denLogger::LogSeverity::info, ss.str());
 		}
 #endif
-		pSocket->SendDatagram(realMessage.message->Item(), pRealRemoteAddress);
+		pQueueRealMessage(realMessage);
 		
 		realMessage.state = denRealMessage::State::send;
 		realMessage.elapsedResend = 0.0f;
 		realMessage.elapsedTimeout = 0.0f;
 	}
 }
+
+void denConnection::pQueueRealMessage(const denRealMessage &message){
+	if(message.payload){
+		pQueueDatagram(denEgressScheduler::Priority::bulk, message.header, message.headerLength,
+			message.payload, message.payloadOffset, message.payloadLength);
+		
+	}else{
+		pQueueDatagram(denEgressScheduler::Priority::bulk, message.message);
+	}
+}
+
+void denConnection::pQueueDatagram(denEgressScheduler::Priority priority, const denMessage::Ref &message){
+	if(pEgressFlow){
+		pEgressFlow->Queue(priority, message);
+		
+	}else{
+		pSocket->QueueDatagram(message, pRealRemoteAddress);
+	}
+}
+
+void denConnection::pQueueDatagram(denEgressScheduler::Priority priority, const uint8_t *header,
+int headerLength, const denMessage::Ref &message, size_t offset, size_t length){
+	if(pEgressFlow){
+		pEgressFlow->Queue(priority, header, headerLength, message, offset, length);
+		
+	}else{
+		pSocket->QueueDatagram(header, headerLength, message, offset, length, pRealRemoteAddress);
+	}
+}
+
+void denConnection::pProcessMtuProbe(denMessageReader &reader){
+	// probes truncated or padded along the path are not acknowledged
+	const int size = reader.ReadUShort();
+	if((size_t)size != reader.GetLength() || !pSocket){
+		return;
+	}
+	
+	const denMessage::Ref ack(denMessage::Pool().Get());
+	{
+	denMessageWriter writer(ack->Item());
+	writer.WriteByte((uint8_t)denProtocol::CommandCodes::mtuProbeAck);
+	writer.WriteUShort((uint16_t)size);
+	}
+	pSocket->QueueDatagram(ack, pRealRemoteAddress);
+}
+
+void denConnection::pProcessMtuProbeAck(denMessageReader &reader){
+	const int size = reader.ReadUShort();
+	if(pMtuProbeAttempt == 0 || size <= pMtuProbeAcked){
+		return;
+	}
+	
+	const int * const end = vMtuProbeSizes + vMtuProbeSizeCount;
+	const int * const found = std::find(vMtuProbeSizes, end, size);
+	if(found == end || (pMtuProbeLimit > 0 && size >= pMtuProbeLimit)){
+		return; // not a probe we send
+	}
+	
+	pMtuProbeAcked = size;
+	if(size > pDatagramSize){
+		pSetDatagramSize(size);
+	}
+	
+	if(found + 1 == end || (pMtuProbeLimit > 0 && found[1] >= pMtuProbeLimit)){
+		pFinishMtuProbe(); // no larger probe pending
+	}
+}
@@ -33,9 +33,12 @@
 #include "denLogger.h"
 #include "denProtocolEnums.h"
 #include "denRealMessage.h"
+#include "denEgressScheduler.h"
 #include "message/denMessage.h"
+#include "message/denMessageView.h"
 #include "state/denState.h"
 #include "state/denStateLink.h"
+#include "socket/denAddressResolver.h"
 #include "socket/denSocketAddress.h"
 #include "socket/denSocket.h"
 
@@ -70,7 +73,8 @@ class denServer;
  * handle individual states. It is not necessary to create a subclass of denState if
  * you intent to subclass denValue* instead.
  * 
- * Overwrite MessageReceived() to process messages send by the server.
+ * Overwrite MessageReceived() to process messages send by the server. Overwrite
+ * MessageViewReceived() instead to process them without copying the received data.
  * 
  * Call Update() in regular intervals to receive and process incoming messages as well as
  * updating states. DENetwork does not use internal threading giving you full control
@@ -106,7 +110,8 @@ public:
 		timeout,
 		rejected,
 		noCommonProtocol,
-		invalidMessage
+		invalidMessage,
+		resolveFailed
 	};
 	
 	/** \brief Create connection. */
@@ -145,6 +150,64 @@ public:
 	/** \brief Set reliable message timeout in seconds. */
 	void SetReliableTimeout(float timeout);
 	
+	/** \brief Resolve address asynchronously while connecting. */
+	inline bool GetResolveAsync() const{ return pResolveAsync; }
+	
+	/**
+	 * \brief Set to resolve address asynchronously while connecting.
+	 * 
+	 * If enabled ConnectTo() returns immediately while the address resolver resolves
+	 * the address on a helper thread. Update() continues connecting once resolved. The
+	 * connect timeout includes the time spent resolving. If resolving fails
+	 * ConnectionFailed() is called with ConnectionFailedReason::resolveFailed. Resolving
+	 * uses the address resolver instead of ResolveAddress().
+	 */
+	void SetResolveAsync(bool resolveAsync);
+	
+	/** \brief Address resolver used for asynchronous resolving. */
+	inline const denAddressResolver::Ref &GetAddressResolver() const{ return pAddressResolver; }
+	
+	/** \brief Set address resolver or nullptr to use the shared address resolver. */
+	void SetAddressResolver(const denAddressResolver::Ref &resolver);
+	
+	/** \brief Discover path MTU once connected. */
+	inline bool GetPathMtuDiscovery() const{ return pPathMtuDiscovery; }
+	
+	/**
+	 * \brief Set to discover path MTU once connected.
+	 * 
+	 * If enabled probe datagrams padded to common path MTU sizes are send with fragmenting
+	 * disabled once the connection is established. The largest probe acknowledged by the
+	 * remote connection becomes the datagram size. Each side discovers the path MTU of
+	 * its own sending direction. Remote connections not supporting path MTU discovery
+	 * do not acknowledge probes and the default datagram size is kept.
+	 * 
+	 * For server side connections set the parameter in denServer::CreateConnection().
+	 * Server side connections start probing only after the first datagram received from
+	 * the client once the connection is established. Connection requests with a spoofed
+	 * address then can not make the server send probes to a third party.
+	 */
+	void SetPathMtuDiscovery(bool discovery);
+	
+	/** \brief Path MTU discovery is in progress. */
+	inline bool GetPathMtuDiscoveryRunning() const{ return pMtuProbeAttempt > 0; }
+	
+	/**
+	 * \brief Path MTU in bytes discovered for the connection or 0 if not discovered.
+	 * 
+	 * Size of the largest acknowledged probe datagram excluding IP and UDP headers.
+	 */
+	inline int GetPathMtu() const{ return pMtuProbeAcked; }
+	
+	/**
+	 * \brief Maximum datagram size in bytes.
+	 * 
+	 * Long reliable messages are split into parts fitting this size and link updates
+	 * exceeding this size are split into multiple datagrams. Defaults to 1361 which
+	 * fits common internet paths. Path MTU discovery replaces the value.
+	 */
+	inline int GetDatagramSize() const{ return pDatagramSize; }
+	
 	/** \brief Connection state. */
 	inline ConnectionState GetConnectionState() const{ return pConnectionState; }
 	
@@ -157,7 +220,13 @@ public:
 	/** \brief Set logger or nullptr to clear. */
 	void SetLogger(const denLogger::Ref &logger);
 	
-	/** \brief Connect to connection object on host at address. */
+	/**
+	 * \brief Connect to connection object on host at address.
+	 * 
+	 * The socket is connected to the resolved address. The kernel then delivers only
+	 * datagrams send from this address and skips the route lookup while sending. Servers
+	 * have to reply from the address the client connects to.
+	 */
 	void ConnectTo(const std::string &address);
 	
 	/** \brief Disconnect from remote connection if connected. */
@@ -176,6 +245,9 @@ public:
 	 * them is fine. This is typically the case for messages repeating in regular
 	 * intervals so missing one of them is not a problem.
 	 * 
+	 * The message is send without copying it. Do not modify the message after sending
+	 * it. Create a new message instead.
+	 * 
 	 * \param[in] message Message to send. Message can contain any kind of byte sequence.
 	 *                    The most simply way to build messages is using denMessageWriter.
 	 */
@@ -193,6 +265,10 @@ public:
 	 * case for events happening once like a player activating an item or opening
 	 * a door.
 	 * 
+	 * The message is send without copying it and is kept until all parts have been
+	 * acknowledged. Do not modify the message after sending it. Create a new message
+	 * instead.
+	 * 
 	 * \param[in] message Message to send. Message can contain any kind of byte sequence.
 	 *                    The most simply way to build messages is using denMessageWriter.
 	 */
@@ -216,6 +292,31 @@ public:
 	 */
 	void LinkState(const denMessage::Ref &message, const denState::Ref &state, bool readOnly);
 	
+	/**
+	 * \brief Unlink network state from remote network state.
+	 * 
+	 * Drops the link immediately. The state is no longer synchronized with the remote
+	 * side. The remote side is notified reliably and in order with link requests. It
+	 * calls StateUnlinked() and drops the link too. The state can be linked again later
+	 * on using LinkState(). Does nothing if the state is not linked.
+	 * 
+	 * Requires both sides to speak DENetworkProtocol2. Remote sides using an older
+	 * version of the library do not understand dropping links. Check with
+	 * GetCanUnlinkStates() before calling.
+	 * 
+	 * \param[in] state State to unlink.
+	 * \throws std::invalid_argument GetCanUnlinkStates() is false.
+	 */
+	void UnlinkState(const denState::Ref &state);
+	
+	/** \brief Negotiated protocol supports UnlinkState(). */
+	inline bool GetCanUnlinkStates() const{
+		return pProtocol == denProtocol::Protocols::DENetworkProtocol2;
+	}
+	
+	/** \brief State is linked or link is in progress. */
+	bool IsStateLinked(const denState::Ref &state) const;
+	
 	/**
 	 * \brief Update connection.
 	 * 
@@ -226,6 +327,22 @@ public:
 	 */
 	void Update(float elapsedTime);
 	
+	/**
+	 * \brief Wait for activity.
+	 * 
+	 * Blocks until datagrams arrive, the next reliable message resend or timeout is due
+	 * or timeout elapsed. Call Update() afterwards with the actually elapsed time. This
+	 * allows clients to sleep instead of calling Update() in a busy loop.
+	 * 
+	 * Connections created by a server share the server socket. Use
+	 * denServer::WaitForActivity() for them instead.
+	 * 
+	 * \param[in] timeout Maximum time to wait in seconds. Negative value waits until
+	 *                    activity or the next deadline.
+	 * \returns true if datagrams are pending.
+	 */
+	bool WaitForActivity(float timeout);
+	
 	/**
 	 * \brief Create socket.
 	 * 
@@ -233,6 +350,9 @@ public:
 	 * UDP socket. If you have to accept clients using a different transportation method
 	 * overwrite method to create an instance of a subclass of denSocket providing the
 	 * required capabilities.
+	 * 
+	 * For memory addresses the default implementation creates a denSocketMemory. Overwrite
+	 * to wrap the default socket, for example with denSocketImpairment.
 	 */
 	virtual denSocket::Ref CreateSocket();
 	
@@ -241,10 +361,12 @@ public:
 	 * 
 	 * Address is in the format "hostnameOrIP" or "hostnameOrIP:port". You can use a
 	 * resolvable hostname or an IPv4. If the port is not specified the default port
-	 * 3413 is used.
+	 * 3413 is used. Addresses in the format "memory:port" use the in-process memory
+	 * transport.
 	 * 
 	 * If you overwrite CreateSocket() you have to also overwrite this method to resolve
-	 * address using the appropriate method.
+	 * address using the appropriate method. Default implementation uses the connection
+	 * address resolver caching resolved addresses.
 	 */
 	virtual denSocketAddress ResolveAddress(const std::string &address);
 	
@@ -270,6 +392,24 @@ public:
 	 */
 	virtual void MessageReceived(const denMessage::Ref &message);
 	
+	/**
+	 * \brief Message received as view into the received datagram.
+	 * 
+	 * Overwrite to process received messages without copying their data. The view
+	 * references the received datagram. Store the view to keep the data alive after
+	 * returning. Long messages are delivered as view of the assembled message.
+	 * 
+	 * Sockets copy small datagrams into right sized messages. Large datagrams can be
+	 * received into buffers of the maximum datagram size. A stored view of such a datagram
+	 * keeps up to 64 KiB alive. Copy the data instead if it is kept for long.
+	 * 
+	 * Default implementation calls MessageReceived() with the viewed message if the view
+	 * covers the entire message. Otherwise the viewed data is copied into a new message.
+	 * 
+	 * \param[in] view View of received message data.
+	 */
+	virtual void MessageViewReceived(const denMessageView &view);
+	
 	/**
 	 * \brief Host send state to link.
 	 * 
@@ -288,6 +428,17 @@ public:
 	 */
 	virtual denState::Ref CreateState(const denMessage::Ref &message, bool readOnly);
 	
+	/**
+	 * \brief Host dropped state link.
+	 * 
+	 * Called if the remote side unlinks a state using UnlinkState(). The state is no
+	 * longer synchronized. Overwrite to release the state created by CreateState().
+	 * Default implementation does nothing.
+	 * 
+	 * \param[in] state Unlinked state.
+	 */
+	virtual void StateUnlinked(denState &state);
+	
 	/**
 	 * \brief Server owning this connection or nullptr if this is a client side connection.
 	 */
@@ -305,6 +456,8 @@ public:
 	
 	/**
 	 * \brief Connection matches socket and address.
+	 * 
+	 * Connections using a per-peer server socket match the address on any socket.
 	 */
 	bool Matches(denSocket *asocket, const denSocketAddress &address) const;
 	
@@ -320,8 +473,15 @@ private:
 	std::string pRemoteAddress;
 	
 	denSocket::Ref pSocket;
+	denEgressScheduler::Flow::Ref pEgressFlow;
 	denSocketAddress pRealRemoteAddress;
+	uint64_t pConnectCookie;
 	ConnectionState pConnectionState;
+	bool pMemoryTransport;
+	bool pPeerSocket;
+	bool pResolveAsync;
+	denAddressResolver::Ref pAddressResolver;
+	denAddressResolver::Request::Ref pResolveRequest;
 	
 	float pConnectResendInterval;
 	float pConnectTimeout;
@@ -336,6 +496,16 @@ private:
 	ModifiedStateLinks pModifiedStateLinks;
 	int pNextLinkIdentifier;
 	
+	/** \brief Identifier of dropped link not reusable until the drop is acknowledged. */
+	struct DroppedLink{
+		int number;
+		int identifier;
+	};
+	std::list<DroppedLink> pDroppedLinks;
+	
+	std::vector<denMessage::Ref> pLinkUpdates;
+	bool pWriteLinkUpdatesPending;
+	
 	Messages pReliableMessagesSend;
 	Messages pReliableMessagesRecv;
 	int pReliableNumberSend;
@@ -343,26 +513,51 @@ private:
 	int pReliableWindowSize;
 	
 	denMessage::Ref pLongMessage;
-	size_t pLongMessagePartSize;
+	int pDatagramSize;
 	denMessage::Ref pLongLinkStateMessage, pLongLinkStateValues;
 	
+	denSocket::Datagrams pReceivedDatagrams;
+	int pReceiveBatchSize;
+	
+	bool pPathMtuDiscovery;
+	bool pMtuProbePending;
+	int pMtuProbeAttempt;
+	int pMtuProbeAcked;
+	int pMtuProbeLimit;
+	float pElapsedMtuProbe;
+	
 	denLogger::Ref pLogger;
 	
 	friend class denStateLink;
 	
 	void AcceptConnection(denServer &server, const denSocket::Ref &asocket,
-		const denSocketAddress &address, denProtocol::Protocols protocol);
+		const denSocketAddress &address, denProtocol::Protocols protocol, bool peerSocket);
 	
+	void pConnectToAddress(const denSocketAddress &realRemoteAddress);
+	bool pFinishResolve();
 	void pDisconnect(bool notify, bool remoteClosed);
 	void pClearStates();
 	void pCloseSocket();
 	void pRemoveConnectionFromParentServer();
+	void pQueueConnectRequest();
 	void pUpdateStates();
+	void pWriteLinkUpdates();
+	void pAddLinkUpdate(const denMessage::Ref &message, int linkCount);
+	void pQueueLinkUpdates();
+	void pStartMtuProbe();
+	void pUpdateMtuProbe(float elapsedTime);
+	void pSendMtuProbes();
+	void pFinishMtuProbe();
+	void pSetDatagramSize(int size);
 	bool pUpdateTimeouts(float elapsedTime);
+	float pNextDeadline() const;
 	void pInvalidateState(const denState::Ref &state);
+	void pDropStateLink(StateLinks::iterator iterLink);
+	bool pIsLinkIdentifierUsed(int identifier) const;
 	void pAddModifiedStateLink(denStateLink *link);
 	void pProcessQueuedMessages();
 	void pProcessConnectionAck(denMessageReader &reader);
+	void pProcessConnectionCookie(denMessageReader &reader);
 	void pProcessConnectionClose(denMessageReader &reader);
 	void pProcessMessage(denMessageReader &reader);
 	void pProcessReliableMessage(denMessageReader &reader);
@@ -371,16 +566,25 @@ private:
 	void pProcessReliableLinkState(denMessageReader &reader);
 	void pProcessLinkUp(denMessageReader &reader);
 	void pProcessLinkDown(denMessageReader &reader);
+	void pProcessReliableLinkDrop(denMessageReader &reader);
+	void pProcessLinkDrop(denMessageReader &reader);
 	void pProcessLinkState(denMessageReader &reader);
 	void pProcessLinkUpdate(denMessageReader &reader);
 	void pProcessReliableMessageLong(denMessageReader &reader);
 	void pProcessReliableMessageMessageLong(denMessageReader &reader);
 	void pProcessReliableLinkStateLong(denMessageReader &reader);
 	void pProcessLinkStateLong(denMessageReader &reader);
+	void pProcessMtuProbe(denMessageReader &reader);
+	void pProcessMtuProbeAck(denMessageReader &reader);
 	void pAddReliableReceive(denProtocol::CommandCodes type, int number, denMessageReader &reader);
 	void pRemoveSendReliablesDone();
 	void pSendPendingReliables();
+	void pQueueRealMessage(const denRealMessage &message);
+	void pQueueDatagram(denEgressScheduler::Priority priority, const denMessage::Ref &message);
+	void pQueueDatagram(denEgressScheduler::Priority priority, const uint8_t *header,
+		int headerLength, const denMessage::Ref &message, size_t offset, size_t length);
 	
 	friend denServer;
 	denServer *pParentServer;
+	std::list<Ref>::iterator pParentServerEntry;
 };
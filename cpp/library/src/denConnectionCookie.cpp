@@ -0,0 +1,113 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <random>
+#include <chrono>
+#include <string.h>
+#include "denConnectionCookie.h"
+
+// length of a time period in seconds. clients have to answer a cookie within one to
+// two periods
+static const int64_t vPeriodLength = 10;
+
+static inline uint64_t fRotate(uint64_t value, int bits){
+	return (value << bits) | (value >> (64 - bits));
+}
+
+static inline void fSipRound(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3){
+	v0 += v1; v1 = fRotate(v1, 13); v1 ^= v0; v0 = fRotate(v0, 32);
+	v2 += v3; v3 = fRotate(v3, 16); v3 ^= v2;
+	v0 += v3; v3 = fRotate(v3, 21); v3 ^= v0;
+	v2 += v1; v1 = fRotate(v1, 17); v1 ^= v2; v2 = fRotate(v2, 32);
+}
+
+static uint64_t fSipHash(uint64_t key0, uint64_t key1, const uint8_t *data, size_t length){
+	uint64_t v0 = key0 ^ 0x736f6d6570736575ULL;
+	uint64_t v1 = key1 ^ 0x646f72616e646f6dULL;
+	uint64_t v2 = key0 ^ 0x6c7967656e657261ULL;
+	uint64_t v3 = key1 ^ 0x7465646279746573ULL;
+	
+	const size_t end = length - length % 8;
+	size_t i, j;
+	for(i=0; i<end; i+=8){
+		uint64_t m = 0;
+		for(j=0; j<8; j++){
+			m |= (uint64_t)data[i + j] << (8 * j);
+		}
+		v3 ^= m;
+		fSipRound(v0, v1, v2, v3);
+		fSipRound(v0, v1, v2, v3);
+		v0 ^= m;
+	}
+	
+	uint64_t m = (uint64_t)length << 56;
+	for(j=0; j<length%8; j++){
+		m |= (uint64_t)data[end + j] << (8 * j);
+	}
+	v3 ^= m;
+	fSipRound(v0, v1, v2, v3);
+	fSipRound(v0, v1, v2, v3);
+	v0 ^= m;
+	
+	v2 ^= 0xff;
+	for(i=0; i<4; i++){
+		fSipRound(v0, v1, v2, v3);
+	}
+	return v0 ^ v1 ^ v2 ^ v3;
+}
+
+denConnectionCookie::denConnectionCookie(){
+	std::random_device random;
+	pKey0 = ((uint64_t)random() << 32) ^ (uint64_t)random();
+	pKey1 = ((uint64_t)random() << 32) ^ (uint64_t)random();
+}
+
+uint64_t denConnectionCookie::Create(const denSocketAddress &address) const{
+	return pCreate(address, pCurrentPeriod());
+}
+
+bool denConnectionCookie::Verify(const denSocketAddress &address, uint64_t cookie) const{
+	const uint64_t period = pCurrentPeriod();
+	return cookie == pCreate(address, period) || cookie == pCreate(address, period - 1);
+}
+
+uint64_t denConnectionCookie::pCreate(const denSocketAddress &address, uint64_t period) const{
+	uint8_t data[27];
+	memcpy(data, address.values, 16);
+	data[16] = (uint8_t)address.port;
+	data[17] = (uint8_t)(address.port >> 8);
+	data[18] = (uint8_t)address.type;
+	
+	int i;
+	for(i=0; i<8; i++){
+		data[19 + i] = (uint8_t)(period >> (8 * i));
+	}
+	
+	return fSipHash(pKey0, pKey1, data, sizeof(data));
+}
+
+uint64_t denConnectionCookie::pCurrentPeriod(){
+	return (uint64_t)(std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count() / vPeriodLength);
+}
@@ -0,0 +1,59 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "config.h"
+#include "socket/denSocketAddress.h"
+
+/**
+ * \brief Connection cookie.
+ * 
+ * Creates and verifies stateless cookies proving a client receives datagrams send to
+ * the address it claims. The cookie is a SipHash-2-4 of the client address and the
+ * current time period keyed with a random secret. Cookies are valid for the current
+ * and the previous time period. Nothing is stored per client.
+ * 
+ * Thread safe after creation.
+ */
+class denConnectionCookie{
+public:
+	/** \brief Create connection cookie with random secret. */
+	denConnectionCookie();
+	
+	/** \brief Create cookie for address. */
+	uint64_t Create(const denSocketAddress &address) const;
+	
+	/** \brief Cookie is valid for address. */
+	bool Verify(const denSocketAddress &address, uint64_t cookie) const;
+	
+	
+private:
+	uint64_t pCreate(const denSocketAddress &address, uint64_t period) const;
+	static uint64_t pCurrentPeriod();
+	
+	uint64_t pKey0;
+	uint64_t pKey1;
+};
@@ -0,0 +1,117 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "denConnectionTable.h"
+
+static const size_t vInitialCapacity = 64;
+
+denConnectionTable::denConnectionTable() :
+pEntries(vInitialCapacity),
+pMask(vInitialCapacity - 1),
+pCount(0){
+}
+
+denConnection *denConnectionTable::Find(const denSocketAddress &address) const{
+	return pEntries[pFindIndex(address, address.Hash())].connection;
+}
+
+void denConnectionTable::Add(const denSocketAddress &address, denConnection *connection){
+	const size_t hash = address.Hash();
+	Entry *entry = &pEntries[pFindIndex(address, hash)];
+	if(entry->connection){
+		entry->connection = connection;
+		return;
+	}
+	
+	if((pCount + 1) * 2 > pEntries.size()){
+		pGrow();
+		entry = &pEntries[pFindIndex(address, hash)];
+	}
+	
+	entry->address = address;
+	entry->connection = connection;
+	entry->hash = hash;
+	pCount++;
+}
+
+void denConnectionTable::Remove(const denSocketAddress &address, const denConnection *connection){
+	size_t index = pFindIndex(address, address.Hash());
+	if(!pEntries[index].connection || pEntries[index].connection != connection){
+		return;
+	}
+	
+	// shift following entries of the probe sequence back into the hole unless they
+	// are already at or before their home slot
+	size_t next = (index + 1) & pMask;
+	while(pEntries[next].connection){
+		const size_t home = pEntries[next].hash & pMask;
+		if(((next - home) & pMask) >= ((next - index) & pMask)){
+			pEntries[index] = pEntries[next];
+			index = next;
+		}
+		next = (next + 1) & pMask;
+	}
+	
+	pEntries[index].connection = nullptr;
+	pCount--;
+}
+
+void denConnectionTable::RemoveAll(){
+	std::vector<Entry>::iterator iter;
+	for(iter = pEntries.begin(); iter != pEntries.end(); iter++){
+		iter->connection = nullptr;
+	}
+	pCount = 0;
+}
+
+size_t denConnectionTable::pFindIndex(const denSocketAddress &address, size_t hash) const{
+	size_t index = hash & pMask;
+	while(pEntries[index].connection){
+		const Entry &entry = pEntries[index];
+		if(entry.hash == hash && entry.address == address){
+			break;
+		}
+		index = (index + 1) & pMask;
+	}
+	return index;
+}
+
+void denConnectionTable::pGrow(){
+	std::vector<Entry> entries(pEntries.size() * 2);
+	pEntries.swap(entries);
+	pMask = pEntries.size() - 1;
+	
+	std::vector<Entry>::const_iterator iter;
+	for(iter = entries.cbegin(); iter != entries.cend(); iter++){
+		if(!iter->connection){
+			continue;
+		}
+		
+		size_t index = iter->hash & pMask;
+		while(pEntries[index].connection){
+			index = (index + 1) & pMask;
+		}
+		pEntries[index] = *iter;
+	}
+}
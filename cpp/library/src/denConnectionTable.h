@@ -0,0 +1,80 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+#include "config.h"
+#include "socket/denSocketAddress.h"
+
+class denConnection;
+
+/**
+ * \brief Connection table.
+ * 
+ * Maps remote addresses to connections using open addressing with linear probing.
+ * Finding, adding and removing connections takes constant time on average. Removing
+ * shifts following entries back instead of leaving deleted markers so lookups stay
+ * short after many clients connected and disconnected. The table grows once half full.
+ * 
+ * Connections are not owned by the table.
+ */
+class denConnectionTable{
+public:
+	/** \brief Create connection table. */
+	denConnectionTable();
+	
+	/** \brief Count of connections. */
+	inline size_t GetCount() const{ return pCount; }
+	
+	/** \brief Connection with remote address or nullptr if absent. */
+	denConnection *Find(const denSocketAddress &address) const;
+	
+	/** \brief Add connection with remote address replacing existing connection if present. */
+	void Add(const denSocketAddress &address, denConnection *connection);
+	
+	/**
+	 * \brief Remove connection with remote address if present.
+	 * 
+	 * Nothing is removed if a different connection has been added with the same address.
+	 */
+	void Remove(const denSocketAddress &address, const denConnection *connection);
+	
+	/** \brief Remove all connections. */
+	void RemoveAll();
+	
+private:
+	struct Entry{
+		denSocketAddress address;
+		denConnection *connection = nullptr;
+		size_t hash = 0;
+	};
+	
+	size_t pFindIndex(const denSocketAddress &address, size_t hash) const;
+	void pGrow();
+	
+	std::vector<Entry> pEntries;
+	size_t pMask;
+	size_t pCount;
+};
@@ -0,0 +1,211 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdexcept>
+#include <algorithm>
+#include <string.h>
+#include "denEgressScheduler.h"
+
+// bytes a flow can send each round. about one full sized datagram
+static const int vQuantum = 1500;
+
+// seconds of budget the token bucket can hold. limits bursts after idle periods
+static const float vBurstTime = 0.05f;
+
+
+// denEgressScheduler::Flow
+/////////////////////////////
+
+denEgressScheduler::Flow::Flow(denEgressScheduler &scheduler, const denSocket::Ref &socket,
+const denSocketAddress &address) :
+pScheduler(scheduler),
+pSocket(socket),
+pAddress(address),
+pQueuedBytes(0),
+pDeficit(0),
+pActive(false),
+pInTurn(false){
+}
+
+denEgressScheduler::Flow::~Flow() noexcept{
+	Clear();
+}
+
+void denEgressScheduler::Flow::Queue(Priority priority, const denMessage::Ref &message){
+	Datagram datagram;
+	datagram.headerLength = 0;
+	datagram.message = message;
+	datagram.offset = 0;
+	datagram.length = message->Item().GetLength();
+	pPush(priority, std::move(datagram));
+}
+
+void denEgressScheduler::Flow::Queue(Priority priority, const uint8_t *header, int headerLength,
+const denMessage::Ref &message, size_t offset, size_t length){
+	if(headerLength < 0 || headerLength > denSocket::vMaxHeaderLength){
+		throw std::invalid_argument("headerLength out of range");
+	}
+	
+	Datagram datagram;
+	memcpy(datagram.header, header, headerLength);
+	datagram.headerLength = headerLength;
+	datagram.message = message;
+	datagram.offset = offset;
+	datagram.length = length;
+	pPush(priority, std::move(datagram));
+}
+
+void denEgressScheduler::Flow::Clear(){
+	pQueues[0].clear();
+	pQueues[1].clear();
+	pQueuedBytes = 0;
+	pScheduler.pDeactivate(*this);
+}
+
+void denEgressScheduler::Flow::pPush(Priority priority, Datagram &&datagram){
+	pQueuedBytes += datagram.headerLength + datagram.length;
+	pQueues[(int)priority].push_back(std::move(datagram));
+	pScheduler.pActivate(*this);
+}
+
+denEgressScheduler::Flow::Datagram *denEgressScheduler::Flow::pNext(){
+	if(!pQueues[0].empty()){
+		return &pQueues[0].front();
+	}
+	if(!pQueues[1].empty()){
+		return &pQueues[1].front();
+	}
+	return nullptr;
+}
+
+void denEgressScheduler::Flow::pPop(){
+	std::deque<Datagram> &queue = pQueues[pQueues[0].empty() ? 1 : 0];
+	pQueuedBytes -= queue.front().headerLength + queue.front().length;
+	queue.pop_front();
+}
+
+
+// denEgressScheduler
+///////////////////////
+
+denEgressScheduler::denEgressScheduler(int bandwidth) :
+pBandwidth(bandwidth),
+pBurst(std::max((float)bandwidth * vBurstTime, (float)vQuantum)),
+pTokens(pBurst){
+	if(bandwidth < 1){
+		throw std::invalid_argument("bandwidth < 1");
+	}
+}
+
+denEgressScheduler::Flow::Ref denEgressScheduler::CreateFlow(
+const denSocket::Ref &socket, const denSocketAddress &address){
+	return std::make_shared<Flow>(*this, socket, address);
+}
+
+float denEgressScheduler::GetSendDelay() const{
+	if(pActive.empty()){
+		return -1.0f;
+	}
+	if(pTokens > 0.0f){
+		return 0.0f;
+	}
+	return -pTokens / (float)pBandwidth;
+}
+
+void denEgressScheduler::Send(float elapsedTime, std::vector<denSocket*> &sockets){
+	pTokens = std::min(pTokens + (float)pBandwidth * elapsedTime, pBurst);
+	
+	while(pTokens > 0.0f && !pActive.empty()){
+		Flow &flow = *pActive.front();
+		
+		// a flow gets a quantum each time its turn starts. a turn interrupted by running
+		// out of budget continues during the next call without adding a quantum again
+		if(!flow.pInTurn){
+			flow.pDeficit += vQuantum;
+			flow.pInTurn = true;
+		}
+		
+		bool queued = false;
+		Flow::Datagram *datagram = flow.pNext();
+		
+		while(datagram && pTokens > 0.0f){
+			const int size = datagram->headerLength + (int)datagram->length;
+			if(size > flow.pDeficit){
+				break;
+			}
+			
+			if(datagram->headerLength > 0){
+				flow.pSocket->QueueDatagram(datagram->header, datagram->headerLength,
+					datagram->message, datagram->offset, datagram->length, flow.pAddress);
+				
+			}else{
+				flow.pSocket->QueueDatagram(datagram->message, flow.pAddress);
+			}
+			
+			flow.pDeficit -= size;
+			pTokens -= (float)size;
+			queued = true;
+			
+			flow.pPop();
+			datagram = flow.pNext();
+		}
+		
+		if(queued){
+			sockets.push_back(flow.pSocket.get());
+		}
+		
+		if(!datagram){
+			pDeactivate(flow);
+			
+		}else if(datagram->headerLength + (int)datagram->length > flow.pDeficit){
+			// turn is over. move to the end keeping the deficit for the next turn
+			flow.pInTurn = false;
+			pActive.pop_front();
+			pActive.push_back(&flow);
+			
+		}else{
+			break;
+		}
+	}
+}
+
+void denEgressScheduler::pActivate(Flow &flow){
+	if(!flow.pActive){
+		flow.pActive = true;
+		flow.pInTurn = false;
+		flow.pDeficit = 0;
+		pActive.push_back(&flow);
+	}
+}
+
+void denEgressScheduler::pDeactivate(Flow &flow){
+	if(!flow.pActive){
+		return;
+	}
+	
+	flow.pActive = false;
+	flow.pInTurn = false;
+	flow.pDeficit = 0;
+	pActive.erase(std::find(pActive.begin(), pActive.end(), &flow));
+}
@@ -0,0 +1,152 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <deque>
+#include <stdint.h>
+#include "config.h"
+#include "message/denMessage.h"
+#include "socket/denSocket.h"
+#include "socket/denSocketAddress.h"
+
+/**
+ * \brief Egress scheduler.
+ * 
+ * Paces datagrams send by connections to a bandwidth budget. Each connection queues its
+ * datagrams in a flow. Flows are served using deficit round robin so each connection gets
+ * an equal share of the budget no matter how many datagrams it queues. The budget is
+ * enforced using a token bucket refilled by the elapsed time passed to Send(). Datagrams
+ * exceeding the budget stay queued until the next call to Send().
+ * 
+ * Inside a flow realtime datagrams are send before bulk datagrams. This keeps state
+ * updates and unreliable messages responsive while large reliable transfers to the same
+ * client are in progress.
+ * 
+ * Not thread safe. Use one scheduler per thread sending datagrams.
+ */
+class denEgressScheduler{
+public:
+	/** \brief Shared pointer. */
+	typedef std::shared_ptr<denEgressScheduler> Ref;
+	
+	/** \brief Datagram priority inside a flow. */
+	enum class Priority{
+		realtime, //<! Send first. Link updates and unreliable messages.
+		bulk //<! Send once no realtime datagrams are queued. Reliable messages.
+	};
+	
+	/** \brief Flow of datagrams to one remote address. */
+	class Flow{
+	public:
+		/** \brief Shared pointer. */
+		typedef std::shared_ptr<Flow> Ref;
+		
+		/** \brief Create flow. Use denEgressScheduler::CreateFlow(). */
+		Flow(denEgressScheduler &scheduler, const denSocket::Ref &socket, const denSocketAddress &address);
+		
+		/** \brief Clean up flow dropping queued datagrams. */
+		~Flow() noexcept;
+		
+		/** \brief Count of queued bytes. */
+		inline size_t GetQueuedBytes() const{ return pQueuedBytes; }
+		
+		/** \brief Queue datagram. */
+		void Queue(Priority priority, const denMessage::Ref &message);
+		
+		/** \brief Queue datagram with header in front of message slice. */
+		void Queue(Priority priority, const uint8_t *header, int headerLength,
+			const denMessage::Ref &message, size_t offset, size_t length);
+		
+		/** \brief Drop queued datagrams. */
+		void Clear();
+		
+		
+	private:
+		struct Datagram{
+			uint8_t header[denSocket::vMaxHeaderLength];
+			int headerLength;
+			denMessage::Ref message;
+			size_t offset;
+			size_t length;
+		};
+		
+		friend denEgressScheduler;
+		void pPush(Priority priority, Datagram &&datagram);
+		Datagram *pNext();
+		void pPop();
+		
+		denEgressScheduler &pScheduler;
+		denSocket::Ref pSocket;
+		denSocketAddress pAddress;
+		std::deque<Datagram> pQueues[2];
+		size_t pQueuedBytes;
+		int pDeficit;
+		bool pActive;
+		bool pInTurn;
+	};
+	
+	/**
+	 * \brief Create egress scheduler.
+	 * \param[in] bandwidth Budget in bytes per second.
+	 */
+	denEgressScheduler(int bandwidth);
+	
+	/** \brief Budget in bytes per second. */
+	inline int GetBandwidth() const{ return pBandwidth; }
+	
+	/** \brief Create flow for connection. */
+	Flow::Ref CreateFlow(const denSocket::Ref &socket, const denSocketAddress &address);
+	
+	/** \brief Datagrams are queued. */
+	inline bool HasPending() const{ return !pActive.empty(); }
+	
+	/**
+	 * \brief Seconds until datagrams can be send.
+	 * 
+	 * Returns -1 if no datagrams are queued and 0 if datagrams can be send right away.
+	 */
+	float GetSendDelay() const;
+	
+	/**
+	 * \brief Refill budget and queue datagrams to their sockets within the budget.
+	 * 
+	 * Sockets datagrams have been queued to are added to sockets. Call FlushDatagrams()
+	 * on them afterwards. Sockets can be added multiple times.
+	 */
+	void Send(float elapsedTime, std::vector<denSocket*> &sockets);
+	
+	
+private:
+	friend Flow;
+	void pActivate(Flow &flow);
+	void pDeactivate(Flow &flow);
+	
+	int pBandwidth;
+	float pBurst;
+	float pTokens;
+	std::deque<Flow*> pActive;
+};
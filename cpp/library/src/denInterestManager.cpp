@@ -0,0 +1,323 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "denInterestManager.h"
+
+// cell coordinates are packed into 21 bits per axis
+static const int64_t vCellCoordinateLimit = (int64_t)1 << 20;
+static const uint64_t vCellCoordinateMask = ((uint64_t)1 << 21) - 1;
+
+static double fDistanceSquared(const denVector3 &a, const denVector3 &b){
+	const double x = a.x - b.x;
+	const double y = a.y - b.y;
+	const double z = a.z - b.z;
+	return x * x + y * y + z * z;
+}
+
+
+denInterestManager::denInterestManager(double cellSize, double linkRange, double unlinkRange) :
+pCellSize(cellSize),
+pLinkRange(0.0),
+pUnlinkRange(0.0),
+pMaxLinksPerUpdate(0){
+	if(!(cellSize > 0.0)){
+		throw std::invalid_argument("cellSize <= 0");
+	}
+	SetRanges(linkRange, unlinkRange);
+}
+
+denInterestManager::~denInterestManager() noexcept{
+}
+
+void denInterestManager::SetRanges(double linkRange, double unlinkRange){
+	if(!(linkRange >= 0.0)){
+		throw std::invalid_argument("linkRange < 0");
+	}
+	if(!(unlinkRange >= linkRange)){
+		throw std::invalid_argument("unlinkRange < linkRange");
+	}
+	
+	pLinkRange = linkRange;
+	pUnlinkRange = unlinkRange;
+}
+
+void denInterestManager::SetMaxLinksPerUpdate(int count){
+	if(count < 0){
+		throw std::invalid_argument("count < 0");
+	}
+	pMaxLinksPerUpdate = count;
+}
+
+void denInterestManager::AddState(const denState::Ref &state, const denMessage::Ref &message,
+const denVector3 &position, bool readOnly){
+	if(!state){
+		throw std::invalid_argument("state is nullptr");
+	}
+	if(!message){
+		throw std::invalid_argument("message is nullptr");
+	}
+	if(pStates.find(state.get()) != pStates.cend()){
+		throw std::invalid_argument("state present");
+	}
+	
+	std::unique_ptr<Entry> entry(new Entry);
+	entry->state = state;
+	entry->message = message;
+	entry->position = position;
+	entry->readOnly = readOnly;
+	entry->cell = pCellKey(position);
+	
+	pAddToCell(*entry);
+	pStates[state.get()] = std::move(entry);
+}
+
+void denInterestManager::SetStatePosition(const denState::Ref &state, const denVector3 &position){
+	Entries::const_iterator iter(pStates.find(state.get()));
+	if(iter == pStates.cend()){
+		throw std::invalid_argument("state absent");
+	}
+	
+	Entry &entry = *iter->second;
+	entry.position = position;
+	
+	const uint64_t cell = pCellKey(position);
+	if(cell != entry.cell){
+		pRemoveFromCell(entry);
+		entry.cell = cell;
+		pAddToCell(entry);
+	}
+}
+
+void denInterestManager::RemoveState(const denState::Ref &state){
+	Entries::iterator iter(pStates.find(state.get()));
+	if(iter == pStates.end()){
+		throw std::invalid_argument("state absent");
+	}
+	
+	Entry * const entry = iter->second.get();
+	
+	Observers::const_iterator iterObserver;
+	for(iterObserver = pObservers.cbegin(); iterObserver != pObservers.cend(); iterObserver++){
+		Observer &observer = *iterObserver->second;
+		if(observer.linked.erase(entry) > 0){
+			observer.connection->UnlinkState(state);
+		}
+	}
+	
+	pRemoveFromCell(*entry);
+	pStates.erase(iter);
+}
+
+void denInterestManager::AddObserver(const denConnection::Ref &connection, const denVector3 &position){
+	if(!connection){
+		throw std::invalid_argument("connection is nullptr");
+	}
+	if(!connection->GetCanUnlinkStates()){
+		throw std::invalid_argument("connection does not support unlinking states");
+	}
+	if(pObservers.find(connection.get()) != pObservers.cend()){
+		throw std::invalid_argument("observer present");
+	}
+	
+	std::unique_ptr<Observer> observer(new Observer);
+	observer->connection = connection;
+	observer->position = position;
+	pObservers[connection.get()] = std::move(observer);
+}
+
+void denInterestManager::SetObserverPosition(const denConnection::Ref &connection, const denVector3 &position){
+	Observers::const_iterator iter(pObservers.find(connection.get()));
+	if(iter == pObservers.cend()){
+		throw std::invalid_argument("observer absent");
+	}
+	iter->second->position = position;
+}
+
+void denInterestManager::RemoveObserver(const denConnection::Ref &connection){
+	Observers::iterator iter(pObservers.find(connection.get()));
+	if(iter == pObservers.end()){
+		throw std::invalid_argument("observer absent");
+	}
+	
+	pUnlinkAll(*iter->second);
+	pObservers.erase(iter);
+}
+
+size_t denInterestManager::GetLinkedCount(const denConnection::Ref &connection) const{
+	Observers::const_iterator iter(pObservers.find(connection.get()));
+	if(iter == pObservers.cend()){
+		throw std::invalid_argument("observer absent");
+	}
+	return iter->second->linked.size();
+}
+
+void denInterestManager::Update(){
+	Observers::iterator iter;
+	for(iter = pObservers.begin(); iter != pObservers.end(); ){
+		// closing connections drop all links. forget the observer
+		if(!iter->second->connection->GetConnected()){
+			iter = pObservers.erase(iter);
+			continue;
+		}
+		
+		pUpdateObserver(*iter->second);
+		iter++;
+	}
+}
+
+
+
+int64_t denInterestManager::pCellCoordinate(double value) const{
+	const double coordinate = std::floor(value / pCellSize);
+	if(!(coordinate > (double)-vCellCoordinateLimit)){
+		return -vCellCoordinateLimit;
+	}
+	if(!(coordinate < (double)(vCellCoordinateLimit - 1))){
+		return vCellCoordinateLimit - 1;
+	}
+	return (int64_t)coordinate;
+}
+
+uint64_t denInterestManager::pCellKey(const denVector3 &position) const{
+	return pCellKey(pCellCoordinate(position.x), pCellCoordinate(position.y), pCellCoordinate(position.z));
+}
+
+uint64_t denInterestManager::pCellKey(int64_t x, int64_t y, int64_t z){
+	return ((uint64_t)(x + vCellCoordinateLimit) & vCellCoordinateMask)
+		| (((uint64_t)(y + vCellCoordinateLimit) & vCellCoordinateMask) << 21)
+		| (((uint64_t)(z + vCellCoordinateLimit) & vCellCoordinateMask) << 42);
+}
+
+void denInterestManager::pAddToCell(Entry &entry){
+	pCells[entry.cell].push_back(&entry);
+}
+
+void denInterestManager::pRemoveFromCell(Entry &entry){
+	Cells::iterator iter(pCells.find(entry.cell));
+	if(iter == pCells.end()){
+		return;
+	}
+	
+	std::vector<Entry*> &entries = iter->second;
+	std::vector<Entry*>::iterator iterEntry(std::find(entries.begin(), entries.end(), &entry));
+	if(iterEntry != entries.end()){
+		*iterEntry = entries.back();
+		entries.pop_back();
+	}
+	
+	if(entries.empty()){
+		pCells.erase(iter);
+	}
+}
+
+void denInterestManager::pUpdateObserver(Observer &observer){
+	denConnection &connection = *observer.connection;
+	const denVector3 &position = observer.position;
+	
+	// unlink states beyond the unlink range
+	const double unlinkRangeSquared = pUnlinkRange * pUnlinkRange;
+	std::unordered_set<Entry*>::iterator iterLinked;
+	for(iterLinked = observer.linked.begin(); iterLinked != observer.linked.end(); ){
+		if(fDistanceSquared((*iterLinked)->position, position) > unlinkRangeSquared){
+			connection.UnlinkState((*iterLinked)->state);
+			iterLinked = observer.linked.erase(iterLinked);
+			
+		}else{
+			iterLinked++;
+		}
+	}
+	
+	// find states inside the link range not linked yet
+	const double linkRangeSquared = pLinkRange * pLinkRange;
+	const int64_t fromX = pCellCoordinate(position.x - pLinkRange);
+	const int64_t fromY = pCellCoordinate(position.y - pLinkRange);
+	const int64_t fromZ = pCellCoordinate(position.z - pLinkRange);
+	const int64_t toX = pCellCoordinate(position.x + pLinkRange);
+	const int64_t toY = pCellCoordinate(position.y + pLinkRange);
+	const int64_t toZ = pCellCoordinate(position.z + pLinkRange);
+	int64_t x, y, z;
+	
+	pCandidates.clear();
+	
+	for(z=fromZ; z<=toZ; z++){
+		for(y=fromY; y<=toY; y++){
+			for(x=fromX; x<=toX; x++){
+				const Cells::const_iterator iterCell(pCells.find(pCellKey(x, y, z)));
+				if(iterCell == pCells.cend()){
+					continue;
+				}
+				
+				std::vector<Entry*>::const_iterator iterEntry;
+				for(iterEntry = iterCell->second.cbegin(); iterEntry != iterCell->second.cend(); iterEntry++){
+					const double distance = fDistanceSquared((*iterEntry)->position, position);
+					if(distance <= linkRangeSquared && observer.linked.find(*iterEntry) == observer.linked.cend()){
+						pCandidates.push_back({*iterEntry, distance});
+					}
+				}
+			}
+		}
+	}
+	
+	if(pCandidates.empty()){
+		return;
+	}
+	
+	// link closest states first if the count of links per update is limited
+	if(pMaxLinksPerUpdate > 0 && pCandidates.size() > (size_t)pMaxLinksPerUpdate){
+		std::sort(pCandidates.begin(), pCandidates.end(), [](const Candidate &a, const Candidate &b){
+			return a.distance < b.distance;
+		});
+	}
+	
+	int linkCount = 0;
+	std::vector<Candidate>::const_iterator iterCandidate;
+	for(iterCandidate = pCandidates.cbegin(); iterCandidate != pCandidates.cend(); iterCandidate++){
+		if(pMaxLinksPerUpdate > 0 && linkCount == pMaxLinksPerUpdate){
+			break;
+		}
+		
+		Entry &entry = *iterCandidate->entry;
+		if(connection.IsStateLinked(entry.state)){
+			// linked by the application
+			continue;
+		}
+		
+		connection.LinkState(entry.message, entry.state, entry.readOnly);
+		observer.linked.insert(&entry);
+		linkCount++;
+	}
+}
+
+void denInterestManager::pUnlinkAll(Observer &observer){
+	if(observer.connection->GetConnected()){
+		std::unordered_set<Entry*>::const_iterator iter;
+		for(iter = observer.linked.cbegin(); iter != observer.linked.cend(); iter++){
+			observer.connection->UnlinkState((*iter)->state);
+		}
+	}
+	observer.linked.clear();
+}
@@ -0,0 +1,186 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "config.h"
+#include "denConnection.h"
+#include "math/denVector3.h"
+#include "message/denMessage.h"
+#include "state/denState.h"
+
+/**
+ * \brief Spatial interest management.
+ * 
+ * Links states to connections automatically depending on distance. States register
+ * with a position and a link message. Connections register as observers with a
+ * position. Update() links states coming closer than the link range to an observer
+ * and unlinks states moving farther away than the unlink range. Using an unlink range
+ * larger than the link range avoids states near the border linking and unlinking
+ * repeatedly.
+ * 
+ * States are stored in a spatial hash of cubic cells. Update() visits only the cells
+ * inside the link range of each observer. Choose a cell size similar to the link range.
+ * 
+ * States linked by the application directly, like the state of the observer itself,
+ * are skipped and never unlinked. Clients receive unlinked states using
+ * denConnection::StateUnlinked(). Observers have to support unlinking states which
+ * requires clients speaking DENetworkProtocol2.
+ * 
+ * Not thread safe. Call methods from the thread updating the server.
+ */
+class denInterestManager{
+public:
+	/** \brief Shared pointer. */
+	typedef std::shared_ptr<denInterestManager> Ref;
+	
+	/**
+	 * \brief Create interest manager.
+	 * \param[in] cellSize Size of spatial hash cells. Has to be larger than 0.
+	 * \param[in] linkRange Distance below which states are linked.
+	 * \param[in] unlinkRange Distance above which states are unlinked. Has to be at
+	 *                        least \em linkRange.
+	 */
+	denInterestManager(double cellSize, double linkRange, double unlinkRange);
+	
+	/** \brief Clean up interest manager. */
+	~denInterestManager() noexcept;
+	
+	/** \brief Cell size. */
+	inline double GetCellSize() const{ return pCellSize; }
+	
+	/** \brief Link range. */
+	inline double GetLinkRange() const{ return pLinkRange; }
+	
+	/** \brief Unlink range. */
+	inline double GetUnlinkRange() const{ return pUnlinkRange; }
+	
+	/** \brief Set link and unlink range. */
+	void SetRanges(double linkRange, double unlinkRange);
+	
+	/** \brief Maximum count of states linked per observer and update or 0 for no limit. */
+	inline int GetMaxLinksPerUpdate() const{ return pMaxLinksPerUpdate; }
+	
+	/**
+	 * \brief Set maximum count of states linked per observer and update or 0 for no limit.
+	 * 
+	 * Observers entering a crowded area link the closest states first and the rest
+	 * during the next updates. This spreads link state traffic. Default is 0.
+	 */
+	void SetMaxLinksPerUpdate(int count);
+	
+	/** \brief Count of states. */
+	inline size_t GetStateCount() const{ return pStates.size(); }
+	
+	/** \brief Count of observers. */
+	inline size_t GetObserverCount() const{ return pObservers.size(); }
+	
+	/**
+	 * \brief Add state.
+	 * 
+	 * \param[in] state State to add.
+	 * \param[in] message Message used to link the state. See denConnection::LinkState().
+	 * \param[in] position Position of state.
+	 * \param[in] readOnly State is linked read-only.
+	 */
+	void AddState(const denState::Ref &state, const denMessage::Ref &message,
+		const denVector3 &position, bool readOnly = true);
+	
+	/** \brief Set position of state. */
+	void SetStatePosition(const denState::Ref &state, const denVector3 &position);
+	
+	/** \brief Remove state unlinking it from all observers. */
+	void RemoveState(const denState::Ref &state);
+	
+	/**
+	 * \brief Add observer.
+	 * \throws std::invalid_argument Connection does not support unlinking states. See
+	 *                               denConnection::GetCanUnlinkStates().
+	 */
+	void AddObserver(const denConnection::Ref &connection, const denVector3 &position);
+	
+	/** \brief Set position of observer. */
+	void SetObserverPosition(const denConnection::Ref &connection, const denVector3 &position);
+	
+	/** \brief Remove observer unlinking all states linked by the interest manager. */
+	void RemoveObserver(const denConnection::Ref &connection);
+	
+	/** \brief Count of states linked to observer by the interest manager. */
+	size_t GetLinkedCount(const denConnection::Ref &connection) const;
+	
+	/**
+	 * \brief Update links.
+	 * 
+	 * Links and unlinks states for all observers. Observers no longer connected are
+	 * removed. Call after updating positions, typically once per server update.
+	 */
+	void Update();
+	
+	
+private:
+	struct Entry{
+		denState::Ref state;
+		denMessage::Ref message;
+		denVector3 position;
+		bool readOnly;
+		uint64_t cell;
+	};
+	
+	struct Observer{
+		denConnection::Ref connection;
+		denVector3 position;
+		std::unordered_set<Entry*> linked;
+	};
+	
+	struct Candidate{
+		Entry *entry;
+		double distance;
+	};
+	
+	typedef std::unordered_map<denState*, std::unique_ptr<Entry>> Entries;
+	typedef std::unordered_map<uint64_t, std::vector<Entry*>> Cells;
+	typedef std::unordered_map<denConnection*, std::unique_ptr<Observer>> Observers;
+	
+	int64_t pCellCoordinate(double value) const;
+	uint64_t pCellKey(const denVector3 &position) const;
+	static uint64_t pCellKey(int64_t x, int64_t y, int64_t z);
+	void pAddToCell(Entry &entry);
+	void pRemoveFromCell(Entry &entry);
+	void pUpdateObserver(Observer &observer);
+	void pUnlinkAll(Observer &observer);
+	
+	double pCellSize;
+	double pLinkRange;
+	double pUnlinkRange;
+	int pMaxLinksPerUpdate;
+	
+	Entries pStates;
+	Cells pCells;
+	Observers pObservers;
+	std::vector<Candidate> pCandidates;
+};
@@ -25,7 +25,10 @@
 #pragma once
 
 #include <memory>
+#include <stdint.h>
 #include <vector>
+#include <mutex>
+#include <atomic>
 #include "config.h"
 
 template<class T> class denPool;
@@ -53,26 +56,43 @@ private:
 
 /**
  * \brief Pool.
+ * 
+ * Thread safe. Items can be taken from and returned to the pool by different threads.
  */
 template<class T> class denPool{
 public:
 	/** \brief Create pool. */
-	denPool() = default;
+	denPool() : pCreatedCount(0){}
 	
 	/** \brief Get item from pool or create a new one if empty. */
 	typename denPoolItem<T>::Ref Get(){
-		if(pItems.empty()){
-			return std::make_shared<denPoolItem<T>>(*this, std::make_shared<T>());
-		}else{
-			typename std::vector<std::shared_ptr<T>>::iterator iter(pItems.end() - 1);
-			const typename denPoolItem<T>::Ref item(std::make_shared<denPoolItem<T>>(*this, *iter));
-			pItems.erase(iter);
-			return item;
+		std::shared_ptr<T> realItem;
+		{
+		const std::lock_guard<std::mutex> guard(pMutex);
+		if(!pItems.empty()){
+			realItem = pItems.back();
+			pItems.pop_back();
+		}
 		}
+		
+		if(!realItem){
+			pCreatedCount++;
+			realItem = std::make_shared<T>();
+		}
+		return std::make_shared<denPoolItem<T>>(*this, realItem);
 	}
 	
+	/**
+	 * \brief Count of items created because the pool was empty.
+	 * 
+	 * Each created item is a memory allocation. Compare the count before and after an
+	 * operation to find the allocations caused by it.
+	 */
+	inline uint64_t GetCreatedCount() const{ return pCreatedCount; }
+	
 	/** \brief Clear pool. */
 	void Clear(){
+		const std::lock_guard<std::mutex> guard(pMutex);
 		pItems.clear();
 	}
 	
@@ -81,8 +101,11 @@ private:
 	
 	/** \brief Return item to pool. */
 	void Return(const std::shared_ptr<T> &realItem){
+		const std::lock_guard<std::mutex> guard(pMutex);
 		pItems.push_back(realItem);
 	}
 	
 	std::vector<std::shared_ptr<T>> pItems;
+	std::mutex pMutex;
+	std::atomic<uint64_t> pCreatedCount;
 };
@@ -28,4 +28,5 @@
 // force explicit destruction order
 
 denPool<denMessage> denMessage::pPool;
+denPool<denMessage> denMessage::pReceivePool;
 denPool<denRealMessage> denRealMessage::pPool;
@@ -31,10 +31,14 @@ namespace denProtocol{
 	enum class CommandCodes{
 		/**
 		 *  Connection Request:
-		 *  [ 0 ] [ protocols ]
+		 *  [ 0 ] [ protocols ] [ cookie:uint64 ]
 		 *  
 		 *  protocols:  // list of protocols supported by client
 		 *     [ count:uint16 ] [ protocol:uint16 ]{ 1..n }
+		 *  
+		 *  cookie:
+		 *     Cookie received with the last connection cookie message or 0. Optional.
+		 *     Servers not requiring cookies ignore it.
 		 */
 		connectionRequest = 0,
 		
@@ -148,6 +152,51 @@ namespace denProtocol{
 		 *    [ value_count:uint16 ] ( [ value_type:uint8 ] [ value_data:* ] ){ 1..n }
 		 */
 		reliableLinkStateLong = 11,
+		
+		/**
+		 * Path MTU probe:
+		 * [ 12 ] [ size:uint16 ] [ padding:uint8 ]{ 0..n }
+		 * 
+		 * size:
+		 *    Size of the probe datagram in bytes including padding. Probes are send
+		 *    with fragmentation disabled. Probes with a size not matching the received
+		 *    datagram size are ignored.
+		 */
+		mtuProbe = 12,
+		
+		/**
+		 * Path MTU probe ack:
+		 * [ 13 ] [ size:uint16 ]
+		 * 
+		 * size:
+		 *    Size of the received probe datagram.
+		 */
+		mtuProbeAck = 13,
+		
+		/**
+		 * Connection cookie:
+		 * [ 14 ] [ cookie:uint64 ]
+		 * 
+		 * Send by servers requiring cookies in response to connection requests without a
+		 * valid cookie. The client resends the connection request with the cookie.
+		 * 
+		 * cookie:
+		 *    Cookie to send with the connection request.
+		 */
+		connectionCookie = 14,
+		
+		/**
+		 * Link drop:
+		 * [ 15 ] [ number:uint16 ] [ link_id:uint16 ]
+		 * 
+		 * Requires protocol DENetworkProtocol2.
+		 * 
+		 * Send reliable to drop a state link. The remote side removes the link and
+		 * stops synchronizing the state. Processed in order with link state messages.
+		 * The sender does not reuse the link identifier before the drop is acknowledged.
+		 * Link traffic for identifiers not linked anymore is ignored.
+		 */
+		reliableLinkDrop = 15,
 	};
 	
 	/**
@@ -232,6 +281,7 @@ namespace denProtocol{
 	 * \brief Supported protocols.
 	 */
 	enum class Protocols{
-		DENetworkProtocol = 0 //<! Drag[en]gine Network Protocol: Version 1
+		DENetworkProtocol = 0, //<! Drag[en]gine Network Protocol: Version 1
+		DENetworkProtocol2 = 1 //<! Drag[en]gine Network Protocol: Version 2. Adds reliableLinkDrop
 	};
 }
@@ -26,6 +26,9 @@
 
 denRealMessage::denRealMessage() :
 message(denMessage::Pool().Get()),
+headerLength(0),
+payloadOffset(0),
+payloadLength(0),
 number(-1),
 state(State::pending),
 type(denProtocol::CommandCodes::reliableMessage),
@@ -32,6 +32,7 @@
 #include "config.h"
 #include "denProtocolEnums.h"
 #include "message/denMessage.h"
+#include "socket/denSocket.h"
 
 /**
  * \brief Real message send across the network.
@@ -50,6 +51,19 @@ public:
 	
 	denMessage::Ref message;
 	
+	/**
+	 * \brief Payload message or nullptr.
+	 * 
+	 * If not nullptr the datagram is header followed by the payload range instead of
+	 * message. Avoids copying the payload of messages send by the application.
+	 */
+	denMessage::Ref payload;
+	
+	uint8_t header[denSocket::vMaxHeaderLength];
+	int headerLength;
+	size_t payloadOffset;
+	size_t payloadLength;
+	
 	int number;
 	State state;
 	denProtocol::CommandCodes type;
@@ -33,8 +33,27 @@
 #include "message/denMessageWriter.h"
 #include "socket/denSocketShared.h"
 
+// states lock held by this thread and if it is exclusive. used to allow nesting locks
+static thread_local std::shared_timed_mutex *vLockedStates = nullptr;
+static thread_local bool vLockedStatesExclusive = false;
+
+// server a shard is updated of by this thread. used to queue broadcasts from callbacks
+static thread_local const denServer *vUpdatingServer = nullptr;
+
 denServer::denServer() :
-pListening(false){
+pShardCount(1),
+pShardHashSteering(false),
+pUpdateThreadCount(1),
+pSerializeThreadCount(1),
+pPeerSockets(false),
+pConnectionCookies(false),
+pReceiveBufferSize(0),
+pSendBufferSize(0),
+pEgressBandwidth(0),
+pListening(false),
+pStopListening(false),
+pMemoryTransport(false),
+pReceiveBatchSize(32){
 }
 
 denServer::~denServer() noexcept{
@@ -70,13 +89,86 @@ void denServer::ListenOn(const std::string &address){
 		}
 	}
 	
-	pSocket = CreateSocket();
-	pSocket->SetAddress(ResolveAddress(useAddress));
-	pSocket->Bind();
+	denSocketAddress socketAddress(ResolveAddress(useAddress));
+	pMemoryTransport = socketAddress.type == denSocketAddress::Type::memory;
+	
+	try{
+		int i;
+		for(i=0; i<pShardCount; i++){
+			const std::shared_ptr<Shard> shard(std::make_shared<Shard>());
+			shard->socket = CreateSocket();
+			shard->socket->SetReusePort(pShardCount > 1 || pPeerSockets);
+			shard->socket->SetReceiveBufferSize(pReceiveBufferSize);
+			shard->socket->SetSendBufferSize(pSendBufferSize);
+			shard->socket->SetAddress(socketAddress);
+			shard->socket->Bind();
+			
+			if(pEgressBandwidth > 0){
+				shard->egress = std::make_shared<denEgressScheduler>(
+					std::max(pEgressBandwidth / pShardCount, 1));
+			}
+			pShards.push_back(shard);
+			
+			// all shards have to bind to the port picked by the first one
+			socketAddress = shard->socket->GetAddress();
+		}
+		
+		if(pShardCount > 1 && pShardHashSteering
+		&& !pShards.front()->socket->AttachReusePortSteering(pShardCount) && pLogger){
+			pLogger->Log(denLogger::LogSeverity::warning, "Server: Shard hash steering not supported");
+		}
+		
+		// steer all datagrams not matching a peer socket to the shard socket. peer sockets
+		// are then never picked while they are bound but not yet connected
+		if(pShardCount == 1 && pPeerSockets){
+			try{
+				pShards.front()->socket->AttachReusePortSteering(1);
+				
+			}catch(const std::exception &e){
+				if(pLogger){
+					pLogger->Log(denLogger::LogSeverity::warning,
+						std::string("Server: Attach peer socket steering failed: ") + e.what());
+				}
+			}
+		}
+		
+		// more threads than shards would only idle
+		const int threadCount = std::min(pUpdateThreadCount, pShardCount);
+		if(threadCount > 1){
+			pThreadPool = std::make_shared<denThreadPool>(threadCount);
+		}
+		
+		if(pSerializeThreadCount > 1){
+			pSerializeThreadPool = std::make_shared<denThreadPool>(pSerializeThreadCount);
+		}
+		
+	}catch(...){
+		pShards.clear();
+		pThreadPool.reset();
+		pSerializeThreadPool.reset();
+		throw;
+	}
 	
 	if(pLogger){
 		std::stringstream s;
-		s << "Server: Listening on " << pSocket->GetAddress().ToString();
+		s << "Server: Listening on " << socketAddress.ToString();
+		if(pShardCount > 1){
+			s << " using " << pShardCount << " shards";
+		}
+		if(pThreadPool){
+			s << " updated by " << pThreadPool->GetThreadCount() << " threads";
+		}
+		if(pSerializeThreadPool){
+			s << " writing states with " << pSerializeThreadPool->GetThreadCount() << " threads";
+		}
+		if(pEgressBandwidth > 0){
+			s << " with egress bandwidth " << pEgressBandwidth << " bytes/s";
+		}
+		if(pPeerSockets){
+			s << " with peer sockets";
+		}
+		s << " (receive buffer " << pShards.front()->socket->GetReceiveBufferSize()
+			<< ", send buffer " << pShards.front()->socket->GetSendBufferSize() << ")";
 		pLogger->Log(denLogger::LogSeverity::info, s.str());
 	}
 	
@@ -88,6 +180,12 @@ void denServer::StopListening(){
 		return;
 	}
 	
+	// other threads are updating shards. stop after they are done
+	if(vUpdatingServer == this && pThreadPool){
+		pStopListening = true;
+		return;
+	}
+	
 	{
 	const Connections closeCons(pConnections);
 	Connections::const_iterator iterCon;
@@ -97,60 +195,235 @@ void denServer::StopListening(){
 	pConnections.clear();
 	}
 	
-	pSocket.reset();
+	std::vector<std::shared_ptr<Shard>>::const_iterator iterShard;
+	for(iterShard = pShards.cbegin(); iterShard != pShards.cend(); iterShard++){
+		try{
+			(*iterShard)->socket->FlushDatagrams();
+			
+		}catch(const std::exception &){
+		}
+	}
+	
+	pShards.clear();
+	pWaitSet.Clear();
+	pThreadPool.reset();
+	pSerializeThreadPool.reset();
 	pListening = false;
+	pStopListening = false;
+}
+
+void denServer::SetShardCount(int count){
+	if(pListening){
+		throw std::invalid_argument("Already listening");
+	}
+	pShardCount = std::max(count, 1);
+}
+
+void denServer::SetShardHashSteering(bool steering){
+	if(pListening){
+		throw std::invalid_argument("Already listening");
+	}
+	pShardHashSteering = steering;
+}
+
+void denServer::SetUpdateThreadCount(int count){
+	if(pListening){
+		throw std::invalid_argument("Already listening");
+	}
+	pUpdateThreadCount = std::max(count, 1);
+}
+
+void denServer::SetSerializeThreadCount(int count){
+	if(pListening){
+		throw std::invalid_argument("Already listening");
+	}
+	pSerializeThreadCount = std::max(count, 1);
+}
+
+void denServer::SetPeerSockets(bool peerSockets){
+	if(pListening){
+		throw std::invalid_argument("Already listening");
+	}
+	pPeerSockets = peerSockets;
+}
+
+void denServer::SetConnectionCookies(bool connectionCookies){
+	if(pListening){
+		throw std::invalid_argument("Already listening");
+	}
+	pConnectionCookies = connectionCookies;
+}
+
+uint64_t denServer::GetDiscardedDatagramCount() const{
+	uint64_t count = 0;
+	std::vector<std::shared_ptr<Shard>>::const_iterator iter;
+	for(iter = pShards.cbegin(); iter != pShards.cend(); iter++){
+		count += (*iter)->discardedDatagrams;
+	}
+	return count;
+}
+
+void denServer::SetReceiveBufferSize(int size){
+	if(pListening){
+		throw std::invalid_argument("Already listening");
+	}
+	if(size < 0){
+		throw std::invalid_argument("size < 0");
+	}
+	pReceiveBufferSize = size;
+}
+
+void denServer::SetSendBufferSize(int size){
+	if(pListening){
+		throw std::invalid_argument("Already listening");
+	}
+	if(size < 0){
+		throw std::invalid_argument("size < 0");
+	}
+	pSendBufferSize = size;
+}
+
+void denServer::SetEgressBandwidth(int bandwidth){
+	if(pListening){
+		throw std::invalid_argument("Already listening");
+	}
+	if(bandwidth < 0){
+		throw std::invalid_argument("bandwidth < 0");
+	}
+	pEgressBandwidth = bandwidth;
+}
+
+uint64_t denServer::GetDroppedDatagramCount() const{
+	uint64_t count = 0;
+	std::vector<std::shared_ptr<Shard>>::const_iterator iter;
+	for(iter = pShards.cbegin(); iter != pShards.cend(); iter++){
+		count += (*iter)->socket->GetDroppedDatagramCount();
+	}
+	return count;
+}
+
+const denServer::Connections &denServer::GetShardConnections(int shard) const{
+	if(shard < 0 || shard >= (int)pShards.size()){
+		throw std::invalid_argument("shard out of range");
+	}
+	return pShards[shard]->connections;
+}
+
+void denServer::Broadcast(const denMessage::Ref &message, const ConnectionFilter &filter){
+	pBroadcast(message, filter, false);
+}
+
+void denServer::BroadcastReliable(const denMessage::Ref &message, const ConnectionFilter &filter){
+	pBroadcast(message, filter, true);
 }
 
 void denServer::Update(float elapsedTime){
-	if(!pSocket){
+	const int count = (int)pShards.size();
+	
+	if(pThreadPool){
+		pThreadPool->Run(count, [&](int index){
+			if(!pStopListening){
+				UpdateShard(index, elapsedTime);
+			}
+		});
+		
+		// callbacks requested to stop listening while shards have been updated
+		if(pStopListening){
+			StopListening();
+		}
 		return;
 	}
 	
+	int i;
+	for(i=0; i<count && i<(int)pShards.size(); i++){
+		UpdateShard(i, elapsedTime);
+	}
+}
+
+bool denServer::WaitForActivity(float timeout){
+	if(pShards.empty()){
+		return false;
+	}
+	if(pShards.size() == 1){
+		return WaitForShardActivity(0, timeout);
+	}
+	
+	pWaitSockets.clear();
+	std::vector<std::shared_ptr<Shard>>::const_iterator iter;
+	for(iter = pShards.cbegin(); iter != pShards.cend(); iter++){
+		timeout = pShardDeadline(**iter, timeout);
+		pAddShardSockets(**iter, pWaitSockets);
+	}
+	
+	const bool result = pWaitSet.Wait(pWaitSockets, timeout);
+	pWaitSockets.clear();
+	return result;
+}
+
+void denServer::UpdateShard(int index, float elapsedTime){
+	if(index < 0 || index >= (int)pShards.size()){
+		throw std::invalid_argument("shard out of range");
+	}
+	
+	// keep shard alive in case StopListening() is called while processing
+	const std::shared_ptr<Shard> shard(pShards[index]);
+	
+	const denServer * const lastUpdatingServer = vUpdatingServer;
+	vUpdatingServer = this;
+	
+	try{
+		pUpdateShard(*shard, elapsedTime);
+		
+	}catch(...){
+		vUpdatingServer = lastUpdatingServer;
+		throw;
+	}
+	
+	vUpdatingServer = lastUpdatingServer;
+}
+
+void denServer::pUpdateShard(Shard &shard, float elapsedTime){
 	// receive messages
-	while(true){
-		denConnection *connection = nullptr;
+	while(pListening){
+		shard.receivedDatagrams.clear();
 		
 		try{
-			denSocketAddress addressReceive;
-			const denMessage::Ref message(pSocket->ReceiveDatagram(addressReceive));
-			if(!message){
+			if(shard.socket->ReceiveDatagrams(shard.receivedDatagrams, pReceiveBatchSize) == 0){
 				break;
 			}
 			
-			denMessageReader reader(message->Item());
-			
-			const Connections::const_iterator iter(std::find_if(pConnections.begin(),
-				pConnections.end(), [&](const denConnection::Ref &each){
-					return each->Matches(pSocket.get(), addressReceive);
-				}));
-			
-			if(iter != pConnections.cend()){
-				connection = iter->get();
-				connection->ProcessDatagram(reader);
-				
-			}else{
-				const denProtocol::CommandCodes command = (denProtocol::CommandCodes)reader.ReadByte();
-				if(command == denProtocol::CommandCodes::connectionRequest){
-					ProcessConnectionRequest(addressReceive, reader);
-					
-				}else{
-					// ignore invalid package
-	// 				if(denLogger){
-	// 					denLogger->Log(denLogger::LogSeverity::warning, "Server: Invalid datagram: Sender does not match any connection!" );
-	// 				}
-				}
-			}
-			
 		}catch(const std::exception &e){
 			if(pLogger){
 				pLogger->Log(denLogger::LogSeverity::error, std::string("Server: Update[1]: ") + e.what());
 			}
+			break;
+		}
+		
+		denSocket::Datagrams::const_iterator iterDatagram;
+		for(iterDatagram = shard.receivedDatagrams.cbegin(); iterDatagram != shard.receivedDatagrams.cend(); iterDatagram++){
+			if(!pListening){
+				break;
+			}
+			
+			try{
+				pProcessDatagram(shard, *iterDatagram);
+				
+			}catch(const std::exception &e){
+				if(pLogger){
+					pLogger->Log(denLogger::LogSeverity::error, std::string("Server: Update[1]: ") + e.what());
+				}
+			}
 		}
 	}
 	
+	shard.receivedDatagrams.clear();
+	
+	// send broadcasts queued by callbacks
+	pProcessBroadcasts(shard);
+	
 	// update connections
-	Connections::const_iterator iter(pConnections.cbegin());
-	while(iter != pConnections.cend()){
+	Connections::const_iterator iter(shard.connections.cbegin());
+	while(iter != shard.connections.cend()){
 		denConnection &connection = **(iter++);
 		try{
 			connection.Update(elapsedTime);
@@ -161,6 +434,61 @@ void denServer::Update(float elapsedTime){
 			}
 		}
 	}
+	
+	if(pSerializeThreadPool){
+		pWriteLinkUpdates(shard);
+	}
+	
+	if(shard.egress){
+		pSendEgress(shard, elapsedTime);
+	}
+	
+	// drop closed connections. they removed themselves from the server connection list
+	Connections::iterator iterDrop(shard.connections.begin());
+	while(iterDrop != shard.connections.end()){
+		if((*iterDrop)->GetParentServer() == this){
+			iterDrop++;
+			continue;
+		}
+		
+		shard.table.Remove((*iterDrop)->pRealRemoteAddress, iterDrop->get());
+		iterDrop = shard.connections.erase(iterDrop);
+	}
+	
+	// send queued datagrams
+	if(pListening){
+		try{
+			shard.socket->FlushDatagrams();
+			
+		}catch(const std::exception &e){
+			if(pLogger){
+				pLogger->Log(denLogger::LogSeverity::error, std::string("Server: Update[3]: ") + e.what());
+			}
+		}
+	}
+}
+
+bool denServer::WaitForShardActivity(int index, float timeout){
+	if(index < 0 || index >= (int)pShards.size()){
+		throw std::invalid_argument("shard out of range");
+	}
+	
+	Shard &shard = *pShards[index];
+	timeout = pShardDeadline(shard, timeout);
+	
+	if(!pPeerSockets){
+		return shard.socket->WaitForDatagram(timeout);
+	}
+	
+	shard.waitSockets.clear();
+	pAddShardSockets(shard, shard.waitSockets);
+	const bool result = shard.waitSet.Wait(shard.waitSockets, timeout);
+	shard.waitSockets.clear();
+	return result;
+}
+
+void denServer::SetReceiveBatchSize(int size){
+	pReceiveBatchSize = std::max(size, 1);
 }
 
 denConnection::Ref denServer::CreateConnection(){
@@ -168,7 +496,8 @@ denConnection::Ref denServer::CreateConnection(){
 }
 
 denSocket::Ref denServer::CreateSocket(){
-	return denSocketShared::CreateSocket();
+	return denSocketShared::CreateSocket(pMemoryTransport
+		? denSocketShared::Backend::memory : denSocketShared::Backend::platform);
 }
 
 denSocketAddress denServer::ResolveAddress(const std::string &address){
@@ -190,7 +519,32 @@ void denServer::SetLogger(const denLogger::Ref &logger){
 void denServer::ClientConnected(const denConnection::Ref &){
 }
 
-void denServer::ProcessConnectionRequest(const denSocketAddress &address, denMessageReader &reader){
+void denServer::pProcessDatagram(Shard &shard, const denSocket::Datagram &datagram){
+	// closed connections stay in the table until the shard drops them. they do not
+	// match anymore and a new connection from the same address replaces them
+	denConnection * const connection = shard.table.Find(datagram.address);
+	
+	if(connection && connection->Matches(shard.socket.get(), datagram.address)){
+		denMessageReader reader(datagram.message);
+		connection->ProcessDatagram(reader);
+		return;
+	}
+	
+	// datagrams from unknown addresses have to be connection requests. discard anything
+	// else by looking only at the first byte. no reader and no exception for junk
+	const denMessage &message = datagram.message->Item();
+	if(message.GetLength() < 1 || (uint8_t)message.GetData()[0]
+	!= (uint8_t)denProtocol::CommandCodes::connectionRequest){
+		shard.discardedDatagrams++;
+		return;
+	}
+	
+	denMessageReader reader(datagram.message);
+	reader.ReadByte();
+	ProcessConnectionRequest(shard, datagram.address, reader);
+}
+
+void denServer::ProcessConnectionRequest(Shard &shard, const denSocketAddress &address, denMessageReader &reader){
 	if(! pListening){
 		const denMessage::Ref message(denMessage::Pool().Get());
 		{
@@ -198,36 +552,114 @@ void denServer::ProcessConnectionRequest(const denSocketAddress &address, denMes
 		writer.WriteByte((uint8_t)denProtocol::CommandCodes::connectionAck);
 		writer.WriteByte((uint8_t)denProtocol::ConnectionAck::rejected);
 		}
-		pSocket->SendDatagram(message->Item(), address);
+		shard.socket->QueueDatagram(message, address);
+		return;
+	}
+	
+	// validate length up front to discard junk without throwing
+	if(reader.GetPosition() + 2 > reader.GetLength()){
+		shard.discardedDatagrams++;
 		return;
 	}
 	
-	// find best protocol to speak
-	std::vector<int> clientProtocols;
 	const int clientProtocolCount = reader.ReadUShort();
+	if(reader.GetPosition() + 2 * clientProtocolCount > reader.GetLength()){
+		shard.discardedDatagrams++;
+		return;
+	}
+	
+	// read protocols but do not act on them before the cookie is verified
+	std::vector<int> clientProtocols;
 	int i;
 	for(i=0; i<clientProtocolCount; i++){
 		clientProtocols.push_back(reader.ReadUShort());
 	}
 	
+	if(pConnectionCookies){
+		// requests without cookie field are smaller than the cookie answer. discard them
+		// to not amplify floods from spoofed addresses
+		if(reader.GetPosition() + 8 > reader.GetLength()){
+			shard.discardedDatagrams++;
+			return;
+		}
+		
+		if(!pConnectionCookie.Verify(address, reader.ReadULong())){
+			const denMessage::Ref message(denMessage::Pool().Get());
+			{
+			denMessageWriter writer(message->Item());
+			writer.WriteByte((uint8_t)denProtocol::CommandCodes::connectionCookie);
+			writer.WriteULong(pConnectionCookie.Create(address));
+			}
+			shard.socket->QueueDatagram(message, address);
+			return;
+		}
+	}
+	
+	// find best protocol to speak
+	denProtocol::Protocols protocol;
+	
 	if(std::find(clientProtocols.cbegin(), clientProtocols.cend(),
-	(int)denProtocol::Protocols::DENetworkProtocol) == clientProtocols.cend()){
+	(int)denProtocol::Protocols::DENetworkProtocol2) != clientProtocols.cend()){
+		protocol = denProtocol::Protocols::DENetworkProtocol2;
+		
+	}else if(std::find(clientProtocols.cbegin(), clientProtocols.cend(),
+	(int)denProtocol::Protocols::DENetworkProtocol) != clientProtocols.cend()){
+		protocol = denProtocol::Protocols::DENetworkProtocol;
+		
+	}else{
 		const denMessage::Ref message(denMessage::Pool().Get());
 		{
 		denMessageWriter writer(message->Item());
 		writer.WriteByte((uint8_t)denProtocol::CommandCodes::connectionAck);
 		writer.WriteByte((uint8_t)denProtocol::ConnectionAck::noCommonProtocol);
 		}
-		pSocket->SendDatagram(message->Item(), address);
+		shard.socket->QueueDatagram(message, address);
 		return;
 	}
 	
-	denProtocol::Protocols protocol = denProtocol::Protocols::DENetworkProtocol;
-	
 	// create connection
+	denSocket::Ref connectionSocket(shard.socket);
+	bool peerSocket = false;
+	
+	if(pPeerSockets){
+		try{
+			connectionSocket = pCreatePeerSocket(shard, address);
+			peerSocket = true;
+			
+		}catch(const std::exception &e){
+			if(pLogger){
+				pLogger->Log(denLogger::LogSeverity::warning,
+					std::string("Server: Create peer socket failed: ") + e.what());
+			}
+		}
+	}
+	
 	const denConnection::Ref connection(CreateConnection());
-	connection->AcceptConnection(*this, pSocket, address, protocol);
-	pConnections.push_back(connection);
+	if(shard.egress){
+		connection->pEgressFlow = shard.egress->CreateFlow(connectionSocket, address);
+	}
+	
+	// add before accepting. ConnectionEstablished() is allowed to disconnect which removes
+	// the connection from the server connection list again
+	{
+	const std::lock_guard<std::mutex> guard(pMutexConnections);
+	connection->pParentServerEntry = pConnections.insert(pConnections.end(), connection);
+	}
+	
+	try{
+		connection->AcceptConnection(*this, connectionSocket, address, protocol, peerSocket);
+		
+	}catch(...){
+		connection->pRemoveConnectionFromParentServer();
+		throw;
+	}
+	
+	if(connection->GetParentServer() != this){
+		return;
+	}
+	
+	shard.connections.push_back(connection);
+	shard.table.Add(address, connection.get());
 	
 	// send back result
 	const denMessage::Ref message(denMessage::Pool().Get());
@@ -237,7 +669,7 @@ void denServer::ProcessConnectionRequest(const denSocketAddress &address, denMes
 	writer.WriteByte((uint8_t)denProtocol::ConnectionAck::accepted);
 	writer.WriteUShort((uint16_t)protocol);
 	}
-	pSocket->SendDatagram(message->Item(), address);
+	shard.socket->QueueDatagram(message, address);
 	
 	if(pLogger){
 		std::stringstream s;
@@ -246,3 +678,247 @@ void denServer::ProcessConnectionRequest(const denSocketAddress &address, denMes
 	}
 	ClientConnected(connection);
 }
+
+void denServer::pWriteLinkUpdates(Shard &shard){
+	std::vector<denConnection*> &connections = shard.writeLinkUpdates;
+	connections.clear();
+	
+	Connections::const_iterator iter;
+	for(iter = shard.connections.cbegin(); iter != shard.connections.cend(); iter++){
+		if((*iter)->pWriteLinkUpdatesPending){
+			connections.push_back(iter->get());
+		}
+	}
+	
+	if(connections.empty()){
+		return;
+	}
+	
+	// writing link updates only reads states and touches the links of the connection.
+	// no callbacks are called hence it is safe to run in parallel
+	try{
+		pSerializeThreadPool->Run((int)connections.size(), [&](int index){
+			connections[index]->pWriteLinkUpdates();
+		});
+		
+	}catch(const std::exception &e){
+		if(pLogger){
+			pLogger->Log(denLogger::LogSeverity::error, std::string("Server: Update[2]: ") + e.what());
+		}
+	}
+	
+	// queue datagrams on the updating thread since the sockets are not thread safe
+	std::vector<denConnection*>::const_iterator iterQueue;
+	for(iterQueue = connections.cbegin(); iterQueue != connections.cend(); iterQueue++){
+		(*iterQueue)->pQueueLinkUpdates();
+	}
+	connections.clear();
+}
+
+void denServer::pSendEgress(Shard &shard, float elapsedTime){
+	shard.egressSockets.clear();
+	shard.egress->Send(elapsedTime, shard.egressSockets);
+	
+	// the shard socket is flushed at the end of the update. peer sockets are flushed by
+	// their connection which already happened
+	std::vector<denSocket*>::const_iterator iter;
+	for(iter = shard.egressSockets.cbegin(); iter != shard.egressSockets.cend(); iter++){
+		if(*iter == shard.socket.get()){
+			continue;
+		}
+		
+		try{
+			(*iter)->FlushDatagrams();
+			
+		}catch(const std::exception &e){
+			if(pLogger){
+				pLogger->Log(denLogger::LogSeverity::error, std::string("Server: Update[3]: ") + e.what());
+			}
+		}
+	}
+	shard.egressSockets.clear();
+}
+
+void denServer::pBroadcast(const denMessage::Ref &message, const ConnectionFilter &filter, bool reliable){
+	if(!message){
+		throw std::invalid_argument("message is nullptr");
+	}
+	if(message->Item().GetLength() < 1){
+		throw std::invalid_argument("message has 0 length");
+	}
+	
+	// called from a callback while shards are updated. other shards can not be touched
+	// safely. queue the broadcast for each shard to send it during its next update
+	if(vUpdatingServer == this){
+		std::vector<std::shared_ptr<Shard>>::const_iterator iterShard;
+		for(iterShard = pShards.cbegin(); iterShard != pShards.cend(); iterShard++){
+			Shard &shard = **iterShard;
+			const std::lock_guard<std::mutex> guard(shard.mutexBroadcasts);
+			shard.broadcasts.push_back({message, filter, reliable});
+		}
+		return;
+	}
+	
+	// iterate a copy since the filter is allowed to disconnect clients
+	Connections connections;
+	{
+	const std::lock_guard<std::mutex> guard(pMutexConnections);
+	connections = pConnections;
+	}
+	
+	// connections only reference the message
+	Connections::const_iterator iter;
+	for(iter = connections.cbegin(); iter != connections.cend(); iter++){
+		denConnection &connection = **iter;
+		if(connection.GetConnectionState() != denConnection::ConnectionState::connected){
+			continue;
+		}
+		if(filter && !filter(connection)){
+			continue;
+		}
+		
+		if(reliable){
+			connection.SendReliableMessage(message);
+			
+		}else{
+			connection.SendMessage(message);
+		}
+	}
+}
+
+void denServer::pProcessBroadcasts(Shard &shard){
+	{
+	const std::lock_guard<std::mutex> guard(shard.mutexBroadcasts);
+	if(shard.broadcasts.empty()){
+		return;
+	}
+	shard.processBroadcasts.swap(shard.broadcasts);
+	}
+	
+	// iterate a copy since the filter is allowed to disconnect clients
+	const Connections connections(shard.connections);
+	
+	std::vector<QueuedBroadcast>::const_iterator iterBroadcast;
+	for(iterBroadcast = shard.processBroadcasts.cbegin(); iterBroadcast != shard.processBroadcasts.cend(); iterBroadcast++){
+		const QueuedBroadcast &broadcast = *iterBroadcast;
+		
+		Connections::const_iterator iter;
+		for(iter = connections.cbegin(); iter != connections.cend(); iter++){
+			denConnection &connection = **iter;
+			if(connection.GetConnectionState() != denConnection::ConnectionState::connected){
+				continue;
+			}
+			
+			try{
+				if(broadcast.filter && !broadcast.filter(connection)){
+					continue;
+				}
+				
+				if(broadcast.reliable){
+					connection.SendReliableMessage(broadcast.message);
+					
+				}else{
+					connection.SendMessage(broadcast.message);
+				}
+				
+			}catch(const std::exception &e){
+				if(pLogger){
+					pLogger->Log(denLogger::LogSeverity::error, std::string("Server: Broadcast: ") + e.what());
+				}
+			}
+		}
+	}
+	
+	shard.processBroadcasts.clear();
+}
+
+float denServer::pShardDeadline(const Shard &shard, float timeout) const{
+	if(shard.egress){
+		const float delay = shard.egress->GetSendDelay();
+		if(delay >= 0.0f && (timeout < 0.0f || delay < timeout)){
+			timeout = delay;
+		}
+	}
+	
+	Connections::const_iterator iter;
+	for(iter = shard.connections.cbegin(); iter != shard.connections.cend(); iter++){
+		const float deadline = (*iter)->pNextDeadline();
+		if(deadline >= 0.0f && (timeout < 0.0f || deadline < timeout)){
+			timeout = deadline;
+		}
+	}
+	return timeout;
+}
+
+void denServer::pAddShardSockets(const Shard &shard, std::vector<denSocket::Ref> &sockets) const{
+	sockets.push_back(shard.socket);
+	
+	Connections::const_iterator iter;
+	for(iter = shard.connections.cbegin(); iter != shard.connections.cend(); iter++){
+		if((*iter)->pPeerSocket && (*iter)->pSocket){
+			sockets.push_back((*iter)->pSocket);
+		}
+	}
+}
+
+denSocket::Ref denServer::pCreatePeerSocket(const Shard &shard, const denSocketAddress &address){
+	// bind to the listen address so the client receives replies from the address it
+	// connected to. connected sockets take precedence over the shard sockets.
+	// 
+	// between binding and connecting the socket is part of the reuse port group. without
+	// steering the kernel can pick it for datagrams of other clients which are dropped
+	// while connecting. steering only picks shard sockets since they are bound first
+	const denSocket::Ref socket(CreateSocket());
+	socket->SetReusePort(true);
+	socket->SetReceiveBufferSize(pReceiveBufferSize);
+	socket->SetSendBufferSize(pSendBufferSize);
+	socket->SetAddress(shard.socket->GetAddress());
+	socket->Bind();
+	socket->Connect(address);
+	return socket;
+}
+
+denServer::StatesLock::StatesLock(denServer *server, bool exclusive) :
+pMutex(server ? &server->pMutexStates : nullptr),
+pExclusive(exclusive),
+pLastLocked(vLockedStates),
+pLastExclusive(vLockedStatesExclusive){
+	if(!pMutex){
+		return;
+	}
+	
+	if(vLockedStates == pMutex){
+		// nested inside lock held by this thread. shared locks can not be upgraded
+		if(exclusive && !vLockedStatesExclusive){
+			throw std::runtime_error("exclusive states lock requested while holding shared lock");
+		}
+		pMutex = nullptr;
+		return;
+	}
+	
+	if(exclusive){
+		pMutex->lock();
+		
+	}else{
+		pMutex->lock_shared();
+	}
+	
+	vLockedStates = pMutex;
+	vLockedStatesExclusive = exclusive;
+}
+
+denServer::StatesLock::~StatesLock() noexcept{
+	if(!pMutex){
+		return;
+	}
+	
+	vLockedStates = pLastLocked;
+	vLockedStatesExclusive = pLastExclusive;
+	
+	if(pExclusive){
+		pMutex->unlock();
+		
+	}else{
+		pMutex->unlock_shared();
+	}
+}
@@ -27,10 +27,19 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <mutex>
+#include <atomic>
+#include <shared_mutex>
+#include <functional>
 #include "config.h"
 #include "denConnection.h"
 #include "denLogger.h"
+#include "denConnectionTable.h"
+#include "denThreadPool.h"
+#include "denConnectionCookie.h"
+#include "denEgressScheduler.h"
 #include "socket/denSocket.h"
+#include "socket/denSocketWaitSet.h"
 
 class denMessageReader;
 
@@ -53,9 +62,26 @@ class denMessageReader;
  * "hostnameOrIP" or "hostnameOrIP:port". You can use a resolvable hostname or an IPv4.
  * If the port is not specified the default port 3413 is used. You can use any port you you like.
  * 
+ * To scale across multiple cores use SetShardCount() before calling ListenOn(). Each shard
+ * binds its own socket to the listen address with reuse port enabled. The kernel distributes
+ * incoming datagrams across the shard sockets keeping each client on the same shard. Each
+ * shard owns the connections of the clients it received and can be updated from its own
+ * thread using UpdateShard() and WaitForShardActivity().
+ * 
+ * Alternatively use SetUpdateThreadCount() to let Update() update the shards in parallel
+ * using worker threads. Each worker receives, processes, serializes state updates and
+ * sends for the shards it picks up. Update() returns once all shards are updated. Between
+ * calls to Update() no worker thread touches states, connections or sockets. This is the
+ * point to modify shared states, link states and send messages from the application.
+ * 
+ * To benchmark or test without using the network listen on "memory:port" and connect
+ * clients to the same address. Datagrams are then moved in-process using denSocketMemory.
+ * 
  * Call Update() in regular intervals to receive and process incoming messages as well as
- * updating connected clients. DENetwork does not use internal threading giving you full
- * control over threading.
+ * updating connected clients. Unless SetUpdateThreadCount() or SetSerializeThreadCount()
+ * are used DENetwork does not create threads giving you full control over threading. Call
+ * WaitForActivity() between updates to sleep until there is work to do instead of updating
+ * in a busy loop.
  * 
  * To get logging implemnent a subclass of denLogger and set the logger instance using
  * SetLogger(). You can share the logger instance across multiple servers and connections.
@@ -68,6 +94,9 @@ public:
 	/** \brief Connection list. */
 	typedef std::list<denConnection::Ref> Connections;
 	
+	/** \brief Filter returning true if a message is send to the connection. */
+	typedef std::function<bool(const denConnection&)> ConnectionFilter;
+	
 	/** \brief Create server. */
 	denServer();
 	
@@ -90,22 +119,273 @@ public:
 	 */
 	void ListenOn(const std::string &address);
 	
-	/** \brief Stop listening. */
+	/**
+	 * \brief Stop listening.
+	 * 
+	 * If called from a callback while shards are updated by multiple threads stopping is
+	 * deferred until all shards finished updating. IsListening() returns true until then.
+	 */
 	void StopListening();
 	
-	/** \brier Connections. */
+	/** \brief Count of receive shards. */
+	inline int GetShardCount() const{ return pShardCount; }
+	
+	/**
+	 * \brief Set count of receive shards.
+	 * 
+	 * If larger than 1 ListenOn() binds one socket per shard to the listen address with
+	 * reuse port enabled. Can only be changed while not listening.
+	 */
+	void SetShardCount(int count);
+	
+	/** \brief Steer datagrams to shards using the receive flow hash. */
+	inline bool GetShardHashSteering() const{ return pShardHashSteering; }
+	
+	/**
+	 * \brief Set to steer datagrams to shards using the receive flow hash.
+	 * 
+	 * If enabled a classic BPF program is attached to the shard sockets selecting the
+	 * shard by the receive flow hash instead of the default kernel distribution. This
+	 * requires the network device to provide a receive flow hash. Ignored if not supported
+	 * by the socket. Can only be changed while not listening.
+	 */
+	void SetShardHashSteering(bool steering);
+	
+	/** \brief Count of threads updating shards in parallel during Update(). */
+	inline int GetUpdateThreadCount() const{ return pUpdateThreadCount; }
+	
+	/**
+	 * \brief Set count of threads updating shards in parallel during Update().
+	 * 
+	 * The calling thread is counted as one of the threads. If larger than 1 ListenOn()
+	 * creates count-1 worker threads. Use together with SetShardCount() since each shard is
+	 * updated by one thread at a time. Callbacks like ClientConnected(), CreateState()
+	 * and MessageReceived() are then called from worker threads and the logger has to be
+	 * thread safe. Can only be changed while not listening.
+	 * 
+	 * Callbacks run concurrently with the updates of other shards. Inside callbacks only
+	 * use the connection the callback belongs to and connections of the same shard. Use
+	 * Broadcast() and BroadcastReliable() to reach clients of other shards. Modify shared
+	 * states and link states to other connections only between calls to Update().
+	 * StopListening() is deferred until all shards finished updating.
+	 */
+	void SetUpdateThreadCount(int count);
+	
+	/** \brief Count of threads writing state link updates in parallel. */
+	inline int GetSerializeThreadCount() const{ return pSerializeThreadCount; }
+	
+	/**
+	 * \brief Set count of threads writing state link updates in parallel.
+	 * 
+	 * The calling thread is counted as one of the threads. If larger than 1 ListenOn()
+	 * creates count-1 worker threads. Each shard update then first updates all its
+	 * connections, writes the link updates of all connections in parallel and queues
+	 * the written datagrams on the updating thread. Only writing link updates runs on the
+	 * worker threads. Callbacks are still called from the thread updating the shard.
+	 * Can only be changed while not listening.
+	 */
+	void SetSerializeThreadCount(int count);
+	
+	/** \brief Create a connected socket for each client. */
+	inline bool GetPeerSockets() const{ return pPeerSockets; }
+	
+	/**
+	 * \brief Set to create a connected socket for each client.
+	 * 
+	 * If enabled a socket is created for each accepted client, bound to the listen
+	 * address with reuse port enabled and connected to the client address. The kernel
+	 * then delivers the datagrams of each client to its socket instead of the server
+	 * looking up the connection for each datagram. Each peer socket is polled during
+	 * UpdateShard(). Suited for servers with few clients sending many datagrams. Falls
+	 * back to the shard socket if creating the peer socket fails. Peer sockets use the
+	 * receive and send buffer sizes of the shard sockets. Can only be changed while not
+	 * listening.
+	 * 
+	 * A peer socket briefly belongs to the reuse port group before it is connected. Datagrams
+	 * of other clients the kernel delivers to it during this time are dropped. With a single
+	 * shard or with shard hash steering enabled all such datagrams are steered to the shard
+	 * sockets instead.
+	 */
+	void SetPeerSockets(bool peerSockets);
+	
+	/** \brief Require clients to answer a connection cookie before accepting them. */
+	inline bool GetConnectionCookies() const{ return pConnectionCookies; }
+	
+	/**
+	 * \brief Set to require clients to answer a connection cookie before accepting them.
+	 * 
+	 * If enabled connection requests without a valid cookie are answered with a stateless
+	 * cookie computed from the client address. Clients resend the request with the cookie
+	 * proving they receive datagrams send to their address. Only then a connection is
+	 * created and ClientConnected() called. Protects against floods of connection requests
+	 * from spoofed addresses. The cookie answer is not larger than the request. Clients
+	 * not sending a cookie field with their request can not connect. Can only be changed
+	 * while not listening.
+	 */
+	void SetConnectionCookies(bool connectionCookies);
+	
+	/**
+	 * \brief Count of datagrams discarded since listening.
+	 * 
+	 * Counts datagrams from unknown addresses not being valid connection requests as well
+	 * as connection requests discarded due to a missing cookie. Sum of all shards. Read
+	 * only while no shard is updating.
+	 */
+	uint64_t GetDiscardedDatagramCount() const;
+	
+	/** \brief Socket receive buffer size in bytes or 0 to use the system default. */
+	inline int GetReceiveBufferSize() const{ return pReceiveBufferSize; }
+	
+	/**
+	 * \brief Set socket receive buffer size in bytes or 0 to use the system default.
+	 * 
+	 * Applies to the socket of each shard and each peer socket. Increase if
+	 * GetDroppedDatagramCount() grows during load spikes. Can only be changed while not
+	 * listening.
+	 */
+	void SetReceiveBufferSize(int size);
+	
+	/** \brief Socket send buffer size in bytes or 0 to use the system default. */
+	inline int GetSendBufferSize() const{ return pSendBufferSize; }
+	
+	/**
+	 * \brief Set socket send buffer size in bytes or 0 to use the system default.
+	 * 
+	 * Applies to the socket of each shard and each peer socket. Can only be changed while
+	 * not listening.
+	 */
+	void SetSendBufferSize(int size);
+	
+	/** \brief Egress bandwidth budget in bytes per second or 0 if unlimited. */
+	inline int GetEgressBandwidth() const{ return pEgressBandwidth; }
+	
+	/**
+	 * \brief Set egress bandwidth budget in bytes per second or 0 if unlimited.
+	 * 
+	 * If set messages, reliable messages and state link updates of all connections are
+	 * queued in a denEgressScheduler instead of being send right away. Each update sends
+	 * queued datagrams within the budget sharing it fairly across connections. Link updates
+	 * and unreliable messages of a connection are send before its reliable messages.
+	 * Protocol control datagrams like acknowledgements bypass the scheduler. The budget is
+	 * split evenly across shards. Can only be changed while not listening.
+	 */
+	void SetEgressBandwidth(int bandwidth);
+	
+	/**
+	 * \brief Count of received datagrams dropped by the kernel since listening.
+	 * 
+	 * Sum of the dropped datagrams of all shard sockets. Stays 0 if not supported by
+	 * the socket.
+	 */
+	uint64_t GetDroppedDatagramCount() const;
+	
+	/**
+	 * \brief Connections.
+	 * 
+	 * With more than one update thread worker threads add and remove connections while
+	 * shards are updated. Then do not call from callbacks but only between calls to
+	 * Update(). With a single update thread it is safe to call from callbacks.
+	 */
 	inline const Connections &GetConnections() const{ return pConnections; }
 	
+	/** \brief Connections owned by shard. */
+	const Connections &GetShardConnections(int shard) const;
+	
+	/**
+	 * \brief Send message to all connected clients.
+	 * 
+	 * Same as calling denConnection::SendMessage() on each connected client. All clients
+	 * share the message. It is neither copied nor serialized again for each client. Do
+	 * not modify the message after sending it.
+	 * 
+	 * Can be called from callbacks while shards are updated. The broadcast is then queued
+	 * and send by each shard at the beginning of its next update. Otherwise call between
+	 * calls to Update().
+	 * 
+	 * \param[in] message Message to send.
+	 * \param[in] filter Filter selecting clients to send to or nullptr to send to all.
+	 */
+	void Broadcast(const denMessage::Ref &message, const ConnectionFilter &filter = nullptr);
+	
+	/**
+	 * \brief Send reliable message to all connected clients.
+	 * 
+	 * Same as calling denConnection::SendReliableMessage() on each connected client. All
+	 * send and resend queues share the message until all clients acknowledged it. It is
+	 * neither copied nor serialized again for each client. Do not modify the message after
+	 * sending it.
+	 * 
+	 * Can be called from callbacks while shards are updated. The broadcast is then queued
+	 * and send by each shard at the beginning of its next update. Otherwise call between
+	 * calls to Update().
+	 * 
+	 * \param[in] message Message to send.
+	 * \param[in] filter Filter selecting clients to send to or nullptr to send to all.
+	 */
+	void BroadcastReliable(const denMessage::Ref &message, const ConnectionFilter &filter = nullptr);
+	
 	/**
 	 * \brief Update server.
 	 * 
 	 * Send and received queued messages. Call this on each frame update or in a loop
 	 * from inside a thread. If using a thread use a mutex to ensure thread safety.
 	 * 
+	 * If the update thread count is larger than 1 the shards are updated in parallel
+	 * and this call returns once all shards are updated. Modify shared states only
+	 * between calls to Update().
+	 * 
 	 * \param[in] elapsedTime Elapsed time in seconds since the last call to Update().
 	 */
 	void Update(float elapsedTime);
 	
+	/**
+	 * \brief Wait for activity.
+	 * 
+	 * Blocks until datagrams arrive, the next reliable message resend or timeout of any
+	 * connection is due or timeout elapsed. Call Update() afterwards with the actually
+	 * elapsed time. This allows servers to sleep instead of calling Update() in a busy
+	 * loop.
+	 * 
+	 * The sockets of all shards and all peer sockets are waited on together using
+	 * denSocketWaitSet.
+	 * 
+	 * \param[in] timeout Maximum time to wait in seconds. Negative value waits until
+	 *                    activity or the next deadline.
+	 * \returns true if datagrams are pending.
+	 */
+	bool WaitForActivity(float timeout);
+	
+	/**
+	 * \brief Update shard.
+	 * 
+	 * Receives datagrams from the shard socket, updates the connections owned by the
+	 * shard and sends queued datagrams. Different shards can be updated concurrently from
+	 * different threads. Callbacks like ClientConnected() are then called from these
+	 * threads. Update() updates all shards in sequence.
+	 * 
+	 * \param[in] shard Index of shard.
+	 * \param[in] elapsedTime Elapsed time in seconds since the last call to UpdateShard().
+	 */
+	void UpdateShard(int shard, float elapsedTime);
+	
+	/**
+	 * \brief Wait for activity on shard.
+	 * 
+	 * Same as WaitForActivity() but only for the sockets and connections of the shard.
+	 * 
+	 * \param[in] shard Index of shard.
+	 * \param[in] timeout Maximum time to wait in seconds. Negative value waits until
+	 *                    activity or the next deadline.
+	 * \returns true if datagrams are pending.
+	 */
+	bool WaitForShardActivity(int shard, float timeout);
+	
+	/** \brief Maximum count of datagrams to receive in one batch. */
+	inline int GetReceiveBatchSize() const{ return pReceiveBatchSize; }
+	
+	/** \brief Set maximum count of datagrams to receive in one batch. */
+	void SetReceiveBatchSize(int size);
+	
 	/**
 	 * \brief Create connection for each connecting client.
 	 * 
@@ -123,6 +403,9 @@ public:
 	 * UDP socket. If you have to accept clients using a different transportation method
 	 * overwrite method to create an instance of a subclass of denSocket providing the
 	 * required capabilities.
+	 * 
+	 * For memory addresses the default implementation creates a denSocketMemory. Overwrite
+	 * to wrap the default socket, for example with denSocketImpairment.
 	 */
 	virtual denSocket::Ref CreateSocket();
 	
@@ -131,7 +414,8 @@ public:
 	 * 
 	 * Address is in the format "hostnameOrIP" or "hostnameOrIP:port". You can use a
 	 * resolvable hostname or an IPv4. If the port is not specified the default port
-	 * 3413 is used.
+	 * 3413 is used. Addresses in the format "memory:port" use the in-process memory
+	 * transport.
 	 * 
 	 * If you overwrite CreateSocket() you have to also overwrite this method to resolve
 	 * address using the appropriate method.
@@ -159,15 +443,90 @@ public:
 	
 	
 private:
+	/**
+	 * \brief Lock shared states.
+	 * 
+	 * Shared locks are used while serializing state updates of a connection. Exclusive locks
+	 * are used while modifying state links or values from within the update. Locks can be
+	 * nested on the same thread. Nested locks do not lock again. Requesting an exclusive
+	 * lock while holding a shared lock throws an exception. No lock is taken if server
+	 * is nullptr.
+	 */
+	class StatesLock{
+	public:
+		StatesLock(denServer *server, bool exclusive);
+		~StatesLock() noexcept;
+		
+	private:
+		std::shared_timed_mutex *pMutex;
+		bool pExclusive;
+		std::shared_timed_mutex *pLastLocked;
+		bool pLastExclusive;
+	};
+	
+	/** \brief Broadcast queued while shards are updated. */
+	struct QueuedBroadcast{
+		denMessage::Ref message;
+		ConnectionFilter filter;
+		bool reliable;
+	};
+	
+	/** \brief Receive shard. */
+	struct Shard{
+		denSocket::Ref socket;
+		Connections connections;
+		denConnectionTable table;
+		denSocket::Datagrams receivedDatagrams;
+		std::vector<denConnection*> writeLinkUpdates;
+		uint64_t discardedDatagrams = 0;
+		denEgressScheduler::Ref egress;
+		std::vector<denSocket*> egressSockets;
+		denSocketWaitSet waitSet;
+		std::vector<denSocket::Ref> waitSockets;
+		std::vector<QueuedBroadcast> broadcasts;
+		std::vector<QueuedBroadcast> processBroadcasts;
+		std::mutex mutexBroadcasts;
+	};
+	
 	std::string pAddress;
 	
-	denSocket::Ref pSocket;
+	std::vector<std::shared_ptr<Shard>> pShards;
+	int pShardCount;
+	bool pShardHashSteering;
+	int pUpdateThreadCount;
+	denThreadPool::Ref pThreadPool;
+	int pSerializeThreadCount;
+	denThreadPool::Ref pSerializeThreadPool;
+	bool pPeerSockets;
+	bool pConnectionCookies;
+	denConnectionCookie pConnectionCookie;
+	int pReceiveBufferSize;
+	int pSendBufferSize;
+	int pEgressBandwidth;
 	bool pListening;
+	std::atomic<bool> pStopListening;
+	bool pMemoryTransport;
 	
 	Connections pConnections;
+	std::mutex pMutexConnections;
+	std::shared_timed_mutex pMutexStates;
+	
+	denSocketWaitSet pWaitSet;
+	std::vector<denSocket::Ref> pWaitSockets;
+	
+	int pReceiveBatchSize;
 	
 	denLogger::Ref pLogger;
 	
 	friend denConnection;
-	void ProcessConnectionRequest(const denSocketAddress &address, denMessageReader &reader);
+	void ProcessConnectionRequest(Shard &shard, const denSocketAddress &address, denMessageReader &reader);
+	void pProcessDatagram(Shard &shard, const denSocket::Datagram &datagram);
+	void pWriteLinkUpdates(Shard &shard);
+	void pSendEgress(Shard &shard, float elapsedTime);
+	void pBroadcast(const denMessage::Ref &message, const ConnectionFilter &filter, bool reliable);
+	void pProcessBroadcasts(Shard &shard);
+	void pUpdateShard(Shard &shard, float elapsedTime);
+	float pShardDeadline(const Shard &shard, float timeout) const;
+	void pAddShardSockets(const Shard &shard, std::vector<denSocket::Ref> &sockets) const;
+	denSocket::Ref pCreatePeerSocket(const Shard &shard, const denSocketAddress &address);
 };
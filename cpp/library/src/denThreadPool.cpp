@@ -0,0 +1,204 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include "denThreadPool.h"
+
+denThreadPool::denThreadPool(int threadCount) :
+pTask(nullptr),
+pGeneration(0),
+pBusyCount(0),
+pStop(false){
+	int i;
+	for(i=0; i<std::max(threadCount, 1); i++){
+		pRanges.push_back(std::unique_ptr<Range>(new Range));
+	}
+	
+	try{
+		for(i=1; i<threadCount; i++){
+			pThreads.emplace_back(&denThreadPool::pWorker, this, i);
+		}
+		
+	}catch(...){
+		pStopThreads();
+		throw;
+	}
+}
+
+denThreadPool::~denThreadPool() noexcept{
+	pStopThreads();
+}
+
+void denThreadPool::Run(int count, const Task &task){
+	if(count < 1){
+		return;
+	}
+	
+	if(pThreads.empty() || count == 1){
+		int i;
+		for(i=0; i<count; i++){
+			task(i);
+		}
+		return;
+	}
+	
+	const std::lock_guard<std::mutex> guardRun(pMutexRun);
+	
+	{
+	const std::lock_guard<std::mutex> guard(pMutex);
+	pTask = &task;
+	
+	const int rangeCount = (int)pRanges.size();
+	int i;
+	for(i=0; i<rangeCount; i++){
+		Range &range = *pRanges[i];
+		const std::lock_guard<std::mutex> guardRange(range.mutex);
+		range.next = (int)((int64_t)count * i / rangeCount);
+		range.end = (int)((int64_t)count * (i + 1) / rangeCount);
+	}
+	
+	pBusyCount = (int)pThreads.size();
+	pGeneration++;
+	}
+	pConditionStart.notify_all();
+	
+	pRunTasks(0);
+	
+	std::exception_ptr exception;
+	{
+	std::unique_lock<std::mutex> lock(pMutex);
+	pConditionDone.wait(lock, [&](){
+		return pBusyCount == 0;
+	});
+	pTask = nullptr;
+	exception = pException;
+	pException = nullptr;
+	}
+	
+	if(exception){
+		std::rethrow_exception(exception);
+	}
+}
+
+void denThreadPool::pWorker(int index){
+	uint64_t generation = 0;
+	
+	while(true){
+		{
+		std::unique_lock<std::mutex> lock(pMutex);
+		pConditionStart.wait(lock, [&](){
+			return pStop || pGeneration != generation;
+		});
+		if(pStop){
+			return;
+		}
+		generation = pGeneration;
+		}
+		
+		pRunTasks(index);
+		
+		{
+		const std::lock_guard<std::mutex> guard(pMutex);
+		if(--pBusyCount > 0){
+			continue;
+		}
+		}
+		pConditionDone.notify_one();
+	}
+}
+
+void denThreadPool::pRunTasks(int index){
+	Range &range = *pRanges[index];
+	
+	while(true){
+		int task = -1;
+		{
+		const std::lock_guard<std::mutex> guard(range.mutex);
+		if(range.next < range.end){
+			task = range.next++;
+		}
+		}
+		
+		if(task == -1){
+			if(pStealTasks(index)){
+				continue;
+			}
+			return;
+		}
+		
+		try{
+			(*pTask)(task);
+			
+		}catch(...){
+			const std::lock_guard<std::mutex> guard(pMutex);
+			if(!pException){
+				pException = std::current_exception();
+			}
+		}
+	}
+}
+
+bool denThreadPool::pStealTasks(int index){
+	// tasks in flight while being stolen are run by the stealing thread. it is thus
+	// safe to stop once all ranges are found empty
+	const int rangeCount = (int)pRanges.size();
+	int i;
+	for(i=1; i<rangeCount; i++){
+		Range &victim = *pRanges[(index + i) % rangeCount];
+		int begin, end;
+		{
+		const std::lock_guard<std::mutex> guard(victim.mutex);
+		const int remaining = victim.end - victim.next;
+		if(remaining < 1){
+			continue;
+		}
+		
+		end = victim.end;
+		begin = end - (remaining + 1) / 2;
+		victim.end = begin;
+		}
+		
+		Range &range = *pRanges[index];
+		const std::lock_guard<std::mutex> guard(range.mutex);
+		range.next = begin;
+		range.end = end;
+		return true;
+	}
+	
+	return false;
+}
+
+void denThreadPool::pStopThreads(){
+	{
+	const std::lock_guard<std::mutex> guard(pMutex);
+	pStop = true;
+	}
+	pConditionStart.notify_all();
+	
+	std::vector<std::thread>::iterator iter;
+	for(iter = pThreads.begin(); iter != pThreads.end(); iter++){
+		iter->join();
+	}
+	pThreads.clear();
+}
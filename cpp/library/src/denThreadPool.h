@@ -0,0 +1,103 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <stdint.h>
+#include "config.h"
+
+/**
+ * \brief Thread pool running tasks in parallel.
+ * 
+ * Runs a batch of tasks indexed from 0 to count-1 using the worker threads and the
+ * calling thread and returns once all tasks finished. Worker threads sleep between batches.
+ * 
+ * The task indices are split into one range per thread. Each thread runs the tasks of
+ * its own range in order. Threads running out of tasks steal the upper half of the
+ * remaining tasks of another thread. Threads thus rarely contend with each other while
+ * tasks taking longer do not stall the others.
+ */
+class denThreadPool{
+public:
+	/** \brief Shared pointer. */
+	typedef std::shared_ptr<denThreadPool> Ref;
+	
+	/** \brief Task called with the index of the task to run. */
+	typedef std::function<void(int)> Task;
+	
+	/**
+	 * \brief Create thread pool.
+	 * \param[in] threadCount Count of threads running tasks including the calling thread.
+	 *                        Creates threadCount-1 worker threads.
+	 */
+	denThreadPool(int threadCount);
+	
+	/** \brief Clean up thread pool. */
+	~denThreadPool() noexcept;
+	
+	/** \brief Count of threads running tasks including the calling thread. */
+	inline int GetThreadCount() const{ return (int)pThreads.size() + 1; }
+	
+	/**
+	 * \brief Run tasks and wait for them to finish.
+	 * 
+	 * Calls task once for each index from 0 to count-1. If tasks throw exceptions the
+	 * remaining tasks still run and the first exception is rethrown after all tasks
+	 * finished. Calls from multiple threads at the same time run one after the other.
+	 */
+	void Run(int count, const Task &task);
+	
+	
+private:
+	/** \brief Range of tasks owned by a thread. */
+	struct Range{
+		std::mutex mutex;
+		int next = 0;
+		int end = 0;
+	};
+	
+	void pWorker(int index);
+	void pRunTasks(int index);
+	bool pStealTasks(int index);
+	void pStopThreads();
+	
+	std::vector<std::thread> pThreads;
+	std::vector<std::unique_ptr<Range>> pRanges;
+	std::mutex pMutex;
+	std::mutex pMutexRun;
+	std::condition_variable pConditionStart;
+	std::condition_variable pConditionDone;
+	const Task *pTask;
+	uint64_t pGeneration;
+	int pBusyCount;
+	bool pStop;
+	std::exception_ptr pException;
+};
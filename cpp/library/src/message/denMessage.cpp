@@ -25,8 +25,7 @@
 #include "denMessage.h"
 
 denMessage::denMessage() :
-pLength(0),
-pTimestamp(std::chrono::system_clock::now()){
+pLength(0){
 }
 
 void denMessage::SetTimestamp(const Timestamp &timestamp){
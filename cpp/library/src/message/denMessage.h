@@ -40,13 +40,24 @@ public:
 	/** \brief Shared pointer. */
 	typedef denPoolItem<denMessage>::Ref Ref;
 	
+	/** \brief Monotonic clock used for timestamps. */
+	typedef std::chrono::steady_clock Clock;
+	
 	/** \brief Timestamp. */
-	typedef std::chrono::time_point<std::chrono::system_clock> Timestamp;
+	typedef std::chrono::time_point<Clock> Timestamp;
 	
 	/** \brief Create message. */
 	denMessage();
 	
-	/** \brief Timestamp. */
+	/**
+	 * \brief Timestamp.
+	 * 
+	 * For received messages this is the time the datagram has been received. Uses the
+	 * kernel receive timestamp if supported by the socket. Timestamps are only comparable
+	 * to each other and to Clock::now(). Pooled messages are not reset when reused. Messages
+	 * not received from a socket keep the timestamp of their previous use unless set by
+	 * the application.
+	 */
 	inline const Timestamp &GetTimestamp() const{ return pTimestamp; }
 	
 	/** \brief Set timestamp. */
@@ -71,10 +82,20 @@ public:
 	/** \brief Pool. */
 	inline static denPool<denMessage> &Pool(){ return pPool; }
 	
+	/**
+	 * \brief Pool for socket receive buffers.
+	 * 
+	 * Messages in this pool keep a data size large enough to receive any datagram.
+	 * Kept separate to not grow the data of messages used for sending. Sockets keep one
+	 * batch of receive buffers per receiving thread, up to 64 KiB each.
+	 */
+	inline static denPool<denMessage> &ReceivePool(){ return pReceivePool; }
+	
 private:
 	std::string pData;
 	size_t pLength;
 	Timestamp pTimestamp;
 	
 	static denPool<denMessage> pPool;
+	static denPool<denMessage> pReceivePool;
 };
@@ -23,17 +23,33 @@
  */
 
 #include <memory.h>
-#include <sstream>
 #include <stdexcept>
 #include "denMessageReader.h"
 
-denMessageReader::denMessageReader(denMessage &message) :
-pStream(message.GetData()),
-pLength(message.GetLength()){
+denMessageReader::denMessageReader(const denMessage &message) :
+pData((const uint8_t*)message.GetData().c_str()),
+pOffset(0),
+pLength(message.GetLength()),
+pPosition(0),
+pTimestamp(message.GetTimestamp()){
 }
 
-size_t denMessageReader::GetPosition(){
-	return pStream.tellg();
+denMessageReader::denMessageReader(const denMessage::Ref &message) :
+pMessage(message),
+pData((const uint8_t*)message->Item().GetData().c_str()),
+pOffset(0),
+pLength(message->Item().GetLength()),
+pPosition(0),
+pTimestamp(message->Item().GetTimestamp()){
+}
+
+denMessageReader::denMessageReader(const denMessageView &view) :
+pMessage(view.GetMessage()),
+pData(view.GetData()),
+pOffset(view.GetOffset()),
+pLength(view.GetLength()),
+pPosition(0),
+pTimestamp(view.GetMessage()->Item().GetTimestamp()){
 }
 
 int8_t denMessageReader::ReadChar(){
@@ -176,9 +192,30 @@ denVector3 denMessageReader::ReadDVector(){
 }
 
 void denMessageReader::Read(void *buffer, size_t length){
-	pStream.read((char*)buffer, length);
+	if(length > pLength - pPosition){
+		throw std::out_of_range("read past end of message");
+	}
+	
+	memcpy(buffer, pData + pPosition, length);
+	pPosition += length;
 }
 
 void denMessageReader::Read(denMessage &message){
 	Read((void*)message.GetData().c_str(), message.GetLength());
 }
+
+denMessageView denMessageReader::ReadView(){
+	const size_t length = pLength - pPosition;
+	
+	if(pMessage){
+		const denMessageView view(pMessage, pOffset + pPosition, length);
+		pPosition = pLength;
+		return view;
+	}
+	
+	const denMessage::Ref message(denMessage::Pool().Get());
+	message->Item().SetLength(length);
+	message->Item().SetTimestamp(pTimestamp);
+	Read(message->Item());
+	return denMessageView(message, 0, length);
+}
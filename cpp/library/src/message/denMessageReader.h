@@ -24,23 +24,44 @@
 
 #pragma once
 
-#include <sstream>
 #include "../math/denPoint2.h"
 #include "../math/denPoint3.h"
 #include "../math/denVector2.h"
 #include "../math/denVector3.h"
 #include "../math/denQuaternion.h"
 #include "../message/denMessage.h"
+#include "../message/denMessageView.h"
 
 /**
  * \brief Network message reader.
+ * 
+ * Reads directly from the message data. Reading past the end of the message throws an
+ * exception. The message must not be modified while reading.
  */
 class denMessageReader{
 public:
-	denMessageReader(denMessage &message);
+	/** \brief Create reader for message. */
+	denMessageReader(const denMessage &message);
+	
+	/**
+	 * \brief Create reader for message.
+	 * 
+	 * Keeps a reference to the message allowing ReadView() to return views without
+	 * copying data.
+	 */
+	denMessageReader(const denMessage::Ref &message);
+	
+	/** \brief Create reader for viewed data. */
+	denMessageReader(const denMessageView &view);
 	
 	inline size_t GetLength() const{ return pLength; }
-	size_t GetPosition();
+	inline size_t GetPosition() const{ return pPosition; }
+	
+	/** \brief Count of bytes left to read. */
+	inline size_t GetRemaining() const{ return pLength - pPosition; }
+	
+	/** \brief Timestamp of read message. */
+	inline const denMessage::Timestamp &GetTimestamp() const{ return pTimestamp; }
 	
 	int8_t ReadChar();
 	uint8_t ReadByte();
@@ -64,7 +85,20 @@ public:
 	void Read(void *buffer, size_t length);
 	void Read(denMessage &message);
 	
+	/**
+	 * \brief Read remaining data as view.
+	 * 
+	 * If the reader has been created with a message reference the view references the
+	 * read message without copying. Otherwise the remaining data is copied into a new
+	 * message from the message pool.
+	 */
+	denMessageView ReadView();
+	
 private:
-	std::istringstream pStream;
+	denMessage::Ref pMessage;
+	const uint8_t *pData;
+	const size_t pOffset;
 	const size_t pLength;
+	size_t pPosition;
+	denMessage::Timestamp pTimestamp;
 };
@@ -0,0 +1,49 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <memory.h>
+#include <stdexcept>
+#include "denMessageView.h"
+
+denMessageView::denMessageView(const denMessage::Ref &message, size_t offset, size_t length) :
+pMessage(message),
+pOffset(offset),
+pLength(length){
+	if(!message){
+		throw std::invalid_argument("message is nullptr");
+	}
+	if(offset + length > message->Item().GetLength()){
+		throw std::invalid_argument("view exceeds message length");
+	}
+}
+
+denMessage::Ref denMessageView::Copy() const{
+	const denMessage::Ref message(denMessage::Pool().Get());
+	message->Item().SetLength(pLength);
+	message->Item().SetTimestamp(pMessage->Item().GetTimestamp());
+	if(pLength > 0){
+		memcpy((char*)message->Item().GetData().c_str(), GetData(), pLength);
+	}
+	return message;
+}
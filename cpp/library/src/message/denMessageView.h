@@ -0,0 +1,60 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "denMessage.h"
+
+/**
+ * \brief View of part of a network message.
+ * 
+ * Holds a reference to the viewed message keeping the data alive as long as the view
+ * or a copy of the message reference exists. The viewed message must not be modified.
+ */
+class denMessageView{
+public:
+	/** \brief Create view of message data. */
+	denMessageView(const denMessage::Ref &message, size_t offset, size_t length);
+	
+	/** \brief Viewed message. */
+	inline const denMessage::Ref &GetMessage() const{ return pMessage; }
+	
+	/** \brief Offset in bytes of view into message data. */
+	inline size_t GetOffset() const{ return pOffset; }
+	
+	/** \brief Length of view in bytes. */
+	inline size_t GetLength() const{ return pLength; }
+	
+	/** \brief Viewed data. */
+	inline const uint8_t *GetData() const{
+		return (const uint8_t*)pMessage->Item().GetData().c_str() + pOffset; }
+	
+	/** \brief Copy viewed data into new message from the message pool. */
+	denMessage::Ref Copy() const;
+	
+private:
+	denMessage::Ref pMessage;
+	size_t pOffset;
+	size_t pLength;
+};
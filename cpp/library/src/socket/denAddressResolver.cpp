@@ -0,0 +1,263 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+#include <unordered_map>
+#include "denAddressResolver.h"
+#include "denSocketShared.h"
+
+// maximum count of cached addresses
+static const size_t vMaxCachedCount = 64;
+
+/**
+ * \brief State shared with the helper thread.
+ * 
+ * Kept alive by the helper thread until it finished the request being resolved.
+ */
+struct denAddressResolver::State{
+	/** \brief Cached address. */
+	struct Cached{
+		denSocketAddress address;
+		std::chrono::steady_clock::time_point expires;
+	};
+	
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<Request::Ref> queue;
+	std::unordered_map<std::string, Cached> cache;
+	ResolveFunction resolve;
+	float cacheTime = 60.0f;
+	bool stop = false;
+	std::thread worker;
+};
+
+
+// denAddressResolver::Request
+////////////////////////////////
+
+denAddressResolver::Request::Request(const std::string &address) :
+pAddress(address),
+pFinished(false){
+}
+
+bool denAddressResolver::Request::Wait(float timeout){
+	if(IsFinished()){
+		return true;
+	}
+	if(timeout == 0.0f){
+		return false;
+	}
+	
+	std::unique_lock<std::mutex> lock(pMutex);
+	const auto finished = [&]{ return IsFinished(); };
+	
+	if(timeout < 0.0f){
+		pCondition.wait(lock, finished);
+		return true;
+	}
+	return pCondition.wait_for(lock, std::chrono::duration<float>(timeout), finished);
+}
+
+void denAddressResolver::Request::pFinish(const denSocketAddress &result, const std::string &error){
+	pResult = result;
+	pError = error;
+	
+	const std::lock_guard<std::mutex> guard(pMutex);
+	pFinished.store(true, std::memory_order_release);
+	pCondition.notify_all();
+}
+
+
+// denAddressResolver
+///////////////////////
+
+denAddressResolver::denAddressResolver() :
+pState(std::make_shared<State>()){
+}
+
+denAddressResolver::~denAddressResolver() noexcept{
+	std::deque<Request::Ref> pending;
+	{
+	const std::lock_guard<std::mutex> guard(pState->mutex);
+	pState->stop = true;
+	pending.swap(pState->queue);
+	if(pState->worker.joinable()){
+		// getaddrinfo can not be interrupted. do not wait for it to finish
+		pState->worker.detach();
+	}
+	}
+	pState->condition.notify_all();
+	
+	std::deque<Request::Ref>::const_iterator iter;
+	for(iter = pending.cbegin(); iter != pending.cend(); iter++){
+		(*iter)->pFinish(denSocketAddress(), "address resolver destroyed");
+	}
+}
+
+const denAddressResolver::Ref &denAddressResolver::Shared(){
+	static const Ref resolver(std::make_shared<denAddressResolver>());
+	return resolver;
+}
+
+float denAddressResolver::GetCacheTime(){
+	const std::lock_guard<std::mutex> guard(pState->mutex);
+	return pState->cacheTime;
+}
+
+void denAddressResolver::SetCacheTime(float time){
+	const std::lock_guard<std::mutex> guard(pState->mutex);
+	pState->cacheTime = std::max(time, 0.0f);
+	if(pState->cacheTime == 0.0f){
+		pState->cache.clear();
+	}
+}
+
+void denAddressResolver::SetResolveFunction(const ResolveFunction &function){
+	const std::lock_guard<std::mutex> guard(pState->mutex);
+	pState->resolve = function;
+}
+
+denSocketAddress denAddressResolver::Resolve(const std::string &address){
+	return pResolve(*pState, address);
+}
+
+denAddressResolver::Request::Ref denAddressResolver::ResolveAsync(const std::string &address){
+	const Request::Ref request(std::make_shared<Request>(address));
+	
+	denSocketAddress cached;
+	if(pFindCached(*pState, address, cached)){
+		request->pFinish(cached, std::string());
+		return request;
+	}
+	
+	{
+	const std::lock_guard<std::mutex> guard(pState->mutex);
+	pState->queue.push_back(request);
+	
+	if(!pState->worker.joinable()){
+		pState->worker = std::thread(pRunWorker, pState);
+	}
+	}
+	
+	pState->condition.notify_one();
+	return request;
+}
+
+void denAddressResolver::ClearCache(){
+	const std::lock_guard<std::mutex> guard(pState->mutex);
+	pState->cache.clear();
+}
+
+void denAddressResolver::pRunWorker(const std::shared_ptr<State> &state){
+	while(true){
+		Request::Ref request;
+		{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->condition.wait(lock, [&]{ return state->stop || !state->queue.empty(); });
+		if(state->stop){
+			return;
+		}
+		request = state->queue.front();
+		state->queue.pop_front();
+		}
+		
+		try{
+			request->pFinish(pResolve(*state, request->GetAddress()), std::string());
+			
+		}catch(const std::exception &e){
+			request->pFinish(denSocketAddress(), e.what());
+		}
+	}
+}
+
+denSocketAddress denAddressResolver::pResolve(State &state, const std::string &address){
+	denSocketAddress result;
+	if(pFindCached(state, address, result)){
+		return result;
+	}
+	
+	ResolveFunction resolve;
+	{
+	const std::lock_guard<std::mutex> guard(state.mutex);
+	resolve = state.resolve;
+	}
+	
+	result = resolve ? resolve(address) : denSocketShared::ResolveAddress(address);
+	pAddCached(state, address, result);
+	return result;
+}
+
+bool denAddressResolver::pFindCached(State &state, const std::string &address, denSocketAddress &result){
+	const std::lock_guard<std::mutex> guard(state.mutex);
+	
+	const auto iter = state.cache.find(address);
+	if(iter == state.cache.cend()){
+		return false;
+	}
+	
+	if(iter->second.expires <= std::chrono::steady_clock::now()){
+		state.cache.erase(iter);
+		return false;
+	}
+	
+	result = iter->second.address;
+	return true;
+}
+
+void denAddressResolver::pAddCached(State &state, const std::string &address, const denSocketAddress &result){
+	const std::lock_guard<std::mutex> guard(state.mutex);
+	if(state.cacheTime == 0.0f){
+		return;
+	}
+	
+	const std::chrono::steady_clock::time_point now(std::chrono::steady_clock::now());
+	
+	if(state.cache.size() >= vMaxCachedCount && state.cache.find(address) == state.cache.cend()){
+		// drop expired addresses. if none expired drop the one expiring first
+		auto iter = state.cache.begin();
+		while(iter != state.cache.end()){
+			if(iter->second.expires <= now){
+				iter = state.cache.erase(iter);
+				
+			}else{
+				iter++;
+			}
+		}
+		
+		if(state.cache.size() >= vMaxCachedCount){
+			state.cache.erase(std::min_element(state.cache.begin(), state.cache.end(),
+				[](const std::pair<const std::string, State::Cached> &a,
+				const std::pair<const std::string, State::Cached> &b){
+					return a.second.expires < b.second.expires;
+				}));
+		}
+	}
+	
+	State::Cached &cached = state.cache[address];
+	cached.address = result;
+	cached.expires = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<float>(state.cacheTime));
+}
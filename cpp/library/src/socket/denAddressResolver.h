@@ -0,0 +1,149 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "denSocketAddress.h"
+
+/**
+ * \brief Address resolver with asynchronous resolving and result cache.
+ * 
+ * Resolves addresses using denSocketShared::ResolveAddress() unless a different resolve
+ * function is set. Asynchronous requests are resolved one after the other on a helper
+ * thread started on first use. Resolving can block the helper thread for seconds if the
+ * DNS server is slow without blocking the calling thread.
+ * 
+ * Successfully resolved addresses are cached for the cache time. Requests for cached
+ * addresses finish immediately without a DNS lookup. Resolving does not provide the DNS
+ * record time to live. Use a cache time matching how often server addresses change.
+ * All methods are thread safe.
+ */
+class denAddressResolver{
+public:
+	/** \brief Shared pointer. */
+	typedef std::shared_ptr<denAddressResolver> Ref;
+	
+	/** \brief Resolve function. */
+	typedef std::function<denSocketAddress(const std::string&)> ResolveFunction;
+	
+	/** \brief Asynchronous resolve request. */
+	class Request{
+	public:
+		/** \brief Shared pointer. */
+		typedef std::shared_ptr<Request> Ref;
+		
+		/** \brief Create request. */
+		Request(const std::string &address);
+		
+		/** \brief Address to resolve. */
+		inline const std::string &GetAddress() const{ return pAddress; }
+		
+		/** \brief Request finished. */
+		inline bool IsFinished() const{ return pFinished.load(std::memory_order_acquire); }
+		
+		/** \brief Request failed. Only valid if finished. */
+		inline bool HasFailed() const{ return !pError.empty(); }
+		
+		/** \brief Resolved address. Only valid if finished and not failed. */
+		inline const denSocketAddress &GetResult() const{ return pResult; }
+		
+		/** \brief Failure reason. Only valid if finished and failed. */
+		inline const std::string &GetError() const{ return pError; }
+		
+		/**
+		 * \brief Wait until request finished or timeout elapsed.
+		 * 
+		 * \param[in] timeout Timeout in seconds. Negative value waits without timeout.
+		 * \returns true if request finished.
+		 */
+		bool Wait(float timeout);
+		
+	private:
+		friend denAddressResolver;
+		
+		void pFinish(const denSocketAddress &result, const std::string &error);
+		
+		const std::string pAddress;
+		denSocketAddress pResult;
+		std::string pError;
+		std::atomic<bool> pFinished;
+		std::mutex pMutex;
+		std::condition_variable pCondition;
+	};
+	
+	/** \brief Create address resolver. */
+	denAddressResolver();
+	
+	/**
+	 * \brief Clean up address resolver.
+	 * 
+	 * Pending requests not yet started fail. A request being resolved finishes on the
+	 * helper thread without blocking the destructor.
+	 */
+	~denAddressResolver() noexcept;
+	
+	/** \brief Shared address resolver used by connections and servers by default. */
+	static const Ref &Shared();
+	
+	/** \brief Time in seconds resolved addresses are cached. */
+	float GetCacheTime();
+	
+	/** \brief Set time in seconds resolved addresses are cached. 0 disables caching. */
+	void SetCacheTime(float time);
+	
+	/**
+	 * \brief Set resolve function.
+	 * 
+	 * Called on the helper thread for asynchronous requests. Has to be thread safe.
+	 * Set to nullptr to use denSocketShared::ResolveAddress().
+	 */
+	void SetResolveFunction(const ResolveFunction &function);
+	
+	/** \brief Resolve address blocking the calling thread if not cached. */
+	denSocketAddress Resolve(const std::string &address);
+	
+	/** \brief Start resolving address asynchronously. */
+	Request::Ref ResolveAsync(const std::string &address);
+	
+	/** \brief Remove all cached addresses. */
+	void ClearCache();
+	
+private:
+	struct State;
+	
+	static void pRunWorker(const std::shared_ptr<State> &state);
+	static denSocketAddress pResolve(State &state, const std::string &address);
+	static bool pFindCached(State &state, const std::string &address, denSocketAddress &result);
+	static void pAddCached(State &state, const std::string &address, const denSocketAddress &result);
+	
+	std::shared_ptr<State> pState;
+};
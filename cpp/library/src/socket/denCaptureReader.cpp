@@ -0,0 +1,123 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include "denCaptureReader.h"
+
+denCaptureReader::denCaptureReader(const std::string &path) :
+pPath(path){
+	pFile.open(path, std::ios::binary);
+	if(!pFile){
+		std::stringstream s;
+		s << "Open capture file failed: " << path;
+		throw std::runtime_error(s.str());
+	}
+	
+	char magic[6];
+	if(!pReadBytes((uint8_t*)magic, sizeof(magic), false) || memcmp(magic, "DENCAP", sizeof(magic)) != 0){
+		std::stringstream s;
+		s << "Not a capture file: " << path;
+		throw std::runtime_error(s.str());
+	}
+	
+	const int version = (int)pReadInteger(2);
+	if(version != denCaptureWriter::vVersion){
+		std::stringstream s;
+		s << "Unsupported capture file version " << version << ": " << path;
+		throw std::runtime_error(s.str());
+	}
+	
+	pFirstRecord = pFile.tellg();
+}
+
+denCaptureReader::~denCaptureReader() noexcept{
+}
+
+bool denCaptureReader::Read(Record &record){
+	uint8_t direction;
+	if(!pReadBytes(&direction, 1, true)){
+		return false;
+	}
+	
+	record.direction = direction == 1 ? denCaptureWriter::Direction::send
+		: denCaptureWriter::Direction::received;
+	record.stream = (int)pReadInteger(1);
+	record.timestamp = std::chrono::nanoseconds((int64_t)pReadInteger(8));
+	
+	record.address.type = (denSocketAddress::Type)pReadInteger(1);
+	record.address.valueCount = (int)pReadInteger(1);
+	if(record.address.valueCount > 16){
+		pThrowCorrupt();
+	}
+	pReadBytes(record.address.values, record.address.valueCount, false);
+	record.address.port = (uint16_t)pReadInteger(2);
+	
+	record.data.resize((size_t)pReadInteger(2));
+	pReadBytes(record.data.data(), record.data.size(), false);
+	
+	return true;
+}
+
+void denCaptureReader::Rewind(){
+	pFile.clear();
+	pFile.seekg(pFirstRecord);
+}
+
+bool denCaptureReader::pReadBytes(uint8_t *data, size_t length, bool allowEnd){
+	if(length == 0){
+		return true;
+	}
+	
+	pFile.read((char*)data, length);
+	if((size_t)pFile.gcount() == length){
+		return true;
+	}
+	
+	if(allowEnd && pFile.gcount() == 0 && pFile.eof()){
+		return false;
+	}
+	
+	pThrowCorrupt();
+	return false;
+}
+
+uint64_t denCaptureReader::pReadInteger(int byteCount){
+	uint8_t bytes[8];
+	pReadBytes(bytes, byteCount, false);
+	
+	uint64_t value = 0;
+	int i;
+	for(i=0; i<byteCount; i++){
+		value |= (uint64_t)bytes[i] << (i * 8);
+	}
+	return value;
+}
+
+void denCaptureReader::pThrowCorrupt(){
+	std::stringstream s;
+	s << "Capture file corrupt: " << pPath;
+	throw std::runtime_error(s.str());
+}
@@ -0,0 +1,90 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "denCaptureWriter.h"
+
+/**
+ * \brief Datagram capture file reader.
+ * 
+ * Reads records of capture files written by denCaptureWriter in the order they have
+ * been written.
+ */
+class denCaptureReader{
+public:
+	/** \brief Shared pointer. */
+	typedef std::shared_ptr<denCaptureReader> Ref;
+	
+	/** \brief Captured datagram. */
+	struct Record{
+		/** \brief Datagram direction. */
+		denCaptureWriter::Direction direction;
+		
+		/** \brief Stream number. */
+		int stream;
+		
+		/** \brief Time relative to the capture start. */
+		std::chrono::nanoseconds timestamp;
+		
+		/** \brief Remote address. */
+		denSocketAddress address;
+		
+		/** \brief Datagram content. */
+		std::vector<uint8_t> data;
+	};
+	
+	/** \brief Open capture file for reading. */
+	denCaptureReader(const std::string &path);
+	
+	/** \brief Close capture file. */
+	~denCaptureReader() noexcept;
+	
+	/** \brief Path of capture file. */
+	inline const std::string &GetPath() const{ return pPath; }
+	
+	/**
+	 * \brief Read next record.
+	 * 
+	 * \returns false if the end of the capture file is reached.
+	 */
+	bool Read(Record &record);
+	
+	/** \brief Restart reading from the first record. */
+	void Rewind();
+	
+private:
+	bool pReadBytes(uint8_t *data, size_t length, bool allowEnd);
+	uint64_t pReadInteger(int byteCount);
+	void pThrowCorrupt();
+	
+	const std::string pPath;
+	std::ifstream pFile;
+	std::streampos pFirstRecord;
+};
@@ -0,0 +1,142 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <ctime>
+#include <stdexcept>
+#include <thread>
+#include "denCaptureReplay.h"
+#include "../denRealMessage.h"
+
+denCaptureReplay::denCaptureReplay() :
+pTiming(Timing::fastest),
+pTickInterval(1.0f / 60.0f),
+pTrailingTime(1.0f),
+pTime(denMessage::Clock::now()){
+}
+
+denCaptureReplay::~denCaptureReplay() noexcept{
+	// sockets can outlive the driver. do not leave them with a dangling time source
+	std::vector<denSocketReplay::Ref>::const_iterator iter;
+	for(iter = pSockets.cbegin(); iter != pSockets.cend(); iter++){
+		(*iter)->SetTimeSource(nullptr);
+	}
+}
+
+void denCaptureReplay::AddSocket(const denSocketReplay::Ref &socket){
+	if(!socket){
+		throw std::invalid_argument("socket is nullptr");
+	}
+	
+	socket->SetTimeSource([this](){
+		return pTime;
+	});
+	pSockets.push_back(socket);
+}
+
+void denCaptureReplay::SetTiming(Timing timing){
+	pTiming = timing;
+}
+
+void denCaptureReplay::SetTickInterval(float interval){
+	if(interval <= 0.0f){
+		throw std::invalid_argument("interval <= 0");
+	}
+	pTickInterval = interval;
+}
+
+void denCaptureReplay::SetTrailingTime(float time){
+	pTrailingTime = std::max(time, 0.0f);
+}
+
+const denCaptureReplay::Statistics &denCaptureReplay::Run(const Update &update){
+	if(!update){
+		throw std::invalid_argument("update is nullptr");
+	}
+	
+	pStatistics = Statistics();
+	
+	uint64_t replayedBefore = 0;
+	std::vector<denSocketReplay::Ref>::const_iterator iter;
+	for(iter = pSockets.cbegin(); iter != pSockets.cend(); iter++){
+		replayedBefore += (*iter)->GetReplayedCount();
+	}
+	
+	const denMessage::Clock::duration tick(std::chrono::duration_cast<denMessage::Clock::duration>(
+		std::chrono::duration<float>(pTickInterval)));
+	const denMessage::Timestamp realStart(denMessage::Clock::now());
+	const denMessage::Timestamp timeStart(pTime);
+	float trailing = pTrailingTime;
+	
+	while(true){
+		pTime += tick;
+		
+		if(pTiming == Timing::original){
+			std::this_thread::sleep_until(realStart + (pTime - timeStart));
+		}
+		
+		const uint64_t createdBefore = pPoolCreatedCount();
+		const std::clock_t cpuBefore = std::clock();
+		const denMessage::Timestamp updateBefore(denMessage::Clock::now());
+		
+		update(pTickInterval);
+		
+		const double updateTime = std::chrono::duration<double>(
+			denMessage::Clock::now() - updateBefore).count();
+		pStatistics.updateTime += updateTime;
+		pStatistics.maxUpdateTime = std::max(pStatistics.maxUpdateTime, updateTime);
+		pStatistics.cpuTime += (double)(std::clock() - cpuBefore) / (double)CLOCKS_PER_SEC;
+		pStatistics.allocations += pPoolCreatedCount() - createdBefore;
+		pStatistics.ticks++;
+		
+		if(pFinished()){
+			if(trailing <= 0.0f){
+				break;
+			}
+			trailing -= pTickInterval;
+		}
+	}
+	
+	for(iter = pSockets.cbegin(); iter != pSockets.cend(); iter++){
+		pStatistics.datagrams += (*iter)->GetReplayedCount();
+	}
+	pStatistics.datagrams -= replayedBefore;
+	
+	return pStatistics;
+}
+
+uint64_t denCaptureReplay::pPoolCreatedCount(){
+	return denMessage::Pool().GetCreatedCount() + denMessage::ReceivePool().GetCreatedCount()
+		+ denRealMessage::Pool().GetCreatedCount();
+}
+
+bool denCaptureReplay::pFinished() const{
+	std::vector<denSocketReplay::Ref>::const_iterator iter;
+	for(iter = pSockets.cbegin(); iter != pSockets.cend(); iter++){
+		if(!(*iter)->IsFinished()){
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,139 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "denSocketReplay.h"
+
+/**
+ * \brief Capture replay driver.
+ * 
+ * Runs the update loop of a server or connection while replay sockets feed a capture
+ * into it. Time advances in fixed ticks in simulated time shared by all replay sockets.
+ * Replays therefore deliver the same datagrams in the same ticks each run, independent
+ * of how long updates take. Replays run either paced to the original timing or as fast
+ * as possible. Measures the time spent updating and the pool allocations done to
+ * compare the performance of library versions.
+ * 
+ * Example replaying a server capture:
+ * \code{.cpp}
+ * class ReplayServer : public denServer{
+ * public:
+ *     denSocketReplay::Ref socket;
+ *     denSocket::Ref CreateSocket() override{ return socket; }
+ * };
+ * 
+ * denCaptureReplay replay;
+ * server.socket = std::make_shared<denSocketReplay>(std::make_shared<denCaptureReader>("match.dencap"));
+ * replay.AddSocket(server.socket);
+ * server.ListenOn("0.0.0.0:3413");
+ * replay.Run([&](float elapsed){ server.Update(elapsed); });
+ * \endcode
+ */
+class denCaptureReplay{
+public:
+	/** \brief Replay timing. */
+	enum class Timing{
+		original, //<! Pace ticks to the original timing.
+		fastest //<! Run ticks as fast as possible.
+	};
+	
+	/** \brief Update callback called once per tick with the elapsed time in seconds. */
+	typedef std::function<void(float)> Update;
+	
+	/** \brief Replay statistics. */
+	struct Statistics{
+		/** \brief Count of ticks. */
+		uint64_t ticks = 0;
+		
+		/** \brief Count of replayed datagrams. */
+		uint64_t datagrams = 0;
+		
+		/** \brief Wall time in seconds spent in updates. */
+		double updateTime = 0.0;
+		
+		/** \brief Longest wall time in seconds spent in one update. */
+		double maxUpdateTime = 0.0;
+		
+		/** \brief Processor time in seconds used by the process during updates. */
+		double cpuTime = 0.0;
+		
+		/** \brief Count of message pool items created during updates. */
+		uint64_t allocations = 0;
+	};
+	
+	/** \brief Create replay driver. */
+	denCaptureReplay();
+	
+	/** \brief Clean up replay driver. */
+	~denCaptureReplay() noexcept;
+	
+	/**
+	 * \brief Add replay socket.
+	 * 
+	 * Sets the time source of the socket to the simulated time. Add sockets before they
+	 * are bound.
+	 */
+	void AddSocket(const denSocketReplay::Ref &socket);
+	
+	/** \brief Timing. */
+	inline Timing GetTiming() const{ return pTiming; }
+	
+	/** \brief Set timing. */
+	void SetTiming(Timing timing);
+	
+	/** \brief Tick interval in seconds. */
+	inline float GetTickInterval() const{ return pTickInterval; }
+	
+	/** \brief Set tick interval in seconds. */
+	void SetTickInterval(float interval);
+	
+	/** \brief Time in seconds to keep updating after all sockets finished replaying. */
+	inline float GetTrailingTime() const{ return pTrailingTime; }
+	
+	/** \brief Set time in seconds to keep updating after all sockets finished replaying. */
+	void SetTrailingTime(float time);
+	
+	/** \brief Simulated time. */
+	inline const denMessage::Timestamp &GetTime() const{ return pTime; }
+	
+	/** \brief Statistics of the last run. */
+	inline const Statistics &GetStatistics() const{ return pStatistics; }
+	
+	/** \brief Run replay until all sockets finished replaying and the trailing time elapsed. */
+	const Statistics &Run(const Update &update);
+	
+private:
+	static uint64_t pPoolCreatedCount();
+	bool pFinished() const;
+	
+	std::vector<denSocketReplay::Ref> pSockets;
+	Timing pTiming;
+	float pTickInterval;
+	float pTrailingTime;
+	denMessage::Timestamp pTime;
+	Statistics pStatistics;
+};
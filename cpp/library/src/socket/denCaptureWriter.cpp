@@ -0,0 +1,124 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+#include "denCaptureWriter.h"
+
+// buffered record bytes written to the file at once
+static const size_t vFlushSize = 65536;
+
+static void fAppend(std::vector<uint8_t> &buffer, uint64_t value, int byteCount){
+	int i;
+	for(i=0; i<byteCount; i++){
+		buffer.push_back((uint8_t)(value >> (i * 8)));
+	}
+}
+
+denCaptureWriter::denCaptureWriter(const std::string &path) :
+pPath(path),
+pStartTime(denMessage::Clock::now()),
+pStreamCount(0),
+pDatagramCount(0){
+	pFile.open(path, std::ios::binary | std::ios::trunc);
+	if(!pFile){
+		std::stringstream s;
+		s << "Open capture file failed: " << path;
+		throw std::runtime_error(s.str());
+	}
+	
+	const char magic[] = {'D', 'E', 'N', 'C', 'A', 'P'};
+	pBuffer.insert(pBuffer.end(), magic, magic + sizeof(magic));
+	fAppend(pBuffer, vVersion, 2);
+	pBuffer.reserve(vFlushSize + 65536);
+}
+
+denCaptureWriter::~denCaptureWriter() noexcept{
+	try{
+		pFlush();
+		
+	}catch(...){
+	}
+}
+
+uint64_t denCaptureWriter::GetDatagramCount(){
+	const std::lock_guard<std::mutex> guard(pMutex);
+	return pDatagramCount;
+}
+
+int denCaptureWriter::AddStream(){
+	const std::lock_guard<std::mutex> guard(pMutex);
+	if(pStreamCount == 256){
+		throw std::runtime_error("Capture supports at most 256 streams");
+	}
+	return pStreamCount++;
+}
+
+void denCaptureWriter::Write(Direction direction, int stream, const denMessage::Timestamp &timestamp,
+const denSocketAddress &address, const uint8_t *header, int headerLength,
+const uint8_t *data, size_t length){
+	const std::lock_guard<std::mutex> guard(pMutex);
+	
+	fAppend(pBuffer, direction == Direction::send ? 1 : 0, 1);
+	fAppend(pBuffer, (uint64_t)stream, 1);
+	fAppend(pBuffer, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		timestamp - pStartTime).count(), 8);
+	
+	fAppend(pBuffer, (uint64_t)address.type, 1);
+	fAppend(pBuffer, (uint64_t)address.valueCount, 1);
+	pBuffer.insert(pBuffer.end(), address.values, address.values + address.valueCount);
+	fAppend(pBuffer, address.port, 2);
+	
+	fAppend(pBuffer, (uint64_t)headerLength + length, 2);
+	pBuffer.insert(pBuffer.end(), header, header + headerLength);
+	pBuffer.insert(pBuffer.end(), data, data + length);
+	
+	pDatagramCount++;
+	
+	if(pBuffer.size() >= vFlushSize){
+		pFlush();
+	}
+}
+
+void denCaptureWriter::Flush(){
+	const std::lock_guard<std::mutex> guard(pMutex);
+	pFlush();
+	pFile.flush();
+}
+
+void denCaptureWriter::pFlush(){
+	if(pBuffer.empty()){
+		return;
+	}
+	
+	pFile.write((const char*)pBuffer.data(), pBuffer.size());
+	pBuffer.clear();
+	
+	if(!pFile){
+		std::stringstream s;
+		s << "Write capture file failed: " << pPath;
+		throw std::runtime_error(s.str());
+	}
+}
@@ -0,0 +1,106 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "denSocketAddress.h"
+#include "../message/denMessage.h"
+
+/**
+ * \brief Datagram capture file writer.
+ * 
+ * Writes datagrams send and received by denSocketCapture sockets into a binary capture
+ * file. Multiple sockets can write to the same capture file, for example all shard
+ * sockets of a server. Each socket is assigned a stream number. Writing is thread safe.
+ * 
+ * The capture file starts with the magic "DENCAP" followed by the format version as
+ * 16-bit integer. Each datagram is stored as record:
+ * - 8-bit direction (0=received, 1=send)
+ * - 8-bit stream number
+ * - 64-bit timestamp in nanoseconds relative to the capture start
+ * - 8-bit address type, 8-bit address value count, address values and 16-bit port
+ * - 16-bit datagram length followed by the datagram content
+ * 
+ * All integers are stored in little endian byte order.
+ */
+class denCaptureWriter{
+public:
+	/** \brief Shared pointer. */
+	typedef std::shared_ptr<denCaptureWriter> Ref;
+	
+	/** \brief Datagram direction. */
+	enum class Direction{
+		received, //<! Datagram received by the socket.
+		send //<! Datagram send by the socket.
+	};
+	
+	/** \brief Capture file format version. */
+	static const uint16_t vVersion = 1;
+	
+	/** \brief Create capture file writer writing to path. */
+	denCaptureWriter(const std::string &path);
+	
+	/** \brief Flush and close capture file. */
+	~denCaptureWriter() noexcept;
+	
+	/** \brief Path of capture file. */
+	inline const std::string &GetPath() const{ return pPath; }
+	
+	/** \brief Capture start time all timestamps are relative to. */
+	inline const denMessage::Timestamp &GetStartTime() const{ return pStartTime; }
+	
+	/** \brief Count of written datagrams. */
+	uint64_t GetDatagramCount();
+	
+	/** \brief Add stream returning the stream number. */
+	int AddStream();
+	
+	/**
+	 * \brief Write datagram.
+	 * 
+	 * Datagram content is headerLength bytes of header followed by length bytes of data.
+	 */
+	void Write(Direction direction, int stream, const denMessage::Timestamp &timestamp,
+		const denSocketAddress &address, const uint8_t *header, int headerLength,
+		const uint8_t *data, size_t length);
+	
+	/** \brief Write buffered records to the capture file. */
+	void Flush();
+	
+private:
+	void pFlush();
+	
+	const std::string pPath;
+	const denMessage::Timestamp pStartTime;
+	std::ofstream pFile;
+	std::vector<uint8_t> pBuffer;
+	std::mutex pMutex;
+	int pStreamCount;
+	uint64_t pDatagramCount;
+};
@@ -22,9 +22,23 @@
  * SOFTWARE.
  */
 
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
 #include "denSocket.h"
 
-denSocket::denSocket(){
+// sleep interval waiting without timeout on sockets not able to detect pending datagrams
+static const float vDefaultWaitInterval = 0.001f;
+
+denSocket::denSocket() :
+pReusePort(false),
+pConnected(false),
+pPathDatagramSize(0),
+pReceiveBufferSize(0),
+pSendBufferSize(0),
+pDroppedDatagramCount(0){
 }
 
 denSocket::~denSocket() noexcept{
@@ -33,3 +47,142 @@ denSocket::~denSocket() noexcept{
 void denSocket::SetAddress(const denSocketAddress &address){
 	pAddress = address;
 }
+
+void denSocket::SetReusePort(bool reusePort){
+	pReusePort = reusePort;
+}
+
+void denSocket::SetReceiveBufferSize(int size){
+	if(size < 0){
+		throw std::invalid_argument("size < 0");
+	}
+	pReceiveBufferSize = size;
+}
+
+void denSocket::SetSendBufferSize(int size){
+	if(size < 0){
+		throw std::invalid_argument("size < 0");
+	}
+	pSendBufferSize = size;
+}
+
+void denSocket::Connect(const denSocketAddress &address){
+	pRemoteAddress = address;
+	pConnected = true;
+}
+
+void denSocket::SetPathDatagramSize(int size){
+	if(size < 0){
+		throw std::invalid_argument("size < 0");
+	}
+	pPathDatagramSize = size;
+}
+
+bool denSocket::SendProbeDatagram(const denMessage &message, const denSocketAddress &address){
+	SendDatagram(message, address);
+	return true;
+}
+
+bool denSocket::AttachReusePortSteering(int){
+	return false;
+}
+
+int denSocket::ReceiveDatagrams(Datagrams &datagrams, int maxCount){
+	int count = 0;
+	
+	while(count < maxCount){
+		denSocketAddress address;
+		const denMessage::Ref message(ReceiveDatagram(address));
+		if(!message){
+			break;
+		}
+		
+		datagrams.push_back({message, address});
+		count++;
+	}
+	
+	return count;
+}
+
+void denSocket::QueueDatagram(const denMessage::Ref &message, const denSocketAddress &address){
+	QueueDatagram(nullptr, 0, message, 0, message->Item().GetLength(), address);
+}
+
+void denSocket::QueueDatagram(const uint8_t *header, int headerLength, const denMessage::Ref &message,
+size_t offset, size_t length, const denSocketAddress &address){
+	if(headerLength < 0 || headerLength > vMaxHeaderLength){
+		throw std::invalid_argument("QueueDatagram: invalid header length");
+	}
+	if(offset + length > message->Item().GetLength()){
+		throw std::invalid_argument("QueueDatagram: payload range outside message");
+	}
+	if(headerLength + length > 65500){
+		std::stringstream s;
+		s << "QueueDatagram: message size too long: " << headerLength + length << " (max 65500)";
+		throw std::runtime_error(s.str());
+	}
+	
+	pSendQueue.emplace_back();
+	QueuedDatagram &datagram = pSendQueue.back();
+	if(headerLength > 0){
+		memcpy(datagram.header, header, headerLength);
+	}
+	datagram.headerLength = headerLength;
+	datagram.message = message;
+	datagram.offset = offset;
+	datagram.length = length;
+	datagram.address = address;
+}
+
+void denSocket::FlushDatagrams(){
+	if(pSendQueue.empty()){
+		return;
+	}
+	
+	try{
+		QueuedDatagrams::const_iterator iter;
+		for(iter = pSendQueue.cbegin(); iter != pSendQueue.cend(); iter++){
+			if(iter->headerLength == 0 && iter->offset == 0
+			&& iter->length == iter->message->Item().GetLength()){
+				SendDatagram(iter->message->Item(), iter->address);
+				continue;
+			}
+			
+			const denMessage::Ref assembled(denMessage::Pool().Get());
+			denMessage &message = assembled->Item();
+			message.SetLength(iter->GetLength());
+			uint8_t * const data = (uint8_t*)message.GetData().c_str();
+			if(iter->headerLength > 0){
+				memcpy(data, iter->header, iter->headerLength);
+			}
+			if(iter->length > 0){
+				memcpy(data + iter->headerLength, iter->GetPayload(), iter->length);
+			}
+			SendDatagram(message, iter->address);
+		}
+		
+	}catch(...){
+		pSendQueue.clear();
+		throw;
+	}
+	
+	pSendQueue.clear();
+}
+
+bool denSocket::WaitForDatagram(float timeout){
+	// pending datagrams can not be detected. sleep instead of letting callers spin
+	if(timeout < 0.0f){
+		std::this_thread::sleep_for(std::chrono::duration<float>(vDefaultWaitInterval));
+		return true;
+	}
+	
+	if(timeout > 0.0f){
+		std::this_thread::sleep_for(std::chrono::duration<float>(timeout));
+	}
+	return false;
+}
+
+bool denSocket::PrepareWait(intptr_t &handle){
+	handle = -1;
+	return false;
+}
@@ -25,6 +25,8 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+#include <stdint.h>
 #include "denSocketAddress.h"
 #include "../message/denMessage.h"
 
@@ -36,6 +38,57 @@ public:
 	/** \brief Shared pointer. */
 	typedef std::shared_ptr<denSocket> Ref;
 	
+	/** \brief Datagram with remote address. */
+	struct Datagram{
+		/** \brief Message. */
+		denMessage::Ref message;
+		
+		/** \brief Remote address. */
+		denSocketAddress address;
+	};
+	
+	/** \brief Datagram list. */
+	typedef std::vector<Datagram> Datagrams;
+	
+	/** \brief Maximum length of protocol header send in front of a payload. */
+	static const int vMaxHeaderLength = 8;
+	
+	/**
+	 * \brief Datagram queued for sending.
+	 * 
+	 * Datagram content is the protocol header followed by length bytes of message starting
+	 * at offset. Sockets supporting scatter-gather send header and payload without copying.
+	 */
+	struct QueuedDatagram{
+		/** \brief Protocol header. */
+		uint8_t header[vMaxHeaderLength];
+		
+		/** \brief Length of protocol header. */
+		int headerLength;
+		
+		/** \brief Payload message. */
+		denMessage::Ref message;
+		
+		/** \brief Offset of payload in message. */
+		size_t offset;
+		
+		/** \brief Length of payload. */
+		size_t length;
+		
+		/** \brief Remote address. */
+		denSocketAddress address;
+		
+		/** \brief Pointer to payload data. */
+		inline const uint8_t *GetPayload() const{
+			return (const uint8_t*)message->Item().GetData().c_str() + offset; }
+		
+		/** \brief Length of datagram. */
+		inline size_t GetLength() const{ return (size_t)headerLength + length; }
+	};
+	
+	/** \brief Queued datagram list. */
+	typedef std::vector<QueuedDatagram> QueuedDatagrams;
+	
 protected:
 	/** \brief Create socket. */
 	denSocket();
@@ -50,15 +103,183 @@ public:
 	/** \brief Set socket address. */
 	void SetAddress(const denSocketAddress &address);
 	
+	/** \brief Allow multiple sockets to bind to the same address. */
+	inline bool GetReusePort() const{ return pReusePort; }
+	
+	/**
+	 * \brief Set if multiple sockets are allowed to bind to the same address.
+	 * 
+	 * Has to be set before calling Bind(). The kernel distributes incoming datagrams
+	 * across all sockets bound to the address keeping each remote address on the same
+	 * socket. Sockets not supporting this fail to bind the second socket.
+	 */
+	void SetReusePort(bool reusePort);
+	
+	/** \brief Receive buffer size in bytes or 0 to use the system default. */
+	inline int GetReceiveBufferSize() const{ return pReceiveBufferSize; }
+	
+	/**
+	 * \brief Set receive buffer size in bytes or 0 to use the system default.
+	 * 
+	 * Has to be set before calling Bind(). Datagrams arriving while the receive buffer
+	 * is full are dropped by the kernel. The kernel can limit the size to a system
+	 * maximum. After Bind() contains the size actually used if supported by the socket.
+	 */
+	void SetReceiveBufferSize(int size);
+	
+	/** \brief Send buffer size in bytes or 0 to use the system default. */
+	inline int GetSendBufferSize() const{ return pSendBufferSize; }
+	
+	/**
+	 * \brief Set send buffer size in bytes or 0 to use the system default.
+	 * 
+	 * Has to be set before calling Bind(). The kernel can limit the size to a system
+	 * maximum. After Bind() contains the size actually used if supported by the socket.
+	 */
+	void SetSendBufferSize(int size);
+	
+	/**
+	 * \brief Count of received datagrams dropped by the kernel.
+	 * 
+	 * Datagrams are dropped if they arrive while the receive buffer is full. The count
+	 * is updated while receiving datagrams. Stays 0 if not supported by the socket.
+	 */
+	inline uint64_t GetDroppedDatagramCount() const{ return pDroppedDatagramCount; }
+	
 	/** \brief Bind socket to stored address. */
 	virtual void Bind() = 0;
 	
+	/** \brief Socket is connected to a remote address. */
+	inline bool IsConnected() const{ return pConnected; }
+	
+	/** \brief Remote address the socket is connected to. */
+	inline const denSocketAddress &GetRemoteAddress() const{ return pRemoteAddress; }
+	
+	/**
+	 * \brief Connect socket to remote address.
+	 * 
+	 * Call after Bind(). Connected sockets receive only datagrams from the remote address.
+	 * Datagrams to the remote address are send without converting the address and the
+	 * kernel skips the route lookup for each datagram. Received datagrams use the remote
+	 * address without converting it. Default implementation stores the remote address.
+	 */
+	virtual void Connect(const denSocketAddress &address);
+	
+	/** \brief Datagram size known to reach the connected remote address or 0 if unknown. */
+	inline int GetPathDatagramSize() const{ return pPathDatagramSize; }
+	
+	/**
+	 * \brief Set datagram size known to reach the connected remote address or 0 if unknown.
+	 * 
+	 * Set by connections after discovering the path MTU. Subclasses can use the size to
+	 * batch larger datagrams send to the connected remote address.
+	 */
+	void SetPathDatagramSize(int size);
+	
+	/**
+	 * \brief Steer datagrams across reuse port group using the packet flow hash.
+	 * 
+	 * Call on one bound socket of a group of socketCount sockets bound to the same address
+	 * with reuse port enabled. Replaces the default kernel distribution with one using the
+	 * receive flow hash modulo socketCount. Devices not providing a receive flow hash,
+	 * like the loopback device, steer all datagrams to the first socket. Default
+	 * implementation does nothing.
+	 * 
+	 * \returns true if steering is attached.
+	 */
+	virtual bool AttachReusePortSteering(int socketCount);
+	
 	/** \brief Receive datagram from socket. */
 	virtual denMessage::Ref ReceiveDatagram(denSocketAddress &address) = 0;
 	
 	/** \brief Send datagram. */
 	virtual void SendDatagram(const denMessage &message, const denSocketAddress &address) = 0;
 	
+	/**
+	 * \brief Send path MTU probe datagram with fragmentation disabled.
+	 * 
+	 * The datagram is send right away without fragmenting it along the path. Default
+	 * implementation calls SendDatagram(). Subclasses supporting to disable fragmentation
+	 * have to overwrite.
+	 * 
+	 * \returns false if the datagram is too large to be send without fragmenting.
+	 */
+	virtual bool SendProbeDatagram(const denMessage &message, const denSocketAddress &address);
+	
+	/**
+	 * \brief Receive up to maxCount datagrams from socket.
+	 * 
+	 * Received datagrams are appended to datagrams. Default implementation calls
+	 * ReceiveDatagram() until maxCount datagrams are received or no more datagrams
+	 * are pending. Subclasses can overwrite to receive datagrams in batches.
+	 * 
+	 * \returns Count of received datagrams.
+	 */
+	virtual int ReceiveDatagrams(Datagrams &datagrams, int maxCount);
+	
+	/**
+	 * \brief Queue datagram for sending.
+	 * 
+	 * Datagram is send the next time FlushDatagrams() is called. The message is
+	 * referenced and must not be modified until flushed.
+	 */
+	void QueueDatagram(const denMessage::Ref &message, const denSocketAddress &address);
+	
+	/**
+	 * \brief Queue datagram with protocol header for sending.
+	 * 
+	 * Datagram consists of headerLength bytes of header followed by length bytes of
+	 * message starting at offset. The header is copied while the message is referenced
+	 * and must not be modified until flushed.
+	 */
+	void QueueDatagram(const uint8_t *header, int headerLength, const denMessage::Ref &message,
+		size_t offset, size_t length, const denSocketAddress &address);
+	
+	/** \brief Count of queued datagrams. */
+	inline size_t GetQueuedDatagramCount() const{ return pSendQueue.size(); }
+	
+	/**
+	 * \brief Send all queued datagrams.
+	 * 
+	 * Default implementation calls SendDatagram() for each queued datagram. Datagrams with
+	 * protocol header or partial payload are assembled into a temporary message first.
+	 * Subclasses can overwrite to send datagrams in batches.
+	 */
+	virtual void FlushDatagrams();
+	
+	/**
+	 * \brief Wait until datagrams are pending or timeout elapsed.
+	 * 
+	 * Default implementation can not detect pending datagrams. It sleeps for the timeout
+	 * and returns false. Without timeout it sleeps for 1ms and returns true so callers
+	 * poll the socket. Subclasses can overwrite to block until the socket becomes readable.
+	 * 
+	 * \param[in] timeout Timeout in seconds. Negative value waits without timeout.
+	 * \returns true if datagrams are pending or false if timeout elapsed.
+	 */
+	virtual bool WaitForDatagram(float timeout);
+	
+	/**
+	 * \brief Prepare waiting on multiple sockets together.
+	 * 
+	 * Stores in \em handle the file descriptor (socket handle on Windows) becoming
+	 * readable if datagrams arrive or -1 if the socket has no such handle. Sockets without
+	 * handle are waited on using WaitForDatagram(). Used by denSocketWaitSet.
+	 * 
+	 * Default implementation stores -1 and returns false.
+	 * 
+	 * \returns true if datagrams are pending already without the handle being readable.
+	 */
+	virtual bool PrepareWait(intptr_t &handle);
+	
 protected:
 	denSocketAddress pAddress;
+	QueuedDatagrams pSendQueue;
+	bool pReusePort;
+	bool pConnected;
+	denSocketAddress pRemoteAddress;
+	int pPathDatagramSize;
+	int pReceiveBufferSize;
+	int pSendBufferSize;
+	uint64_t pDroppedDatagramCount;
 };
@@ -102,6 +102,18 @@ denSocketAddress denSocketAddress::IPv6Loopback(uint16_t port){
 	return address;
 }
 
+denSocketAddress denSocketAddress::Memory(uint16_t port){
+	denSocketAddress address;
+	address.type = Type::memory;
+	address.valueCount = 0;
+	address.port = port;
+	return address;
+}
+
+denSocketAddress denSocketAddress::MemoryAny(){
+	return Memory(0);
+}
+
 std::string denSocketAddress::ToString() const{
 	bool groupingZeros = false;
 	bool canGroupZeros = true;
@@ -152,6 +164,10 @@ std::string denSocketAddress::ToString() const{
 		s << "]:" << std::dec << std::setw(0) << (int)port;
 		break;
 		
+	case Type::memory:
+		s << "memory:" << (int)port;
+		break;
+		
 	default:
 		s << "?";
 	}
@@ -171,3 +187,18 @@ bool denSocketAddress::operator==(const denSocketAddress &address) const{
 	return type == address.type && port == address.port
 		&& memcmp(&values, &address.values, sizeof(values)) == 0;
 }
+
+size_t denSocketAddress::Hash() const{
+	uint64_t parts[2];
+	memcpy(&parts, &values, sizeof(parts));
+	
+	// mix components using the 64-bit finalizer of MurmurHash3
+	uint64_t hash = parts[0] ^ (parts[1] * 0x9e3779b97f4a7c15ULL)
+		^ ((uint64_t)port << 32) ^ (uint64_t)type;
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	return (size_t)hash;
+}
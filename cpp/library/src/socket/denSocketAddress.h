@@ -26,6 +26,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <functional>
 
 /**
  * \brief Socket address class.
@@ -41,7 +42,8 @@ class denSocketAddress{
 public:
 	enum class Type{
 		ipv4,
-		ipv6
+		ipv6,
+		memory //<! In-process memory transport address using only the port.
 	};
 	
 	/** \brief Create empty address. */
@@ -76,6 +78,12 @@ public:
 	/** \brief Create IPv6 loopback address. */
 	static denSocketAddress IPv6Loopback(uint16_t port = 3413);
 	
+	/** \brief Create in-process memory transport address. */
+	static denSocketAddress Memory(uint16_t port = 3413);
+	
+	/** \brief Create in-process memory transport any address. */
+	static denSocketAddress MemoryAny();
+	
 	/** \brief String representation of address. */
 	std::string ToString() const;
 	
@@ -85,6 +93,14 @@ public:
 	/** \brief Addresses are equal. */
 	bool operator==(const denSocketAddress &address) const;
 	
+	/**
+	 * \brief Hash of address.
+	 * 
+	 * Equal addresses have equal hashes. Mixes all components so the low bits are
+	 * suitable for indexing power of two sized hash tables.
+	 */
+	size_t Hash() const;
+	
 	/** \brief Address type. */
 	Type type;
 	
@@ -97,3 +113,10 @@ public:
 	/** \brief Port. */
 	uint16_t port;
 };
+
+namespace std{
+	/** \brief Hash for using denSocketAddress as key in unordered containers. */
+	template<> struct hash<denSocketAddress>{
+		inline size_t operator()(const denSocketAddress &address) const{ return address.Hash(); }
+	};
+}
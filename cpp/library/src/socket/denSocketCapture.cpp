@@ -0,0 +1,130 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdexcept>
+#include "denSocketCapture.h"
+
+denSocketCapture::denSocketCapture(const denSocket::Ref &socket, const denCaptureWriter::Ref &writer) :
+pSocket(socket),
+pWriter(writer),
+pStream(writer ? writer->AddStream() : 0){
+	if(!socket){
+		throw std::invalid_argument("socket is nullptr");
+	}
+	if(!writer){
+		throw std::invalid_argument("writer is nullptr");
+	}
+}
+
+denSocketCapture::~denSocketCapture() noexcept{
+}
+
+void denSocketCapture::Bind(){
+	pSocket->SetAddress(pAddress);
+	pSocket->SetReusePort(pReusePort);
+	pSocket->SetReceiveBufferSize(pReceiveBufferSize);
+	pSocket->SetSendBufferSize(pSendBufferSize);
+	pSocket->Bind();
+	
+	pAddress = pSocket->GetAddress();
+	pReceiveBufferSize = pSocket->GetReceiveBufferSize();
+	pSendBufferSize = pSocket->GetSendBufferSize();
+}
+
+void denSocketCapture::Connect(const denSocketAddress &address){
+	pSocket->Connect(address);
+	denSocket::Connect(address);
+}
+
+bool denSocketCapture::AttachReusePortSteering(int socketCount){
+	return pSocket->AttachReusePortSteering(socketCount);
+}
+
+denMessage::Ref denSocketCapture::ReceiveDatagram(denSocketAddress &address){
+	const denMessage::Ref message(pSocket->ReceiveDatagram(address));
+	pDroppedDatagramCount = pSocket->GetDroppedDatagramCount();
+	
+	if(message){
+		pRecordReceived(message->Item(), address);
+	}
+	return message;
+}
+
+void denSocketCapture::SendDatagram(const denMessage &message, const denSocketAddress &address){
+	pWriter->Write(denCaptureWriter::Direction::send, pStream, denMessage::Clock::now(), address,
+		nullptr, 0, (const uint8_t*)message.GetData().c_str(), message.GetLength());
+	pSocket->SendDatagram(message, address);
+}
+
+bool denSocketCapture::SendProbeDatagram(const denMessage &message, const denSocketAddress &address){
+	pWriter->Write(denCaptureWriter::Direction::send, pStream, denMessage::Clock::now(), address,
+		nullptr, 0, (const uint8_t*)message.GetData().c_str(), message.GetLength());
+	return pSocket->SendProbeDatagram(message, address);
+}
+
+int denSocketCapture::ReceiveDatagrams(Datagrams &datagrams, int maxCount){
+	const size_t first = datagrams.size();
+	const int count = pSocket->ReceiveDatagrams(datagrams, maxCount);
+	pDroppedDatagramCount = pSocket->GetDroppedDatagramCount();
+	
+	size_t i;
+	for(i=first; i<datagrams.size(); i++){
+		pRecordReceived(datagrams[i].message->Item(), datagrams[i].address);
+	}
+	return count;
+}
+
+void denSocketCapture::FlushDatagrams(){
+	const denMessage::Timestamp now(denMessage::Clock::now());
+	
+	try{
+		QueuedDatagrams::const_iterator iter;
+		for(iter = pSendQueue.cbegin(); iter != pSendQueue.cend(); iter++){
+			pWriter->Write(denCaptureWriter::Direction::send, pStream, now, iter->address,
+				iter->header, iter->headerLength, iter->GetPayload(), iter->length);
+			pSocket->QueueDatagram(iter->header, iter->headerLength, iter->message,
+				iter->offset, iter->length, iter->address);
+		}
+		
+	}catch(...){
+		pSendQueue.clear();
+		throw;
+	}
+	
+	pSendQueue.clear();
+	pSocket->FlushDatagrams();
+}
+
+bool denSocketCapture::WaitForDatagram(float timeout){
+	return pSocket->WaitForDatagram(timeout);
+}
+
+bool denSocketCapture::PrepareWait(intptr_t &handle){
+	return pSocket->PrepareWait(handle);
+}
+
+void denSocketCapture::pRecordReceived(const denMessage &message, const denSocketAddress &address){
+	pWriter->Write(denCaptureWriter::Direction::received, pStream, message.GetTimestamp(), address,
+		nullptr, 0, (const uint8_t*)message.GetData().c_str(), message.GetLength());
+}
@@ -0,0 +1,97 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "denSocket.h"
+#include "denCaptureWriter.h"
+
+/**
+ * \brief Capture recording socket.
+ * 
+ * Wraps another socket and writes all datagrams send and received through it into a
+ * capture file. Received datagrams are recorded with their receive timestamp, send
+ * datagrams with the time they are flushed. Use denSocketReplay to replay captures.
+ * 
+ * To record the datagrams of a connection or server overwrite CreateSocket() to wrap the
+ * socket created by the default implementation. All shard sockets of a server can
+ * share the same writer.
+ */
+class denSocketCapture : public denSocket{
+public:
+	/** \brief Shared pointer. */
+	typedef std::shared_ptr<denSocketCapture> Ref;
+	
+	/** \brief Create capture socket wrapping socket writing to a new stream of writer. */
+	denSocketCapture(const denSocket::Ref &socket, const denCaptureWriter::Ref &writer);
+	
+	/** \brief Clean up socket. */
+	virtual ~denSocketCapture() noexcept;
+	
+	/** \brief Wrapped socket. */
+	inline const denSocket::Ref &GetSocket() const{ return pSocket; }
+	
+	/** \brief Capture writer. */
+	inline const denCaptureWriter::Ref &GetWriter() const{ return pWriter; }
+	
+	/** \brief Stream number in capture file. */
+	inline int GetStream() const{ return pStream; }
+	
+	/** \brief Bind wrapped socket to stored address. */
+	virtual void Bind();
+	
+	/** \brief Connect wrapped socket to remote address. */
+	virtual void Connect(const denSocketAddress &address);
+	
+	/** \brief Attach reuse port steering to wrapped socket. */
+	virtual bool AttachReusePortSteering(int socketCount);
+	
+	/** \brief Receive datagram from socket. */
+	virtual denMessage::Ref ReceiveDatagram(denSocketAddress &address);
+	
+	/** \brief Send datagram. */
+	virtual void SendDatagram(const denMessage &message, const denSocketAddress &address);
+	
+	/** \brief Record and send probe datagram. */
+	virtual bool SendProbeDatagram(const denMessage &message, const denSocketAddress &address);
+	
+	/** \brief Receive up to maxCount datagrams from wrapped socket. */
+	virtual int ReceiveDatagrams(Datagrams &datagrams, int maxCount);
+	
+	/** \brief Send all queued datagrams using wrapped socket. */
+	virtual void FlushDatagrams();
+	
+	/** \brief Wait until datagrams are pending on wrapped socket or timeout elapsed. */
+	virtual bool WaitForDatagram(float timeout);
+	
+	/** \brief Prepare waiting on wrapped socket together with other sockets. */
+	virtual bool PrepareWait(intptr_t &handle);
+	
+private:
+	void pRecordReceived(const denMessage &message, const denSocketAddress &address);
+	
+	const denSocket::Ref pSocket;
+	const denCaptureWriter::Ref pWriter;
+	const int pStream;
+};
@@ -0,0 +1,332 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "denSocketImpairment.h"
+
+// maximum count of datagrams to pull from the wrapped socket in one call
+static const int vMaxPullCount = 1024;
+
+denSocketImpairment::denSocketImpairment(const denSocket::Ref &socket) :
+pSocket(socket),
+pNextSequence(0){
+	if(!socket){
+		throw std::invalid_argument("socket is nullptr");
+	}
+}
+
+denSocketImpairment::~denSocketImpairment() noexcept{
+	// datagrams in flight still arrive after the sender closed. send them right away
+	// since nobody is left to send them once due
+	try{
+		pSendDue(denMessage::Timestamp::max());
+		
+	}catch(...){
+	}
+}
+
+void denSocketImpairment::SetSendImpairment(const Impairment &impairment){
+	pSend.impairment = impairment;
+}
+
+void denSocketImpairment::SetReceiveImpairment(const Impairment &impairment){
+	pReceive.impairment = impairment;
+}
+
+void denSocketImpairment::SetSeed(uint32_t seed){
+	pRandomGenerator.seed(seed);
+}
+
+void denSocketImpairment::SetTimeSource(const TimeSource &timeSource){
+	pTimeSource = timeSource;
+}
+
+void denSocketImpairment::Bind(){
+	pSocket->SetAddress(pAddress);
+	pSocket->SetReusePort(pReusePort);
+	pSocket->SetReceiveBufferSize(pReceiveBufferSize);
+	pSocket->SetSendBufferSize(pSendBufferSize);
+	pSocket->Bind();
+	
+	pAddress = pSocket->GetAddress();
+	pReceiveBufferSize = pSocket->GetReceiveBufferSize();
+	pSendBufferSize = pSocket->GetSendBufferSize();
+}
+
+void denSocketImpairment::Connect(const denSocketAddress &address){
+	pSocket->Connect(address);
+	denSocket::Connect(address);
+}
+
+bool denSocketImpairment::AttachReusePortSteering(int socketCount){
+	return pSocket->AttachReusePortSteering(socketCount);
+}
+
+denMessage::Ref denSocketImpairment::ReceiveDatagram(denSocketAddress &address){
+	Datagrams datagrams;
+	if(ReceiveDatagrams(datagrams, 1) == 0){
+		return nullptr;
+	}
+	
+	address = datagrams.front().address;
+	return datagrams.front().message;
+}
+
+void denSocketImpairment::SendDatagram(const denMessage &message, const denSocketAddress &address){
+	const denMessage::Ref copy(denMessage::Pool().Get());
+	copy->Item().SetLength(message.GetLength());
+	memcpy((char*)copy->Item().GetData().c_str(), message.GetData().c_str(), message.GetLength());
+	
+	QueueDatagram(copy, address);
+	FlushDatagrams();
+}
+
+int denSocketImpairment::ReceiveDatagrams(Datagrams &datagrams, int maxCount){
+	const denMessage::Timestamp now(pNow());
+	pSendDue(now);
+	pPullReceived(now);
+	
+	Delayed delayed;
+	int count = 0;
+	
+	while(count < maxCount && pPopDue(pReceive, now, delayed)){
+		// received datagrams are delayed by the impairment. add the delay to the timestamp
+		denMessage &message = delayed.datagram.message->Item();
+		message.SetTimestamp(message.GetTimestamp() + (delayed.due - delayed.queued));
+		
+		datagrams.push_back({delayed.datagram.message, delayed.datagram.address});
+		count++;
+	}
+	
+	return count;
+}
+
+void denSocketImpairment::FlushDatagrams(){
+	const denMessage::Timestamp now(pNow());
+	
+	try{
+		QueuedDatagrams::const_iterator iter;
+		for(iter = pSendQueue.cbegin(); iter != pSendQueue.cend(); iter++){
+			pImpair(pSend, *iter, now);
+		}
+		
+	}catch(...){
+		pSendQueue.clear();
+		throw;
+	}
+	
+	pSendQueue.clear();
+	pSendDue(now);
+}
+
+bool denSocketImpairment::WaitForDatagram(float timeout){
+	const denMessage::Timestamp start(denMessage::Clock::now());
+	
+	while(true){
+		const denMessage::Timestamp now(pNow());
+		pSendDue(now);
+		pPullReceived(now);
+		
+		if(!pReceive.delayed.empty() && pReceive.delayed.front().due <= now){
+			return true;
+		}
+		
+		// wait for the wrapped socket but wake up if delayed datagrams become due
+		float wait = -1.0f;
+		if(timeout >= 0.0f){
+			wait = timeout - std::chrono::duration<float>(denMessage::Clock::now() - start).count();
+			if(wait <= 0.0f){
+				return false;
+			}
+		}
+		
+		const float untilReceive = pTimeUntilDue(pReceive, now);
+		if(untilReceive >= 0.0f && (wait < 0.0f || untilReceive < wait)){
+			wait = untilReceive;
+		}
+		
+		const float untilSend = pTimeUntilDue(pSend, now);
+		if(untilSend >= 0.0f && (wait < 0.0f || untilSend < wait)){
+			wait = untilSend;
+		}
+		
+		pSocket->WaitForDatagram(wait);
+	}
+}
+
+bool denSocketImpairment::pDelayedLater(const Delayed &a, const Delayed &b){
+	return a.due > b.due || (a.due == b.due && a.sequence > b.sequence);
+}
+
+denMessage::Timestamp denSocketImpairment::pNow() const{
+	return pTimeSource ? pTimeSource() : denMessage::Clock::now();
+}
+
+float denSocketImpairment::pRandom(){
+	// use the generator output directly to produce the same values on all platforms
+	return (float)(pRandomGenerator() >> 8) * (1.0f / 16777216.0f);
+}
+
+void denSocketImpairment::pImpair(Direction &direction, const QueuedDatagram &datagram,
+const denMessage::Timestamp &now){
+	const Impairment &impairment = direction.impairment;
+	Statistics &statistics = direction.statistics;
+	statistics.datagrams++;
+	
+	// burst loss using a two state model. once a burst started datagrams are lost until
+	// the burst ends with a probability resulting in the average burst length
+	if(direction.inBurst){
+		if(pRandom() * std::max(impairment.burstLength, 1.0f) < 1.0f){
+			direction.inBurst = false;
+			
+		}else{
+			statistics.lost++;
+			return;
+		}
+	}
+	
+	if(impairment.burstLoss > 0.0f && pRandom() < impairment.burstLoss){
+		direction.inBurst = true;
+		statistics.lost++;
+		return;
+	}
+	
+	if(impairment.loss > 0.0f && pRandom() < impairment.loss){
+		statistics.lost++;
+		return;
+	}
+	
+	int copies = 1;
+	if(impairment.duplication > 0.0f && pRandom() < impairment.duplication){
+		statistics.duplicated++;
+		copies = 2;
+	}
+	
+	int i;
+	for(i=0; i<copies; i++){
+		float delay = impairment.latency;
+		if(impairment.jitter > 0.0f){
+			delay += pRandom() * impairment.jitter;
+		}
+		if(impairment.reorder > 0.0f && pRandom() < impairment.reorder){
+			delay += impairment.reorderDelay;
+			statistics.reordered++;
+		}
+		
+		denMessage::Timestamp due(now + std::chrono::duration_cast<denMessage::Clock::duration>(
+			std::chrono::duration<float>(delay)));
+		
+		if(impairment.bandwidth > 0){
+			// datagrams pass the link one after the other. datagrams waiting too long
+			// for the link to become free are dropped
+			const denMessage::Timestamp start(std::max(now, direction.linkFree));
+			if(std::chrono::duration<float>(start - now).count() > impairment.bandwidthQueueDelay){
+				statistics.bandwidthDropped++;
+				continue;
+			}
+			
+			direction.linkFree = start + std::chrono::duration_cast<denMessage::Clock::duration>(
+				std::chrono::duration<float>((float)datagram.GetLength() / (float)impairment.bandwidth));
+			due = direction.linkFree + (due - now);
+		}
+		
+		Delayed delayed;
+		delayed.due = due;
+		delayed.queued = now;
+		delayed.sequence = pNextSequence++;
+		delayed.datagram = datagram;
+		
+		if(i > 0 && &direction == &pReceive){
+			// received messages get their timestamp modified. duplicates need their own copy
+			const denMessage &source = datagram.message->Item();
+			delayed.datagram.message = denMessage::Pool().Get();
+			denMessage &copy = delayed.datagram.message->Item();
+			copy.SetLength(source.GetLength());
+			memcpy((char*)copy.GetData().c_str(), source.GetData().c_str(), source.GetLength());
+			copy.SetTimestamp(source.GetTimestamp());
+		}
+		
+		direction.delayed.push_back(delayed);
+		std::push_heap(direction.delayed.begin(), direction.delayed.end(), pDelayedLater);
+	}
+}
+
+void denSocketImpairment::pPullReceived(const denMessage::Timestamp &now){
+	pPulled.clear();
+	
+	while((int)pPulled.size() < vMaxPullCount){
+		if(pSocket->ReceiveDatagrams(pPulled, vMaxPullCount - (int)pPulled.size()) == 0){
+			break;
+		}
+	}
+	
+	pDroppedDatagramCount = pSocket->GetDroppedDatagramCount();
+	
+	QueuedDatagram datagram;
+	datagram.headerLength = 0;
+	datagram.offset = 0;
+	
+	Datagrams::const_iterator iter;
+	for(iter = pPulled.cbegin(); iter != pPulled.cend(); iter++){
+		datagram.message = iter->message;
+		datagram.length = iter->message->Item().GetLength();
+		datagram.address = iter->address;
+		pImpair(pReceive, datagram, now);
+	}
+	
+	pPulled.clear();
+}
+
+void denSocketImpairment::pSendDue(const denMessage::Timestamp &now){
+	Delayed delayed;
+	while(pPopDue(pSend, now, delayed)){
+		const QueuedDatagram &datagram = delayed.datagram;
+		pSocket->QueueDatagram(datagram.header, datagram.headerLength, datagram.message,
+			datagram.offset, datagram.length, datagram.address);
+	}
+	
+	if(pSocket->GetQueuedDatagramCount() > 0){
+		pSocket->FlushDatagrams();
+	}
+}
+
+bool denSocketImpairment::pPopDue(Direction &direction, const denMessage::Timestamp &now, Delayed &delayed){
+	if(direction.delayed.empty() || direction.delayed.front().due > now){
+		return false;
+	}
+	
+	std::pop_heap(direction.delayed.begin(), direction.delayed.end(), pDelayedLater);
+	delayed = std::move(direction.delayed.back());
+	direction.delayed.pop_back();
+	return true;
+}
+
+float denSocketImpairment::pTimeUntilDue(const Direction &direction, const denMessage::Timestamp &now) const{
+	if(direction.delayed.empty()){
+		return -1.0f;
+	}
+	return std::max(std::chrono::duration<float>(direction.delayed.front().due - now).count(), 0.0f);
+}
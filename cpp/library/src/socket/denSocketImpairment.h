@@ -0,0 +1,212 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <functional>
+#include <random>
+#include <vector>
+#include "denSocket.h"
+
+/**
+ * \brief Network impairment simulator socket.
+ * 
+ * Wraps another socket and impairs datagrams send and received through it. Simulates
+ * loss, burst loss, duplication, reordering, latency, jitter and bandwidth limits
+ * separately for both directions. Use it to test how connections perform on bad links.
+ * 
+ * Random decisions use a seeded generator. The same seed and the same datagram sequence
+ * produce the same impairments. Delays use denMessage::Clock unless a different time
+ * source is set. Delayed datagrams are send during FlushDatagrams(), ReceiveDatagrams()
+ * and WaitForDatagram() calls once they are due. Delayed send datagrams are send right
+ * away if the socket is destroyed.
+ * 
+ * To impair the datagrams of a connection or server overwrite CreateSocket() to wrap the
+ * socket created by the default implementation.
+ */
+class denSocketImpairment : public denSocket{
+public:
+	/** \brief Shared pointer. */
+	typedef std::shared_ptr<denSocketImpairment> Ref;
+	
+	/** \brief Time source. */
+	typedef std::function<denMessage::Timestamp()> TimeSource;
+	
+	/** \brief Impairment of one direction. */
+	struct Impairment{
+		/** \brief Probability in the range 0 to 1 for a datagram to be lost. */
+		float loss = 0.0f;
+		
+		/**
+		 * \brief Probability in the range 0 to 1 for a burst loss to start.
+		 * 
+		 * During a burst loss all datagrams are lost.
+		 */
+		float burstLoss = 0.0f;
+		
+		/** \brief Average count of datagrams lost in a burst loss. */
+		float burstLength = 5.0f;
+		
+		/** \brief Probability in the range 0 to 1 for a datagram to be duplicated. */
+		float duplication = 0.0f;
+		
+		/** \brief Probability in the range 0 to 1 for a datagram to be reordered. */
+		float reorder = 0.0f;
+		
+		/** \brief Additional delay in seconds of reordered datagrams. */
+		float reorderDelay = 0.05f;
+		
+		/** \brief Latency in seconds. */
+		float latency = 0.0f;
+		
+		/** \brief Maximum random additional latency in seconds. */
+		float jitter = 0.0f;
+		
+		/** \brief Bandwidth in bytes per second or 0 for unlimited bandwidth. */
+		int bandwidth = 0;
+		
+		/**
+		 * \brief Maximum delay in seconds datagrams wait due to the bandwidth limit.
+		 * 
+		 * Datagrams waiting longer are dropped like a link with a full buffer does.
+		 */
+		float bandwidthQueueDelay = 0.5f;
+	};
+	
+	/** \brief Statistics of one direction. */
+	struct Statistics{
+		/** \brief Count of datagrams passing the impairment. */
+		uint64_t datagrams = 0;
+		
+		/** \brief Count of lost datagrams including burst loss. */
+		uint64_t lost = 0;
+		
+		/** \brief Count of datagrams lost due to the bandwidth limit. */
+		uint64_t bandwidthDropped = 0;
+		
+		/** \brief Count of duplicated datagrams. */
+		uint64_t duplicated = 0;
+		
+		/** \brief Count of reordered datagrams. */
+		uint64_t reordered = 0;
+	};
+	
+	/** \brief Create impairment socket wrapping socket. */
+	denSocketImpairment(const denSocket::Ref &socket);
+	
+	/** \brief Clean up socket. */
+	virtual ~denSocketImpairment() noexcept;
+	
+	/** \brief Wrapped socket. */
+	inline const denSocket::Ref &GetSocket() const{ return pSocket; }
+	
+	/** \brief Impairment of send datagrams. */
+	inline const Impairment &GetSendImpairment() const{ return pSend.impairment; }
+	
+	/** \brief Set impairment of send datagrams. */
+	void SetSendImpairment(const Impairment &impairment);
+	
+	/** \brief Impairment of received datagrams. */
+	inline const Impairment &GetReceiveImpairment() const{ return pReceive.impairment; }
+	
+	/** \brief Set impairment of received datagrams. */
+	void SetReceiveImpairment(const Impairment &impairment);
+	
+	/** \brief Statistics of send datagrams. */
+	inline const Statistics &GetSendStatistics() const{ return pSend.statistics; }
+	
+	/** \brief Statistics of received datagrams. */
+	inline const Statistics &GetReceiveStatistics() const{ return pReceive.statistics; }
+	
+	/** \brief Seed random generator. */
+	void SetSeed(uint32_t seed);
+	
+	/**
+	 * \brief Set time source.
+	 * 
+	 * Allows running impairments in simulated time. Set to nullptr to use
+	 * denMessage::Clock.
+	 */
+	void SetTimeSource(const TimeSource &timeSource);
+	
+	/** \brief Bind wrapped socket to stored address. */
+	virtual void Bind();
+	
+	/** \brief Connect wrapped socket to remote address. */
+	virtual void Connect(const denSocketAddress &address);
+	
+	/** \brief Attach reuse port steering to wrapped socket. */
+	virtual bool AttachReusePortSteering(int socketCount);
+	
+	/** \brief Receive datagram from socket. */
+	virtual denMessage::Ref ReceiveDatagram(denSocketAddress &address);
+	
+	/** \brief Send datagram. */
+	virtual void SendDatagram(const denMessage &message, const denSocketAddress &address);
+	
+	/** \brief Receive up to maxCount datagrams due for delivery. */
+	virtual int ReceiveDatagrams(Datagrams &datagrams, int maxCount);
+	
+	/** \brief Impair queued datagrams and send datagrams due for sending. */
+	virtual void FlushDatagrams();
+	
+	/** \brief Wait until received datagrams are due or timeout elapsed. */
+	virtual bool WaitForDatagram(float timeout);
+	
+private:
+	/** \brief Delayed datagram. */
+	struct Delayed{
+		denMessage::Timestamp due;
+		denMessage::Timestamp queued;
+		uint64_t sequence;
+		QueuedDatagram datagram;
+	};
+	
+
+	/** \brief Impairment state of one direction. */
+	struct Direction{
+		Impairment impairment;
+		Statistics statistics;
+		bool inBurst = false;
+		denMessage::Timestamp linkFree;
+		std::vector<Delayed> delayed;
+	};
+	
+	static bool pDelayedLater(const Delayed &a, const Delayed &b);
+	denMessage::Timestamp pNow() const;
+	float pRandom();
+	void pImpair(Direction &direction, const QueuedDatagram &datagram, const denMessage::Timestamp &now);
+	void pPullReceived(const denMessage::Timestamp &now);
+	void pSendDue(const denMessage::Timestamp &now);
+	bool pPopDue(Direction &direction, const denMessage::Timestamp &now, Delayed &delayed);
+	float pTimeUntilDue(const Direction &direction, const denMessage::Timestamp &now) const;
+	
+	const denSocket::Ref pSocket;
+	Direction pSend;
+	Direction pReceive;
+	std::mt19937 pRandomGenerator;
+	TimeSource pTimeSource;
+	uint64_t pNextSequence;
+	Datagrams pPulled;
+};
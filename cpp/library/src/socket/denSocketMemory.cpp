@@ -0,0 +1,481 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "denSocketMemory.h"
+
+// first port assigned to sockets binding to port 0
+static const int vFirstFreePort = 49152;
+
+/**
+ * \brief Bounded lock-free multiple producer single consumer datagram queue.
+ */
+class denSocketMemory::Queue{
+public:
+	/** \brief Count of datagrams dropped because the queue has been full. */
+	std::atomic<uint64_t> dropped;
+	
+	Queue(int capacity) :
+	dropped(0),
+	pCells(new Cell[capacity]),
+	pMask((size_t)capacity - 1),
+	pEnqueuePosition(0),
+	pDequeuePosition(0),
+	pWaiting(false){
+		size_t i;
+		for(i=0; i<=pMask; i++){
+			pCells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+	
+	/** \brief Add datagram. Returns false if the queue is full. */
+	bool Push(Datagram &&datagram){
+		size_t position = pEnqueuePosition.load(std::memory_order_relaxed);
+		
+		while(true){
+			Cell &cell = pCells[position & pMask];
+			const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			const intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+			
+			if(difference == 0){
+				if(pEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)){
+					cell.datagram = std::move(datagram);
+					cell.sequence.store(position + 1, std::memory_order_release);
+					break;
+				}
+				
+			}else if(difference < 0){
+				return false;
+				
+			}else{
+				position = pEnqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+		
+		// wake up the consumer only if it is waiting. the fence pairs with the one in
+		// Wait() ensuring either the consumer sees the datagram or we see it waiting
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(pWaiting.load(std::memory_order_relaxed)){
+			const std::lock_guard<std::mutex> guard(pMutex);
+			pCondition.notify_one();
+		}
+		return true;
+	}
+	
+	/** \brief Remove datagram. Only one thread is allowed to call this. */
+	bool Pop(Datagram &datagram){
+		const size_t position = pDequeuePosition.load(std::memory_order_relaxed);
+		Cell &cell = pCells[position & pMask];
+		if(cell.sequence.load(std::memory_order_acquire) != position + 1){
+			return false;
+		}
+		
+		datagram = std::move(cell.datagram);
+		cell.datagram.message.reset();
+		cell.sequence.store(position + pMask + 1, std::memory_order_release);
+		pDequeuePosition.store(position + 1, std::memory_order_relaxed);
+		return true;
+	}
+	
+	/** \brief Queue is empty. */
+	bool IsEmpty() const{
+		const size_t position = pDequeuePosition.load(std::memory_order_relaxed);
+		return pCells[position & pMask].sequence.load(std::memory_order_acquire) != position + 1;
+	}
+	
+	/** \brief Wait until datagrams are pending or timeout elapsed. */
+	bool Wait(float timeout){
+		if(!IsEmpty()){
+			return true;
+		}
+		if(timeout == 0.0f){
+			return false;
+		}
+		
+		std::unique_lock<std::mutex> lock(pMutex);
+		pWaiting.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		
+		const auto pending = [&]{ return !IsEmpty(); };
+		bool result = true;
+		
+		if(timeout < 0.0f){
+			pCondition.wait(lock, pending);
+			
+		}else{
+			result = pCondition.wait_for(lock, std::chrono::duration<float>(timeout), pending);
+		}
+		
+		pWaiting.store(false, std::memory_order_relaxed);
+		return result;
+	}
+	
+private:
+	struct Cell{
+		std::atomic<size_t> sequence;
+		Datagram datagram;
+	};
+	
+	std::unique_ptr<Cell[]> pCells;
+	const size_t pMask;
+	alignas(64) std::atomic<size_t> pEnqueuePosition;
+	alignas(64) std::atomic<size_t> pDequeuePosition;
+	std::atomic<bool> pWaiting;
+	std::mutex pMutex;
+	std::condition_variable pCondition;
+};
+
+/**
+ * \brief Sockets bound to a port.
+ * 
+ * Replaced as a whole if sockets bind or unbind. Senders can keep a weak reference
+ * which expires if the bound sockets change.
+ */
+struct denSocketMemory::Port{
+	std::vector<std::shared_ptr<Queue>> queues;
+	std::unordered_map<uint16_t, std::shared_ptr<Queue>> connected;
+	bool reusePort;
+};
+
+
+std::mutex denSocketMemory::pMutexPorts;
+std::unordered_map<uint16_t, std::shared_ptr<const denSocketMemory::Port>> denSocketMemory::pBoundPorts;
+int denSocketMemory::pNextFreePort = 0;
+
+denSocketMemory::denSocketMemory() :
+pQueueCapacity(4096){
+}
+
+denSocketMemory::~denSocketMemory() noexcept{
+	try{
+		pUnbind();
+		
+	}catch(...){
+	}
+}
+
+void denSocketMemory::SetQueueCapacity(int capacity){
+	if(pQueue){
+		throw std::runtime_error("socket already bound");
+	}
+	if(capacity < 1){
+		throw std::invalid_argument("capacity < 1");
+	}
+	
+	pQueueCapacity = 1;
+	while(pQueueCapacity < capacity){
+		pQueueCapacity <<= 1;
+	}
+}
+
+void denSocketMemory::Bind(){
+	if(pQueue){
+		throw std::runtime_error("socket already bound");
+	}
+	if(pAddress.type != denSocketAddress::Type::memory){
+		throw std::invalid_argument("bind failed: not a memory address");
+	}
+	
+	const std::shared_ptr<Queue> queue(std::make_shared<Queue>(pQueueCapacity));
+	const std::lock_guard<std::mutex> guard(pMutexPorts);
+	
+	int port = pAddress.port;
+	if(port == 0){
+		const int count = 65536 - vFirstFreePort;
+		int i;
+		for(i=0; i<count; i++){
+			const int candidate = vFirstFreePort + (pNextFreePort + i) % count;
+			if(pBoundPorts.find((uint16_t)candidate) == pBoundPorts.cend()){
+				port = candidate;
+				pNextFreePort = (pNextFreePort + i + 1) % count;
+				break;
+			}
+		}
+		
+		if(port == 0){
+			throw std::runtime_error("bind failed: no free port");
+		}
+	}
+	
+	const std::shared_ptr<Port> bound(std::make_shared<Port>());
+	
+	const auto iter = pBoundPorts.find((uint16_t)port);
+	if(iter != pBoundPorts.cend()){
+		if(!pReusePort || !iter->second->reusePort){
+			throw std::runtime_error("bind failed: address in use");
+		}
+		bound->queues = iter->second->queues;
+		bound->connected = iter->second->connected;
+	}
+	
+	bound->queues.push_back(queue);
+	bound->reusePort = pReusePort;
+	pBoundPorts[(uint16_t)port] = bound;
+	
+	pQueue = queue;
+	pAddress = denSocketAddress::Memory((uint16_t)port);
+}
+
+void denSocketMemory::Connect(const denSocketAddress &address){
+	if(!pQueue){
+		throw std::runtime_error("socket not bound");
+	}
+	if(address.type != denSocketAddress::Type::memory){
+		throw std::invalid_argument("connect failed: not a memory address");
+	}
+	
+	{
+	const std::lock_guard<std::mutex> guard(pMutexPorts);
+	
+	const auto iter = pBoundPorts.find(pAddress.port);
+	const std::shared_ptr<Port> bound(std::make_shared<Port>(*iter->second));
+	
+	const auto iterConnected = bound->connected.find(address.port);
+	if(iterConnected != bound->connected.cend() && iterConnected->second != pQueue){
+		throw std::runtime_error("connect failed: address in use");
+	}
+	
+	const auto iterQueue = std::find(bound->queues.begin(), bound->queues.end(), pQueue);
+	if(iterQueue != bound->queues.end()){
+		bound->queues.erase(iterQueue);
+	}
+	if(pConnected){
+		bound->connected.erase(pRemoteAddress.port);
+	}
+	bound->connected[address.port] = pQueue;
+	
+	iter->second = bound;
+	}
+	
+	// datagrams received before connecting can be from any address. drop them like
+	// lost datagrams since received datagrams are now assumed to be from the remote
+	Datagram datagram;
+	while(pQueue->Pop(datagram)){
+	}
+	
+	denSocket::Connect(address);
+}
+
+denMessage::Ref denSocketMemory::ReceiveDatagram(denSocketAddress &address){
+	if(!pQueue){
+		return nullptr;
+	}
+	
+	Datagram datagram;
+	if(!pQueue->Pop(datagram)){
+		return nullptr;
+	}
+	
+	pDroppedDatagramCount = pQueue->dropped.load(std::memory_order_relaxed);
+	address = datagram.address;
+	return datagram.message;
+}
+
+void denSocketMemory::SendDatagram(const denMessage &message, const denSocketAddress &address){
+	if(!pQueue){
+		throw std::runtime_error("socket not bound");
+	}
+	
+	pDeliver(address, nullptr, 0, (const uint8_t*)message.GetData().c_str(),
+		message.GetLength(), denMessage::Clock::now());
+}
+
+int denSocketMemory::ReceiveDatagrams(Datagrams &datagrams, int maxCount){
+	if(!pQueue){
+		return 0;
+	}
+	
+	Datagram datagram;
+	int count = 0;
+	
+	while(count < maxCount && pQueue->Pop(datagram)){
+		datagrams.push_back(std::move(datagram));
+		count++;
+	}
+	
+	pDroppedDatagramCount = pQueue->dropped.load(std::memory_order_relaxed);
+	return count;
+}
+
+void denSocketMemory::FlushDatagrams(){
+	if(pSendQueue.empty()){
+		return;
+	}
+	
+	try{
+		if(!pQueue){
+			throw std::runtime_error("socket not bound");
+		}
+		
+		const denMessage::Timestamp timestamp(denMessage::Clock::now());
+		
+		QueuedDatagrams::const_iterator iter;
+		for(iter = pSendQueue.cbegin(); iter != pSendQueue.cend(); iter++){
+			pDeliver(iter->address, iter->header, iter->headerLength,
+				iter->GetPayload(), iter->length, timestamp);
+		}
+		
+	}catch(...){
+		pSendQueue.clear();
+		throw;
+	}
+	
+	pSendQueue.clear();
+}
+
+bool denSocketMemory::WaitForDatagram(float timeout){
+	return pQueue && pQueue->Wait(timeout);
+}
+
+bool denSocketMemory::IsMemoryAddress(const std::string &address){
+	return address.compare(0, 6, "memory") == 0 && (address.size() == 6 || address[6] == ':');
+}
+
+denSocketAddress denSocketMemory::ResolveAddress(const std::string &address){
+	if(!IsMemoryAddress(address)){
+		throw std::invalid_argument("not a memory address");
+	}
+	
+	if(address.size() <= 7){
+		return denSocketAddress::Memory();
+	}
+	
+	const std::string port(address.substr(7));
+	if(port.find_first_not_of("0123456789") != std::string::npos || port.size() > 5){
+		throw std::invalid_argument("invalid memory address port");
+	}
+	
+	const int value = std::stoi(port);
+	if(value > 65535){
+		throw std::invalid_argument("invalid memory address port");
+	}
+	
+	return denSocketAddress::Memory((uint16_t)value);
+}
+
+std::shared_ptr<const denSocketMemory::Port> denSocketMemory::pFindPort(uint16_t port){
+	const auto iter = pPorts.find(port);
+	if(iter != pPorts.cend()){
+		const std::shared_ptr<const Port> found(iter->second.lock());
+		if(found){
+			return found;
+		}
+		pPorts.erase(iter);
+	}
+	
+	// bound sockets changed or first datagram send to this port
+	std::shared_ptr<const Port> found;
+	{
+	const std::lock_guard<std::mutex> guard(pMutexPorts);
+	const auto iterBound = pBoundPorts.find(port);
+	if(iterBound == pBoundPorts.cend()){
+		return nullptr;
+	}
+	found = iterBound->second;
+	}
+	
+	pPorts[port] = found;
+	return found;
+}
+
+void denSocketMemory::pDeliver(const denSocketAddress &address, const uint8_t *header,
+int headerLength, const uint8_t *payload, size_t length, const denMessage::Timestamp &timestamp){
+	if(address.type != denSocketAddress::Type::memory){
+		return;
+	}
+	
+	const std::shared_ptr<const Port> port(pFindPort(address.port));
+	if(!port){
+		return; // no socket bound to address. dropped like UDP does
+	}
+	
+	// sockets connected to the sending socket receive its datagrams. other sockets
+	// sharing a port receive datagrams by the port of the sending socket
+	Queue *found = nullptr;
+	if(!port->connected.empty()){
+		const auto iter = port->connected.find(pAddress.port);
+		if(iter != port->connected.cend()){
+			found = iter->second.get();
+		}
+	}
+	
+	if(!found){
+		const size_t queueCount = port->queues.size();
+		if(queueCount == 0){
+			return; // only connected sockets bound. dropped like UDP does
+		}
+		found = port->queues[queueCount > 1 ? pAddress.port % queueCount : 0].get();
+	}
+	
+	Queue &queue = *found;
+	
+	const denMessage::Ref message(denMessage::Pool().Get());
+	message->Item().SetLength((size_t)headerLength + length);
+	uint8_t * const data = (uint8_t*)message->Item().GetData().c_str();
+	if(headerLength > 0){
+		memcpy(data, header, headerLength);
+	}
+	if(length > 0){
+		memcpy(data + headerLength, payload, length);
+	}
+	message->Item().SetTimestamp(timestamp);
+	
+	if(!queue.Push({message, pAddress})){
+		queue.dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void denSocketMemory::pUnbind(){
+	if(!pQueue){
+		return;
+	}
+	
+	const std::lock_guard<std::mutex> guard(pMutexPorts);
+	
+	const auto iter = pBoundPorts.find(pAddress.port);
+	if(iter != pBoundPorts.cend()){
+		const std::shared_ptr<Port> bound(std::make_shared<Port>(*iter->second));
+		if(pConnected){
+			bound->connected.erase(pRemoteAddress.port);
+			
+		}else{
+			bound->queues.erase(std::find(bound->queues.begin(), bound->queues.end(), pQueue));
+		}
+		
+		if(bound->queues.empty() && bound->connected.empty()){
+			pBoundPorts.erase(iter);
+			
+		}else{
+			iter->second = bound;
+		}
+	}
+	
+	pQueue.reset();
+}
@@ -0,0 +1,126 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "denSocket.h"
+
+/**
+ * \brief In-process memory transport socket.
+ * 
+ * Moves datagrams between sockets in the same process without touching the kernel.
+ * Sockets bind to memory addresses created using denSocketAddress::Memory() or
+ * resolved from strings in the form "memory:port". Use this socket to benchmark the
+ * protocol engine in isolation or to run large scale tests with many connections.
+ * 
+ * Each socket has a bounded lock-free queue receiving datagrams from any number of
+ * sending sockets. Datagrams sent to a full queue or to an address no socket is bound
+ * to are dropped like UDP does. Datagrams are copied into new messages while sending.
+ * Each socket has to be used by one thread at a time.
+ */
+class denSocketMemory : public denSocket{
+public:
+	/** \brief Shared pointer. */
+	typedef std::shared_ptr<denSocketMemory> Ref;
+	
+	/** \brief Create socket. */
+	denSocketMemory();
+	
+	/** \brief Clean up socket. */
+	virtual ~denSocketMemory() noexcept;
+	
+	/** \brief Capacity of receive queue in datagrams. */
+	inline int GetQueueCapacity() const{ return pQueueCapacity; }
+	
+	/**
+	 * \brief Set capacity of receive queue in datagrams.
+	 * 
+	 * Rounded up to the next power of two. Has to be set before Bind().
+	 */
+	void SetQueueCapacity(int capacity);
+	
+	/**
+	 * \brief Bind socket to stored address.
+	 * 
+	 * Address has to be a memory address. Port 0 binds to a free port. Multiple sockets
+	 * can bind to the same port if all have reuse port enabled. Datagrams are then
+	 * distributed by the port of the sending socket.
+	 */
+	virtual void Bind();
+	
+	/**
+	 * \brief Connect socket to remote address.
+	 * 
+	 * The socket receives only datagrams send from the remote address. Datagrams send
+	 * from the remote address to the bound port are delivered to this socket even if
+	 * other sockets share the port.
+	 */
+	virtual void Connect(const denSocketAddress &address);
+	
+	/** \brief Receive datagram from socket. */
+	virtual denMessage::Ref ReceiveDatagram(denSocketAddress &address);
+	
+	/** \brief Send datagram. */
+	virtual void SendDatagram(const denMessage &message, const denSocketAddress &address);
+	
+	/** \brief Receive up to maxCount datagrams from receive queue. */
+	virtual int ReceiveDatagrams(Datagrams &datagrams, int maxCount);
+	
+	/** \brief Send all queued datagrams to the receive queues of the target sockets. */
+	virtual void FlushDatagrams();
+	
+	/** \brief Wait until datagrams are pending or timeout elapsed. */
+	virtual bool WaitForDatagram(float timeout);
+	
+	/** \brief String is a memory address. */
+	static bool IsMemoryAddress(const std::string &address);
+	
+	/**
+	 * \brief Resolve memory address.
+	 * 
+	 * Address has the form "memory:port" or "memory" using the default port 3413.
+	 */
+	static denSocketAddress ResolveAddress(const std::string &address);
+	
+private:
+	class Queue;
+	struct Port;
+	
+	std::shared_ptr<const Port> pFindPort(uint16_t port);
+	void pDeliver(const denSocketAddress &address, const uint8_t *header, int headerLength,
+		const uint8_t *payload, size_t length, const denMessage::Timestamp &timestamp);
+	void pUnbind();
+	
+	int pQueueCapacity;
+	std::shared_ptr<Queue> pQueue;
+	std::unordered_map<uint16_t, std::weak_ptr<const Port>> pPorts;
+	
+	static std::mutex pMutexPorts;
+	static std::unordered_map<uint16_t, std::shared_ptr<const Port>> pBoundPorts;
+	static int pNextFreePort;
+};
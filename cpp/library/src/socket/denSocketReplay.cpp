@@ -0,0 +1,184 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include "denSocketReplay.h"
+
+denSocketReplay::denSocketReplay(const denCaptureReader::Ref &reader) :
+pReader(reader),
+pStream(-1),
+pStarted(false),
+pFinished(false),
+pFirstTimestamp(0),
+pReplayedCount(0),
+pDiscardedCount(0){
+	if(!reader){
+		throw std::invalid_argument("reader is nullptr");
+	}
+}
+
+denSocketReplay::~denSocketReplay() noexcept{
+}
+
+void denSocketReplay::SetStream(int stream){
+	if(stream < -1){
+		throw std::invalid_argument("stream < -1");
+	}
+	pStream = stream;
+}
+
+void denSocketReplay::SetTimeSource(const TimeSource &timeSource){
+	pTimeSource = timeSource;
+}
+
+void denSocketReplay::Bind(){
+	pStart();
+}
+
+denMessage::Ref denSocketReplay::ReceiveDatagram(denSocketAddress &address){
+	Datagrams datagrams;
+	if(ReceiveDatagrams(datagrams, 1) == 0){
+		return nullptr;
+	}
+	
+	address = datagrams.front().address;
+	return datagrams.front().message;
+}
+
+void denSocketReplay::SendDatagram(const denMessage &, const denSocketAddress &){
+	pDiscardedCount++;
+}
+
+int denSocketReplay::ReceiveDatagrams(Datagrams &datagrams, int maxCount){
+	pStart();
+	
+	const denMessage::Timestamp now(pNow());
+	int count = 0;
+	
+	while(count < maxCount && !pFinished && pNextDue <= now){
+		const denMessage::Ref message(denMessage::Pool().Get());
+		denMessage &data = message->Item();
+		data.SetLength(pNext.data.size());
+		if(!pNext.data.empty()){
+			memcpy((char*)data.GetData().c_str(), pNext.data.data(), pNext.data.size());
+		}
+		data.SetTimestamp(pNextDue);
+		
+		datagrams.push_back({message, pNext.address});
+		pReplayedCount++;
+		count++;
+		
+		pReadNext();
+	}
+	
+	return count;
+}
+
+void denSocketReplay::FlushDatagrams(){
+	pDiscardedCount += pSendQueue.size();
+	pSendQueue.clear();
+}
+
+bool denSocketReplay::WaitForDatagram(float timeout){
+	pStart();
+	
+	const denMessage::Timestamp now(pNow());
+	if(!pFinished && pNextDue <= now){
+		return true;
+	}
+	if(pTimeSource){
+		return false;
+	}
+	
+	denMessage::Timestamp until(denMessage::Timestamp::max());
+	if(timeout >= 0.0f){
+		until = now + std::chrono::duration_cast<denMessage::Clock::duration>(
+			std::chrono::duration<float>(timeout));
+	}
+	
+	if(!pFinished && pNextDue < until){
+		std::this_thread::sleep_until(pNextDue);
+		return true;
+	}
+	
+	if(until == denMessage::Timestamp::max()){
+		// nothing left to replay. do not block forever
+		return false;
+	}
+	
+	std::this_thread::sleep_until(until);
+	return false;
+}
+
+denMessage::Timestamp denSocketReplay::pNow() const{
+	return pTimeSource ? pTimeSource() : denMessage::Clock::now();
+}
+
+void denSocketReplay::pStart(){
+	if(pStarted){
+		return;
+	}
+	
+	pStarted = true;
+	pStartTime = pNow();
+	
+	// the replay starts at the first record of the stream. find it including send
+	// records to keep the delay until the first received datagram
+	denCaptureReader::Record record;
+	while(true){
+		if(!pReader->Read(record)){
+			pFinished = true;
+			return;
+		}
+		if(pStream == -1 || record.stream == pStream){
+			break;
+		}
+	}
+	pFirstTimestamp = record.timestamp;
+	
+	if(record.direction == denCaptureWriter::Direction::received){
+		pNext = std::move(record);
+		pNextDue = pStartTime;
+		
+	}else{
+		pReadNext();
+	}
+}
+
+void denSocketReplay::pReadNext(){
+	while(pReader->Read(pNext)){
+		if(pNext.direction != denCaptureWriter::Direction::received
+		|| (pStream != -1 && pNext.stream != pStream)){
+			continue;
+		}
+		
+		pNextDue = pStartTime + std::chrono::duration_cast<denMessage::Clock::duration>(
+			pNext.timestamp - pFirstTimestamp);
+		return;
+	}
+	
+	pFinished = true;
+}
@@ -0,0 +1,126 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <functional>
+#include "denSocket.h"
+#include "denCaptureReader.h"
+
+/**
+ * \brief Capture replay socket.
+ * 
+ * Replays datagrams received in a capture file recorded with denSocketCapture. Received
+ * datagrams are delivered with the same timing as they have been captured relative to
+ * the time the socket is bound. Send datagrams are discarded. Use the socket to feed a
+ * capture back into a server or connection by overwriting CreateSocket(). The recorded
+ * send datagrams are ignored since the replayed server or connection sends its own.
+ * 
+ * Delivery uses denMessage::Clock unless a different time source is set. Use
+ * denCaptureReplay to run replays with simulated time.
+ */
+class denSocketReplay : public denSocket{
+public:
+	/** \brief Shared pointer. */
+	typedef std::shared_ptr<denSocketReplay> Ref;
+	
+	/** \brief Time source. */
+	typedef std::function<denMessage::Timestamp()> TimeSource;
+	
+	/** \brief Create replay socket reading capture from reader. */
+	denSocketReplay(const denCaptureReader::Ref &reader);
+	
+	/** \brief Clean up socket. */
+	virtual ~denSocketReplay() noexcept;
+	
+	/** \brief Capture reader. */
+	inline const denCaptureReader::Ref &GetReader() const{ return pReader; }
+	
+	/** \brief Stream number to replay or -1 to replay all streams. */
+	inline int GetStream() const{ return pStream; }
+	
+	/**
+	 * \brief Set stream number to replay or -1 to replay all streams.
+	 * 
+	 * Has to be set before Bind(). Use to replay the datagrams of one socket of a capture
+	 * shared by multiple sockets.
+	 */
+	void SetStream(int stream);
+	
+	/**
+	 * \brief Set time source.
+	 * 
+	 * Allows replaying in simulated time. Set to nullptr to use denMessage::Clock.
+	 */
+	void SetTimeSource(const TimeSource &timeSource);
+	
+	/** \brief All captured datagrams have been delivered. */
+	inline bool IsFinished() const{ return pFinished; }
+	
+	/** \brief Count of delivered datagrams. */
+	inline uint64_t GetReplayedCount() const{ return pReplayedCount; }
+	
+	/** \brief Count of discarded send datagrams. */
+	inline uint64_t GetDiscardedCount() const{ return pDiscardedCount; }
+	
+	/** \brief Bind socket starting the replay. */
+	virtual void Bind();
+	
+	/** \brief Receive datagram due for delivery. */
+	virtual denMessage::Ref ReceiveDatagram(denSocketAddress &address);
+	
+	/** \brief Discard datagram. */
+	virtual void SendDatagram(const denMessage &message, const denSocketAddress &address);
+	
+	/** \brief Receive up to maxCount datagrams due for delivery. */
+	virtual int ReceiveDatagrams(Datagrams &datagrams, int maxCount);
+	
+	/** \brief Discard all queued datagrams. */
+	virtual void FlushDatagrams();
+	
+	/**
+	 * \brief Wait until datagrams are due or timeout elapsed.
+	 * 
+	 * With a time source set returns immediately since simulated time does not advance
+	 * while waiting.
+	 */
+	virtual bool WaitForDatagram(float timeout);
+	
+private:
+	denMessage::Timestamp pNow() const;
+	void pStart();
+	void pReadNext();
+	
+	const denCaptureReader::Ref pReader;
+	int pStream;
+	TimeSource pTimeSource;
+	bool pStarted;
+	bool pFinished;
+	denMessage::Timestamp pStartTime;
+	std::chrono::nanoseconds pFirstTimestamp;
+	denCaptureReader::Record pNext;
+	denMessage::Timestamp pNextDue;
+	uint64_t pReplayedCount;
+	uint64_t pDiscardedCount;
+};
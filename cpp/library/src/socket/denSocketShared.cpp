@@ -23,12 +23,25 @@
  */
 
 #include "denSocket.h"
+#include "denSocketShared.h"
+#include "denSocketMemory.h"
 #include "denSocketUnix.h"
+#include "denSocketUring.h"
 #include "denSocketWindows.h"
 
 namespace denSocketShared{
 
-denSocket::Ref CreateSocket(){
+denSocket::Ref CreateSocket(Backend backend){
+	if(backend == Backend::memory){
+		return std::make_shared<denSocketMemory>();
+	}
+	
+#ifdef DEN_WITH_IO_URING
+	if(backend == Backend::uring && denSocketUring::IsSupported()){
+		return std::make_shared<denSocketUring>();
+	}
+#endif
+	
 #if defined OS_UNIX || defined OS_BEOS
 	return std::make_shared<denSocketUnix>();
 #elif defined OS_W32
@@ -39,6 +52,10 @@ denSocket::Ref CreateSocket(){
 }
 
 denSocketAddress ResolveAddress(const std::string &address){
+	if(denSocketMemory::IsMemoryAddress(address)){
+		return denSocketMemory::ResolveAddress(address);
+	}
+	
 #if defined OS_UNIX || defined OS_BEOS
 	return denSocketUnix::ResolveAddress(address);
 #elif defined OS_W32
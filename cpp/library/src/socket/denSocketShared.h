@@ -29,10 +29,31 @@
 #include "denSocket.h"
 
 namespace denSocketShared{
+	/** \brief Socket backend. */
+	enum class Backend{
+		/** \brief Platform specific socket implementation. */
+		platform,
+		
+		/**
+		 * \brief Linux io_uring socket implementation.
+		 * 
+		 * Falls back to platform if io_uring is not supported.
+		 */
+		uring,
+		
+		/** \brief In-process memory transport not using the kernel. */
+		memory
+	};
+	
 	/** \brief Create platform specific socket implementation. */
-	denSocket::Ref CreateSocket();
+	denSocket::Ref CreateSocket(Backend backend = Backend::platform);
 	
-	/** \brief Resolve address. */
+	/**
+	 * \brief Resolve address.
+	 * 
+	 * Addresses in the form "memory:port" resolve to in-process memory transport
+	 * addresses. Sockets bound to them have to be created using Backend::memory.
+	 */
 	denSocketAddress ResolveAddress(const std::string &address);
 	
 	/** \brief Find public addresses. */
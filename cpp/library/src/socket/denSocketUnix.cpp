@@ -32,6 +32,8 @@
 #include <stdexcept>
 #include <memory.h>
 #include <errno.h>
+#include <algorithm>
+#include <cmath>
 
 #include <netdb.h>
 #include <arpa/inet.h>
@@ -47,6 +49,28 @@
 #include <sys/sockio.h>
 #endif
 
+#ifdef OS_UNIX
+#include <sys/epoll.h>
+#include <linux/filter.h>
+#include <netinet/udp.h>
+#endif
+
+#ifdef OS_UNIX
+// limits of the kernel for segmentation offload. segments plus headers have to fit into
+// the device MTU. the maximum segment size assumes an ethernet MTU for IPv6
+static const size_t vMaxSegmentSize = 1452;
+static const size_t vMaxSegmentedLength = 65000;
+static const int vMaxSegments = 64;
+
+// received datagrams up to this length are copied into right sized messages. only larger
+// datagrams hand out the maximum size receive buffer to the application
+static const size_t vReceiveCopyLength = 2048;
+
+// maximum size receive buffers shared by all sockets receiving on this thread. keeps the
+// memory cost at one batch per thread instead of one batch per socket
+static thread_local std::vector<denMessage::Ref> vReceiveBuffers;
+#endif
+
 #include "denSocketUnix.h"
 #include "../denConnection.h"
 #include "../denServer.h"
@@ -54,11 +78,27 @@
 denSocketUnix::denSocketUnix() :
 pSocket(-1),
 pBufferLen(65535)
+#ifdef OS_UNIX
+,pReceiveOffload(false),
+pReceiveTimestamps(false),
+pReceiveDropCounter(false),
+pLastDropCounter(0),
+pEpoll(-1),
+#ifdef UDP_SEGMENT
+pSegmentationOffload(true)
+#else
+pSegmentationOffload(false)
+#endif
+#endif
 {
-	pBuffer.assign(pBufferLen, 0);
 }
 
 denSocketUnix::~denSocketUnix() noexcept{
+#ifdef OS_UNIX
+	if(pEpoll != -1){
+		close(pEpoll);
+	}
+#endif
 	if(pSocket != -1){
 		close(pSocket);
 	}
@@ -78,6 +118,9 @@ void denSocketUnix::Bind(){
 			throw std::runtime_error(s.str());
 		}
 		
+		pApplyReusePort();
+		pApplyBufferSizes();
+		
 		struct sockaddr_in6 sa;
 		memset(&sa, 0, sizeof(sa));
 		SocketFromAddress(pAddress, sa);
@@ -109,6 +152,9 @@ void denSocketUnix::Bind(){
 			throw std::runtime_error(s.str());
 		}
 		
+		pApplyReusePort();
+		pApplyBufferSizes();
+		
 		struct sockaddr_in sa;
 		memset(&sa, 0, sizeof(sa));
 		SocketFromAddress(pAddress, sa);
@@ -129,61 +175,93 @@ void denSocketUnix::Bind(){
 		}
 		pAddress = AddressFromSocket(sa);
 	}
+	
+#ifdef OS_UNIX
+	pApplyReceiveOffload();
+	pApplyReceiveTimestamps();
+	pApplyDropCounter();
+#endif
+}
+
+#ifdef OS_UNIX
+void denSocketUnix::SetReceiveOffload(bool enable){
+	if(pSocket != -1){
+		throw std::runtime_error("socket already bound");
+	}
+	pReceiveOffload = enable;
 }
+#endif
 
 denMessage::Ref denSocketUnix::ReceiveDatagram(denSocketAddress &address){
+#ifdef OS_UNIX
+	if(pReceiveOffload){
+		// received datagrams can contain multiple segments. keep the remaining ones
+		// for the next call. pending datagrams are stored in reverse order
+		if(pReceivePending.empty()){
+			if(ReceiveDatagrams(pReceivePending, 1) == 0){
+				return nullptr;
+			}
+			std::reverse(pReceivePending.begin(), pReceivePending.end());
+		}
+		
+		const denMessage::Ref message(pReceivePending.back().message);
+		address = pReceivePending.back().address;
+		pReceivePending.pop_back();
+		return message;
+	}
+#endif
+	
 	struct pollfd ufd;
 	
 	ufd.fd = pSocket;
 	ufd.events = POLLIN;
 	if(poll(&ufd, 1, 0) > 0){
-		const denMessage::Ref message(denMessage::Pool().Get());
-		std::string &data = message->Item().GetData();
+		// receive directly into the message data
+		const denMessage::Ref message(denMessage::ReceivePool().Get());
+		message->Item().SetLength(pBufferLen);
 		
-		if(pAddress.type == denSocketAddress::Type::ipv6){
-			struct sockaddr_in6 sa;
-			socklen_t slen = sizeof(sa);
-			const int result = recvfrom(pSocket, (char*)pBuffer.c_str(), pBufferLen, 0, (struct sockaddr *)&sa, &slen);
-			
-			if(result == -1){
-				const int error = errno;
-				std::stringstream s;
-				s << "recvfrom failed: " << strerror(error) << " (" << error << ")";
-				throw std::runtime_error(s.str());
-			}
-			
-			if(result > 0){
-				address = AddressFromSocket(sa);
-				if(data.size() < (std::size_t)result){
-					data.assign(result, 0);
-				}
-				pBuffer.copy((char*)data.c_str(), result, 0);
-				message->Item().SetLength(result);
-				return message;
-			} // connection closed returns 0 length
-			
-		}else{
-			struct sockaddr_in sa;
-			socklen_t slen = sizeof(sa);
-			const int result = recvfrom(pSocket, (char*)pBuffer.c_str(), pBufferLen, 0, (struct sockaddr *)&sa, &slen);
-			
-			if(result == -1){
-				const int error = errno;
-				std::stringstream s;
-				s << "recvfrom failed: " << strerror(error) << " (" << error << ")";
-				throw std::runtime_error(s.str());
-			}
-			
-			if(result > 0){
-				address = AddressFromSocket(sa);
-				if(data.size() < (std::size_t)result){
-					data.assign(result, 0);
-				}
-				pBuffer.copy((char*)data.c_str(), result, 0);
-				message->Item().SetLength(result);
-				return message;
-			} // connection closed returns 0 length
+		sockaddr_storage sa;
+		iovec vector;
+		vector.iov_base = (void*)message->Item().GetData().c_str();
+		vector.iov_len = pBufferLen;
+		
+		msghdr header;
+		memset(&header, 0, sizeof(header));
+		if(!pConnected){
+			header.msg_name = &sa;
+			header.msg_namelen = sizeof(sa);
 		}
+		header.msg_iov = &vector;
+		header.msg_iovlen = 1;
+		
+#ifdef OS_UNIX
+		ControlBuffer control;
+		if(pReceiveTimestamps || pReceiveDropCounter){
+			header.msg_control = control.buffer;
+			header.msg_controllen = sizeof(control.buffer);
+		}
+#endif
+		
+		const int result = (int)recvmsg(pSocket, &header, 0);
+		
+		if(result == -1){
+			const int error = errno;
+			std::stringstream s;
+			s << "recvmsg failed: " << strerror(error) << " (" << error << ")";
+			throw std::runtime_error(s.str());
+		}
+		
+		if(result > 0){
+			address = pConnected ? pRemoteAddress : pAddressFromStorage(sa);
+			message->Item().SetLength(result);
+#ifdef OS_UNIX
+			pUpdateDropCounter(header);
+			message->Item().SetTimestamp(pTimestampFromControl(header, pSampleReceiveClock()));
+#else
+			message->Item().SetTimestamp(denMessage::Clock::now());
+#endif
+			return message;
+		} // connection closed returns 0 length
 	}
 	
 	return nullptr;
@@ -196,7 +274,10 @@ void denSocketUnix::SendDatagram(const denMessage &message, const denSocketAddre
 		throw std::runtime_error(s.str());
 	}
 	
-	if(pAddress.type == denSocketAddress::Type::ipv6){
+	if(pSendConnected(address)){
+		send(pSocket, (char*)message.GetData().c_str(), message.GetLength(), 0);
+		
+	}else if(pAddress.type == denSocketAddress::Type::ipv6){
 		struct sockaddr_in6 sa;
 		memset(&sa, 0, sizeof(sa));
 		SocketFromAddress(address, sa);
@@ -214,6 +295,346 @@ void denSocketUnix::SendDatagram(const denMessage &message, const denSocketAddre
 	}
 }
 
+#ifdef OS_UNIX
+bool denSocketUnix::SendProbeDatagram(const denMessage &message, const denSocketAddress &address){
+	if(message.GetLength() > 65500){
+		std::stringstream s;
+		s << "SendProbeDatagram: message size too long: " << message.GetLength() << " (max 65500)";
+		throw std::runtime_error(s.str());
+	}
+	
+	// fragmentation is disabled only while sending the probe. other datagrams keep
+	// using the default which fragments datagrams larger than the path MTU
+	const bool ipv6 = pAddress.type == denSocketAddress::Type::ipv6;
+	const int level = ipv6 ? IPPROTO_IPV6 : IPPROTO_IP;
+	const int option = ipv6 ? IPV6_MTU_DISCOVER : IP_MTU_DISCOVER;
+	
+	int prevDiscover = 0;
+	socklen_t optlen = sizeof(prevDiscover);
+	if(getsockopt(pSocket, level, option, &prevDiscover, &optlen)){
+		const int error = errno;
+		std::stringstream s;
+		s << "getsockopt(IP_MTU_DISCOVER) failed: " << strerror(error) << " (" << error << ")";
+		throw std::runtime_error(s.str());
+	}
+	
+	int discover = ipv6 ? IPV6_PMTUDISC_DO : IP_PMTUDISC_DO;
+	if(setsockopt(pSocket, level, option, &discover, sizeof(discover))){
+		const int error = errno;
+		std::stringstream s;
+		s << "setsockopt(IP_MTU_DISCOVER) failed: " << strerror(error) << " (" << error << ")";
+		throw std::runtime_error(s.str());
+	}
+	
+	ssize_t result;
+	if(pSendConnected(address)){
+		result = send(pSocket, (char*)message.GetData().c_str(), message.GetLength(), 0);
+		
+	}else{
+		sockaddr_storage sa;
+		const socklen_t salen = pStorageFromAddress(address, sa);
+		result = sendto(pSocket, (char*)message.GetData().c_str(),
+			message.GetLength(), 0, (struct sockaddr *)&sa, salen);
+	}
+	const int sendError = errno;
+	
+	setsockopt(pSocket, level, option, &prevDiscover, sizeof(prevDiscover));
+	
+	return result != -1 || sendError != EMSGSIZE;
+}
+
+int denSocketUnix::ReceiveDatagrams(Datagrams &datagrams, int maxCount){
+	if(!pReceivePending.empty()){
+		const int count = (int)pReceivePending.size();
+		datagrams.insert(datagrams.end(), pReceivePending.rbegin(), pReceivePending.rend());
+		pReceivePending.clear();
+		return count;
+	}
+	
+	maxCount = std::min(maxCount, 64);
+	if(maxCount < 1){
+		return 0;
+	}
+	
+	pPrepareBatch(maxCount, true);
+	
+	if((int)vReceiveBuffers.size() < maxCount){
+		vReceiveBuffers.resize(maxCount);
+	}
+	
+	int i;
+	
+	for(i=0; i<maxCount; i++){
+		// receive directly into pooled messages. messages not used by this call are
+		// kept for the next call
+		denMessage::Ref &message = vReceiveBuffers[i];
+		if(!message){
+			message = denMessage::ReceivePool().Get();
+			message->Item().SetLength(pBufferLen);
+		}
+		
+		pBatchVectors[i].iov_base = (void*)message->Item().GetData().c_str();
+		pBatchVectors[i].iov_len = pBufferLen;
+		
+		msghdr &header = pBatchHeaders[i].msg_hdr;
+		memset(&header, 0, sizeof(header));
+		if(!pConnected){
+			header.msg_name = &pBatchAddresses[i];
+			header.msg_namelen = sizeof(sockaddr_storage);
+		}
+		header.msg_iov = &pBatchVectors[i];
+		header.msg_iovlen = 1;
+		pBatchHeaders[i].msg_len = 0;
+		
+		if(pReceiveOffload || pReceiveTimestamps || pReceiveDropCounter){
+			header.msg_control = pBatchControls[i].buffer;
+			header.msg_controllen = sizeof(pBatchControls[i].buffer);
+		}
+	}
+	
+	const int result = recvmmsg(pSocket, pBatchHeaders.data(), maxCount, MSG_DONTWAIT, nullptr);
+	
+	if(result == -1){
+		const int error = errno;
+		if(error == EAGAIN || error == EWOULDBLOCK || error == EINTR){
+			return 0;
+		}
+		
+		std::stringstream s;
+		s << "recvmmsg failed: " << strerror(error) << " (" << error << ")";
+		throw std::runtime_error(s.str());
+	}
+	
+	const ReceiveClock clock(pSampleReceiveClock());
+	int count = 0;
+	
+	for(i=0; i<result; i++){
+		const size_t length = (size_t)pBatchHeaders[i].msg_len;
+		if(length == 0){
+			continue; // connection closed returns 0 length
+		}
+		
+		pUpdateDropCounter(pBatchHeaders[i].msg_hdr);
+		
+		const denSocketAddress address(pConnected ? pRemoteAddress : pAddressFromStorage(pBatchAddresses[i]));
+		const denMessage::Timestamp timestamp(pTimestampFromControl(pBatchHeaders[i].msg_hdr, clock));
+		
+		const int segmentSize = pReceiveOffload ? pSegmentSizeFromControl(pBatchHeaders[i].msg_hdr) : 0;
+		if(segmentSize > 0 && (size_t)segmentSize < length){
+			count += pAppendSegments(datagrams, (const uint8_t*)pBatchVectors[i].iov_base,
+				length, segmentSize, address, timestamp);
+			continue; // receive buffer is reused
+		}
+		
+		denMessage::Ref message;
+		if(length <= vReceiveCopyLength){
+			// receive buffer is reused
+			message = denMessage::Pool().Get();
+			message->Item().SetLength(length);
+			memcpy((char*)message->Item().GetData().c_str(), pBatchVectors[i].iov_base, length);
+			
+		}else{
+			message.swap(vReceiveBuffers[i]);
+			message->Item().SetLength(length);
+		}
+		message->Item().SetTimestamp(timestamp);
+		
+		datagrams.push_back({message, address});
+		count++;
+	}
+	
+	return count;
+}
+
+void denSocketUnix::FlushDatagrams(){
+	const int count = (int)pSendQueue.size();
+	if(count == 0){
+		return;
+	}
+	
+	try{
+		pPrepareBatch(count, false);
+		
+		// two vectors per datagram: protocol header and payload. the payload is send
+		// directly from the referenced message without copying
+		int i;
+		for(i=0; i<count; i++){
+			const QueuedDatagram &datagram = pSendQueue[i];
+			iovec * const vectors = pBatchSendVectors.data() + i * 2;
+			vectors[0].iov_base = (void*)datagram.header;
+			vectors[0].iov_len = datagram.headerLength;
+			vectors[1].iov_base = (void*)datagram.GetPayload();
+			vectors[1].iov_len = datagram.length;
+		}
+		
+		int first = 0;
+		while(first < count){
+			const int headerCount = pBuildSendBatch(first);
+			int offset = 0;
+			first = count;
+			
+			while(offset < headerCount){
+				const int result = sendmmsg(pSocket, pBatchHeaders.data() + offset, headerCount - offset, 0);
+				
+				if(result != -1){
+					offset += result;
+					continue;
+				}
+				
+				if(errno == EINTR){
+					continue;
+				}
+				
+				if(pBatchSegments[offset] > 1 && (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP)){
+					// kernel or device does not support segmentation offload. send the
+					// remaining datagrams individually
+					pSegmentationOffload = false;
+					first = pBatchFirst[offset];
+					break;
+				}
+				
+				// errors have been ignored with sendto. skip the failing datagram, or all
+				// datagrams of a failing segmented entry, and continue sending the
+				// remaining ones
+				offset++;
+			}
+		}
+		
+	}catch(...){
+		pSendQueue.clear();
+		throw;
+	}
+	
+	pSendQueue.clear();
+}
+#endif
+
+bool denSocketUnix::WaitForDatagram(float timeout){
+	if(pSocket == -1){
+		throw std::runtime_error("socket not bound");
+	}
+	
+	const int timeoutMs = timeout < 0.0f ? -1 : (int)std::ceil(timeout * 1000.0f);
+	
+#ifdef OS_UNIX
+	// epoll set is created on first use. sockets not waited on do not need one
+	if(pEpoll == -1){
+		const int epoll = epoll_create1(EPOLL_CLOEXEC);
+		if(epoll == -1){
+			const int error = errno;
+			std::stringstream s;
+			s << "epoll_create1 failed: " << strerror(error) << " (" << error << ")";
+			throw std::runtime_error(s.str());
+		}
+		
+		epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.fd = pSocket;
+		if(epoll_ctl(epoll, EPOLL_CTL_ADD, pSocket, &event) == -1){
+			const int error = errno;
+			close(epoll);
+			std::stringstream s;
+			s << "epoll_ctl failed: " << strerror(error) << " (" << error << ")";
+			throw std::runtime_error(s.str());
+		}
+		
+		pEpoll = epoll;
+	}
+	
+	epoll_event event;
+	const int result = epoll_wait(pEpoll, &event, 1, timeoutMs);
+	
+#else
+	struct pollfd ufd;
+	ufd.fd = pSocket;
+	ufd.events = POLLIN;
+	const int result = poll(&ufd, 1, timeoutMs);
+#endif
+	
+	if(result == -1){
+		const int error = errno;
+		if(error == EINTR){
+			return false;
+		}
+		
+		std::stringstream s;
+		s << "wait failed: " << strerror(error) << " (" << error << ")";
+		throw std::runtime_error(s.str());
+	}
+	
+	return result > 0;
+}
+
+bool denSocketUnix::PrepareWait(intptr_t &handle){
+	if(pSocket == -1){
+		throw std::runtime_error("socket not bound");
+	}
+	
+	handle = pSocket;
+	return false;
+}
+
+void denSocketUnix::Connect(const denSocketAddress &address){
+	if(pSocket == -1){
+		throw std::runtime_error("socket not bound");
+	}
+	
+	sockaddr_storage sa;
+	const socklen_t length = pStorageFromAddress(address, sa);
+	if(connect(pSocket, (sockaddr*)&sa, length)){
+		const int error = errno;
+		std::stringstream s;
+		s << "connect failed: " << strerror(error) << " (" << error << ")";
+		throw std::runtime_error(s.str());
+	}
+	
+	// datagrams received before connecting can be from any address. drop them like
+	// lost datagrams since received datagrams are now assumed to be from the remote
+	char buffer[1];
+	while(recv(pSocket, buffer, sizeof(buffer), MSG_DONTWAIT) >= 0){
+	}
+#ifdef OS_UNIX
+	pReceivePending.clear();
+#endif
+	
+	denSocket::Connect(address);
+}
+
+bool denSocketUnix::AttachReusePortSteering(int socketCount){
+#if defined OS_UNIX && defined SO_ATTACH_REUSEPORT_CBPF
+	if(pSocket == -1){
+		throw std::runtime_error("socket not bound");
+	}
+	if(socketCount < 1){
+		throw std::invalid_argument("socketCount < 1");
+	}
+	
+	// socket index = receive flow hash % socketCount
+	sock_filter code[] = {
+		{BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_RXHASH)},
+		{BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)socketCount},
+		{BPF_RET | BPF_A, 0, 0, 0}
+	};
+	
+	sock_fprog program;
+	program.len = sizeof(code) / sizeof(code[0]);
+	program.filter = code;
+	
+	if(setsockopt(pSocket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program))){
+		const int error = errno;
+		std::stringstream s;
+		s << "setsockopt(SO_ATTACH_REUSEPORT_CBPF) failed: " << strerror(error) << " (" << error << ")";
+		throw std::runtime_error(s.str());
+	}
+	return true;
+	
+#else
+	(void)socketCount;
+	return false;
+#endif
+}
+
 denSocketAddress denSocketUnix::ResolveAddress(const std::string &address){
 	if(address.empty()){
 		throw std::invalid_argument("address is empty");
@@ -410,6 +831,246 @@ void denSocketUnix::SocketFromAddress( const denSocketAddress &socketAddress, st
 	address.sin6_port = htons(socketAddress.port);
 }
 
+denSocketAddress denSocketUnix::pAddressFromStorage(const sockaddr_storage &address) const{
+	switch(address.ss_family){
+	case AF_INET6:
+		return AddressFromSocket((const sockaddr_in6 &)address);
+		
+	case AF_INET:
+		return AddressFromSocket((const sockaddr_in &)address);
+		
+	default:
+		throw std::invalid_argument("unsupported address family");
+	}
+}
+
+socklen_t denSocketUnix::pStorageFromAddress(const denSocketAddress &socketAddress, sockaddr_storage &address) const{
+	memset(&address, 0, sizeof(address));
+	
+	if(pAddress.type == denSocketAddress::Type::ipv6){
+		SocketFromAddress(socketAddress, (sockaddr_in6 &)address);
+		return sizeof(sockaddr_in6);
+		
+	}else{
+		SocketFromAddress(socketAddress, (sockaddr_in &)address);
+		return sizeof(sockaddr_in);
+	}
+}
+
+#ifdef OS_UNIX
+void denSocketUnix::pPrepareBatch(int count, bool receive){
+	if((int)pBatchHeaders.size() < count){
+		pBatchHeaders.resize(count);
+		pBatchVectors.resize(count);
+		pBatchAddresses.resize(count);
+	}
+	
+	if((int)pBatchControls.size() < count){
+		pBatchControls.resize(count);
+		pBatchFirst.resize(count);
+		pBatchSegments.resize(count);
+	}
+	
+	if(!receive && (int)pBatchSendVectors.size() < count * 2){
+		pBatchSendVectors.resize(count * 2);
+	}
+}
+
+void denSocketUnix::pApplyReceiveOffload(){
+	if(!pReceiveOffload){
+		return;
+	}
+	
+#ifdef UDP_GRO
+	const int value = 1;
+	if(setsockopt(pSocket, IPPROTO_UDP, UDP_GRO, &value, sizeof(value))){
+		pReceiveOffload = false;
+	}
+	
+#else
+	pReceiveOffload = false;
+#endif
+}
+
+void denSocketUnix::pApplyReceiveTimestamps(){
+#ifdef SO_TIMESTAMPNS
+	const int value = 1;
+	pReceiveTimestamps = setsockopt(pSocket, SOL_SOCKET, SO_TIMESTAMPNS, &value, sizeof(value)) == 0;
+#else
+	pReceiveTimestamps = false;
+#endif
+}
+
+void denSocketUnix::pApplyDropCounter(){
+#ifdef SO_RXQ_OVFL
+	const int value = 1;
+	pReceiveDropCounter = setsockopt(pSocket, SOL_SOCKET, SO_RXQ_OVFL, &value, sizeof(value)) == 0;
+#else
+	pReceiveDropCounter = false;
+#endif
+}
+
+void denSocketUnix::pUpdateDropCounter(const msghdr &header){
+#ifdef SO_RXQ_OVFL
+	if(!pReceiveDropCounter){
+		return;
+	}
+	
+	// the kernel reports the total count of dropped datagrams as 32-bit counter
+	cmsghdr *cmsg;
+	for(cmsg = CMSG_FIRSTHDR(&header); cmsg; cmsg = CMSG_NXTHDR((msghdr*)&header, cmsg)){
+		if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL){
+			uint32_t counter;
+			memcpy(&counter, CMSG_DATA(cmsg), sizeof(counter));
+			pDroppedDatagramCount += (uint32_t)(counter - pLastDropCounter);
+			pLastDropCounter = counter;
+			return;
+		}
+	}
+#else
+	(void)header;
+#endif
+}
+
+denSocketUnix::ReceiveClock denSocketUnix::pSampleReceiveClock(){
+	ReceiveClock clock;
+	clock.now = denMessage::Clock::now();
+	clock.systemNow = std::chrono::system_clock::now();
+	return clock;
+}
+
+denMessage::Timestamp denSocketUnix::pTimestampFromControl(const msghdr &header, const ReceiveClock &clock){
+#ifdef SO_TIMESTAMPNS
+	// kernel timestamps use the realtime clock. convert them to the monotonic clock
+	// using the age of the datagram at the time the clocks have been sampled
+	cmsghdr *cmsg;
+	for(cmsg = CMSG_FIRSTHDR(&header); cmsg; cmsg = CMSG_NXTHDR((msghdr*)&header, cmsg)){
+		if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPNS){
+			timespec received;
+			memcpy(&received, CMSG_DATA(cmsg), sizeof(received));
+			
+			const std::chrono::system_clock::time_point kernelTime(
+				std::chrono::duration_cast<std::chrono::system_clock::duration>(
+					std::chrono::seconds(received.tv_sec) + std::chrono::nanoseconds(received.tv_nsec)));
+			
+			if(kernelTime >= clock.systemNow){
+				return clock.now;
+			}
+			return clock.now - std::chrono::duration_cast<denMessage::Clock::duration>(clock.systemNow - kernelTime);
+		}
+	}
+#else
+	(void)header;
+#endif
+	return clock.now;
+}
+
+int denSocketUnix::pSegmentSizeFromControl(const msghdr &header){
+#ifdef UDP_GRO
+	cmsghdr *cmsg;
+	for(cmsg = CMSG_FIRSTHDR(&header); cmsg; cmsg = CMSG_NXTHDR((msghdr*)&header, cmsg)){
+		if(cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO){
+			int size;
+			memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+			return size;
+		}
+	}
+#else
+	(void)header;
+#endif
+	return 0;
+}
+
+int denSocketUnix::pAppendSegments(Datagrams &datagrams, const uint8_t *data, size_t length,
+int segmentSize, const denSocketAddress &address, const denMessage::Timestamp &timestamp){
+	const size_t stride = segmentSize > 0 ? (size_t)segmentSize : length;
+	size_t offset = 0;
+	int count = 0;
+	
+	while(offset < length){
+		const size_t segmentLength = std::min(stride, length - offset);
+		
+		const denMessage::Ref message(denMessage::Pool().Get());
+		message->Item().SetLength(segmentLength);
+		memcpy((char*)message->Item().GetData().c_str(), data + offset, segmentLength);
+		message->Item().SetTimestamp(timestamp);
+		
+		datagrams.push_back({message, address});
+		offset += segmentLength;
+		count++;
+	}
+	
+	return count;
+}
+
+int denSocketUnix::pBuildSendBatch(int first){
+	const int count = (int)pSendQueue.size();
+	int headerCount = 0;
+	
+	while(first < count){
+		const QueuedDatagram &datagram = pSendQueue[first];
+		const size_t segmentSize = datagram.GetLength();
+		int segments = 1;
+		
+		// larger segments are fine to the connected address if the path MTU is known
+		const size_t maxSegmentSize = pSendConnected(datagram.address)
+			? std::max(vMaxSegmentSize, (size_t)pPathDatagramSize) : vMaxSegmentSize;
+		
+		if(pSegmentationOffload && segmentSize > 0 && segmentSize <= maxSegmentSize){
+			const int maxSegments = std::min(vMaxSegments, (int)(vMaxSegmentedLength / segmentSize));
+			
+			while(segments < maxSegments && first + segments < count){
+				const QueuedDatagram &next = pSendQueue[first + segments];
+				const size_t length = next.GetLength();
+				if(length == 0 || length > segmentSize || !(next.address == datagram.address)){
+					break;
+				}
+				
+				segments++;
+				
+				if(length < segmentSize){
+					break; // only the last segment can be shorter
+				}
+			}
+		}
+		
+		msghdr &header = pBatchHeaders[headerCount].msg_hdr;
+		memset(&header, 0, sizeof(header));
+		if(!pSendConnected(datagram.address)){
+			header.msg_name = &pBatchAddresses[headerCount];
+			header.msg_namelen = pStorageFromAddress(datagram.address, pBatchAddresses[headerCount]);
+		}
+		header.msg_iov = &pBatchSendVectors[first * 2];
+		header.msg_iovlen = segments * 2;
+		
+#ifdef UDP_SEGMENT
+		if(segments > 1){
+			ControlBuffer &control = pBatchControls[headerCount];
+			memset(&control, 0, sizeof(control));
+			header.msg_control = control.buffer;
+			header.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+			
+			cmsghdr * const cmsg = CMSG_FIRSTHDR(&header);
+			cmsg->cmsg_level = IPPROTO_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			
+			const uint16_t size = (uint16_t)segmentSize;
+			memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+		}
+#endif
+		
+		pBatchHeaders[headerCount].msg_len = 0;
+		pBatchFirst[headerCount] = first;
+		pBatchSegments[headerCount] = segments;
+		headerCount++;
+		first += segments;
+	}
+	
+	return headerCount;
+}
+#endif
+
 std::vector<std::string> denSocketUnix::pFindAddresses(bool onlyPublic){
 	std::vector<std::string> list;
 	
@@ -471,6 +1132,70 @@ std::vector<std::string> denSocketUnix::pFindAddresses(bool onlyPublic){
 	return list;
 }
 
+void denSocketUnix::pApplyReusePort(){
+	if(!pReusePort){
+		return;
+	}
+	
+#ifdef SO_REUSEPORT
+	const int value = 1;
+	if(setsockopt(pSocket, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value))){
+		const int error = errno;
+		std::stringstream s;
+		s << "setsockopt(SO_REUSEPORT) failed: " << strerror(error) << " (" << error << ")";
+		throw std::runtime_error(s.str());
+	}
+	
+#else
+	throw std::runtime_error("SO_REUSEPORT not supported");
+#endif
+}
+
+void denSocketUnix::pApplyBufferSizes(){
+	if(pReceiveBufferSize > 0){
+		// forcing allows exceeding the system maximum but requires privileges
+		bool applied = false;
+#ifdef SO_RCVBUFFORCE
+		applied = setsockopt(pSocket, SOL_SOCKET, SO_RCVBUFFORCE,
+			&pReceiveBufferSize, sizeof(pReceiveBufferSize)) == 0;
+#endif
+		if(!applied && setsockopt(pSocket, SOL_SOCKET, SO_RCVBUF,
+		&pReceiveBufferSize, sizeof(pReceiveBufferSize))){
+			const int error = errno;
+			std::stringstream s;
+			s << "setsockopt(SO_RCVBUF) failed: " << strerror(error) << " (" << error << ")";
+			throw std::runtime_error(s.str());
+		}
+	}
+	
+	if(pSendBufferSize > 0){
+		bool applied = false;
+#ifdef SO_SNDBUFFORCE
+		applied = setsockopt(pSocket, SOL_SOCKET, SO_SNDBUFFORCE,
+			&pSendBufferSize, sizeof(pSendBufferSize)) == 0;
+#endif
+		if(!applied && setsockopt(pSocket, SOL_SOCKET, SO_SNDBUF,
+		&pSendBufferSize, sizeof(pSendBufferSize))){
+			const int error = errno;
+			std::stringstream s;
+			s << "setsockopt(SO_SNDBUF) failed: " << strerror(error) << " (" << error << ")";
+			throw std::runtime_error(s.str());
+		}
+	}
+	
+	// store the sizes actually used by the kernel
+	int size;
+	socklen_t length = sizeof(size);
+	if(getsockopt(pSocket, SOL_SOCKET, SO_RCVBUF, &size, &length) == 0){
+		pReceiveBufferSize = size;
+	}
+	
+	length = sizeof(size);
+	if(getsockopt(pSocket, SOL_SOCKET, SO_SNDBUF, &size, &length) == 0){
+		pSendBufferSize = size;
+	}
+}
+
 uint32_t denSocketUnix::pScopeIdFor(const sockaddr_in6 &address){
 	ifaddrs *ifaddr, *ifiter;
 	
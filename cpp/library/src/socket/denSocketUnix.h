@@ -34,6 +34,9 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <sys/uio.h>
+#include <chrono>
+#include <ctime>
 
 /**
  * \brief Socket.
@@ -52,12 +55,61 @@ public:
 	/** \brief Bind socket to stored address. */
 	virtual void Bind();
 	
+	/** \brief Connect socket to remote address. */
+	virtual void Connect(const denSocketAddress &address);
+	
+	/** \brief Steer datagrams across reuse port group using the packet flow hash. */
+	virtual bool AttachReusePortSteering(int socketCount);
+	
+#ifdef OS_UNIX
+	/** \brief Receive offload is enabled. */
+	inline bool GetReceiveOffload() const{ return pReceiveOffload; }
+	
+	/**
+	 * \brief Set if receive offload is enabled.
+	 * 
+	 * If enabled the kernel coalesces consecutive datagrams of the same flow into one
+	 * large datagram using UDP GRO. Received coalesced datagrams are split again into the
+	 * individual datagrams. Has to be set before Bind(). Stays disabled if the kernel does
+	 * not support UDP GRO.
+	 */
+	void SetReceiveOffload(bool enable);
+#endif
+	
 	/** \brief Receive datagram from socket. */
 	virtual denMessage::Ref ReceiveDatagram(denSocketAddress &address);
 	
 	/** \brief Send datagram. */
 	virtual void SendDatagram(const denMessage &message, const denSocketAddress &address);
 	
+#ifdef OS_UNIX
+	/** \brief Send path MTU probe datagram with IP_MTU_DISCOVER set to IP_PMTUDISC_DO. */
+	virtual bool SendProbeDatagram(const denMessage &message, const denSocketAddress &address);
+	
+	/**
+	 * \brief Receive up to maxCount datagrams from socket using recvmmsg.
+	 * 
+	 * With receive offload enabled each received datagram can be split into multiple
+	 * datagrams. The returned count can then be larger than maxCount.
+	 */
+	virtual int ReceiveDatagrams(Datagrams &datagrams, int maxCount);
+	
+	/**
+	 * \brief Send all queued datagrams using sendmmsg.
+	 * 
+	 * Consecutive datagrams of equal size to the same address are send as one datagram
+	 * using UDP segmentation offload if supported. Segmentation offload is disabled the
+	 * first time the kernel rejects a segmented datagram.
+	 */
+	virtual void FlushDatagrams();
+#endif
+	
+	/** \brief Wait until datagrams are pending or timeout elapsed. */
+	virtual bool WaitForDatagram(float timeout);
+	
+	/** \brief Prepare waiting on multiple sockets together. */
+	virtual bool PrepareWait(intptr_t &handle);
+	
 	/** \brief Resolve address */
 	static denSocketAddress ResolveAddress(const std::string &address);
 	
@@ -73,13 +125,69 @@ protected:
 	static void SocketFromAddress(const denSocketAddress &socketAddress, sockaddr_in &address);
 	static void SocketFromAddress(const denSocketAddress &socketAddress, sockaddr_in6 &address);
 	static std::vector<std::string> pFindAddresses(bool onlyPublic);
+	denSocketAddress pAddressFromStorage(const sockaddr_storage &address) const;
+	socklen_t pStorageFromAddress(const denSocketAddress &socketAddress, sockaddr_storage &address) const;
 	
-private:
-	static uint32_t pScopeIdFor(const sockaddr_in6 &address);
+	/** \brief Datagram to address can be send using the connected remote address. */
+	inline bool pSendConnected(const denSocketAddress &address) const{
+		return pConnected && address == pRemoteAddress; }
+	
+#ifdef OS_UNIX
+	/** \brief Clocks sampled once per receive call to convert kernel timestamps. */
+	struct ReceiveClock{
+		denMessage::Timestamp now;
+		std::chrono::system_clock::time_point systemNow;
+	};
+	
+	/** \brief Control message buffer for segmentation offload, timestamps and drop counter. */
+	union ControlBuffer{
+		cmsghdr header;
+		char buffer[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(timespec)) + CMSG_SPACE(sizeof(uint32_t))];
+	};
+	
+	static ReceiveClock pSampleReceiveClock();
+	static int pSegmentSizeFromControl(const msghdr &header);
+	static denMessage::Timestamp pTimestampFromControl(const msghdr &header, const ReceiveClock &clock);
+	static int pAppendSegments(Datagrams &datagrams, const uint8_t *data, size_t length,
+		int segmentSize, const denSocketAddress &address, const denMessage::Timestamp &timestamp);
+	void pUpdateDropCounter(const msghdr &header);
+#endif
 	
 	int pSocket;
-	std::string pBuffer;
 	int pBufferLen;
+	
+#ifdef OS_UNIX
+	bool pReceiveOffload;
+	bool pReceiveTimestamps;
+	bool pReceiveDropCounter;
+	uint32_t pLastDropCounter;
+#endif
+	
+private:
+	static uint32_t pScopeIdFor(const sockaddr_in6 &address);
+	void pApplyReusePort();
+	void pApplyBufferSizes();
+	
+#ifdef OS_UNIX
+	void pPrepareBatch(int count, bool receive);
+	void pApplyReceiveOffload();
+	void pApplyReceiveTimestamps();
+	void pApplyDropCounter();
+	int pBuildSendBatch(int first);
+#endif
+	
+#ifdef OS_UNIX
+	int pEpoll;
+	std::vector<mmsghdr> pBatchHeaders;
+	std::vector<iovec> pBatchVectors;
+	std::vector<sockaddr_storage> pBatchAddresses;
+	std::vector<iovec> pBatchSendVectors;
+	std::vector<ControlBuffer> pBatchControls;
+	std::vector<int> pBatchFirst;
+	std::vector<int> pBatchSegments;
+	bool pSegmentationOffload;
+	Datagrams pReceivePending;
+#endif
 };
 
 #endif
@@ -0,0 +1,609 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "denSocketUring.h"
+
+#ifdef DEN_WITH_IO_URING
+
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+#include <memory.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// io_uring is used through the raw system calls to avoid depending on liburing
+static const __u64 vUserDataReceive = 1;
+static const __u64 vUserDataSend = 2;
+static const __u16 vBufferGroup = 0;
+static const unsigned int vRingEntries = 256;
+static const unsigned int vReceiveBufferCount = 64;
+
+static int fUringSetup(unsigned int entries, io_uring_params &params){
+	return (int)syscall(__NR_io_uring_setup, entries, &params);
+}
+
+static int fUringEnter(int fd, unsigned int toSubmit, unsigned int minComplete, unsigned int flags){
+	return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+static int fUringWait(int fd, unsigned int toSubmit, const __kernel_timespec *timeout){
+	io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	arg.ts = (__u64)(uintptr_t)timeout;
+	return (int)syscall(__NR_io_uring_enter, fd, toSubmit, 1,
+		IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+static int fUringRegister(int fd, unsigned int opcode, void *arg, unsigned int count){
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+static bool fUringProbe(){
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	
+	const int fd = fUringSetup(2, params);
+	if(fd == -1){
+		return false;
+	}
+	
+	close(fd);
+	return true;
+}
+
+
+denSocketUring::denSocketUring() :
+pRingFd(-1),
+pSqRing(MAP_FAILED),
+pSqRingSize(0),
+pCqRing(MAP_FAILED),
+pCqRingSize(0),
+pSqes((io_uring_sqe*)MAP_FAILED),
+pSqesSize(0),
+pSqHead(nullptr),
+pSqTail(nullptr),
+pSqArray(nullptr),
+pSqMask(0),
+pSqEntries(0),
+pSqLocalTail(0),
+pCqHead(nullptr),
+pCqTail(nullptr),
+pCqMask(0),
+pCqes(nullptr),
+pBufRing((io_uring_buf_ring*)MAP_FAILED),
+pBufRingSize(0),
+pBuffers((uint8_t*)MAP_FAILED),
+pBuffersSize(0),
+pBufferStride(0),
+pBufferCount(0),
+pBufRingTail(0),
+pReceiveArmed(false),
+pReceiveFailed(false),
+pReceivedPosition(0),
+pSendsInFlight(0)
+{
+	memset(&pReceiveHeader, 0, sizeof(pReceiveHeader));
+}
+
+denSocketUring::~denSocketUring() noexcept{
+	pCloseRing();
+}
+
+void denSocketUring::Bind(){
+	denSocketUnix::Bind();
+	
+	if(!pSetupRing()){
+		pCloseRing();
+		return;
+	}
+	
+	// an unsupported multishot receive fails right away while submitting
+	if(!pArmReceive() || pEnter(0, IORING_ENTER_GETEVENTS) < 0){
+		pCloseRing();
+		return;
+	}
+	
+	pReapCompletions();
+	if(pReceiveFailed){
+		pCloseRing();
+	}
+}
+
+denMessage::Ref denSocketUring::ReceiveDatagram(denSocketAddress &address){
+	if(pRingFd == -1){
+		return denSocketUnix::ReceiveDatagram(address);
+	}
+	
+	Datagrams datagrams;
+	if(ReceiveDatagrams(datagrams, 1) == 0){
+		return nullptr;
+	}
+	
+	address = datagrams.front().address;
+	return datagrams.front().message;
+}
+
+int denSocketUring::ReceiveDatagrams(Datagrams &datagrams, int maxCount){
+	if(pRingFd == -1){
+		return denSocketUnix::ReceiveDatagrams(datagrams, maxCount);
+	}
+	
+	if(pReceivedPosition == pReceived.size()){
+		pReceived.clear();
+		pReceivedPosition = 0;
+		
+		// completions can require task work to run before they show up
+		if(__atomic_load_n(pCqTail, __ATOMIC_ACQUIRE) == *pCqHead){
+			pEnter(0, IORING_ENTER_GETEVENTS);
+		}
+		pReapCompletions();
+	}
+	
+	if(pReceiveFailed){
+		// kernel lost multishot support after all. continue with plain receiving
+		pCloseRing();
+		return denSocketUnix::ReceiveDatagrams(datagrams, maxCount);
+	}
+	
+	if(!pReceiveArmed && pArmReceive()){
+		pEnter(0, 0);
+	}
+	
+	int count = 0;
+	while(count < maxCount && pReceivedPosition < pReceived.size()){
+		datagrams.push_back(pReceived[pReceivedPosition]);
+		pReceived[pReceivedPosition++].message.reset();
+		count++;
+	}
+	
+	return count;
+}
+
+void denSocketUring::FlushDatagrams(){
+	if(pRingFd == -1){
+		denSocketUnix::FlushDatagrams();
+		return;
+	}
+	
+	const int count = (int)pSendQueue.size();
+	if(count == 0){
+		return;
+	}
+	
+	try{
+		if((int)pSendHeaders.size() < count){
+			pSendHeaders.resize(count);
+			pSendVectors.resize(count * 2);
+			pSendAddresses.resize(count);
+		}
+		
+		int i;
+		for(i=0; i<count; i++){
+			const QueuedDatagram &datagram = pSendQueue[i];
+			iovec * const vectors = pSendVectors.data() + i * 2;
+			vectors[0].iov_base = (void*)datagram.header;
+			vectors[0].iov_len = datagram.headerLength;
+			vectors[1].iov_base = (void*)datagram.GetPayload();
+			vectors[1].iov_len = datagram.length;
+			
+			msghdr &header = pSendHeaders[i];
+			memset(&header, 0, sizeof(header));
+			if(!pSendConnected(datagram.address)){
+				header.msg_name = &pSendAddresses[i];
+				header.msg_namelen = pStorageFromAddress(datagram.address, pSendAddresses[i]);
+			}
+			header.msg_iov = vectors;
+			header.msg_iovlen = 2;
+		}
+		
+		// submit as many sends as fit into the submission queue with one system call
+		// and wait for them to complete. messages are referenced by pSendQueue until
+		// the kernel is done with them
+		int next = 0;
+		while(next < count || pSendsInFlight > 0){
+			while(next < count){
+				io_uring_sqe * const sqe = pGetSqe();
+				if(!sqe){
+					break;
+				}
+				
+				sqe->opcode = IORING_OP_SENDMSG;
+				sqe->fd = pSocket;
+				sqe->addr = (__u64)(uintptr_t)&pSendHeaders[next++];
+				sqe->len = 1;
+				sqe->user_data = vUserDataSend;
+				pSendsInFlight++;
+			}
+			
+			if(pEnter(pSendsInFlight > 0 ? 1 : 0, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR){
+				// closing the ring cancels pending requests before the messages are released
+				const int error = errno;
+				pCloseRing();
+				
+				std::stringstream s;
+				s << "io_uring_enter failed: " << strerror(error) << " (" << error << ")";
+				throw std::runtime_error(s.str());
+			}
+			pReapCompletions();
+		}
+		
+	}catch(...){
+		pSendQueue.clear();
+		throw;
+	}
+	
+	pSendQueue.clear();
+}
+
+bool denSocketUring::WaitForDatagram(float timeout){
+	if(pRingFd == -1){
+		return denSocketUnix::WaitForDatagram(timeout);
+	}
+	
+	if(pReceivedPosition < pReceived.size()){
+		return true;
+	}
+	
+	if(!pReceiveArmed){
+		pArmReceive();
+	}
+	
+	// the completion queue replaces the epoll set since the multishot receive
+	// consumes the datagrams before the socket becomes readable
+	if(__atomic_load_n(pCqTail, __ATOMIC_ACQUIRE) != *pCqHead){
+		return true;
+	}
+	
+	__kernel_timespec ts;
+	if(timeout >= 0.0f){
+		ts.tv_sec = (long long)timeout;
+		ts.tv_nsec = (long long)((timeout - (float)ts.tv_sec) * 1e9f);
+	}
+	
+	__atomic_store_n(pSqTail, pSqLocalTail, __ATOMIC_RELEASE);
+	const unsigned int toSubmit = pSqLocalTail - __atomic_load_n(pSqHead, __ATOMIC_ACQUIRE);
+	
+	if(fUringWait(pRingFd, toSubmit, timeout >= 0.0f ? &ts : nullptr) < 0){
+		const int error = errno;
+		if(error == ETIME || error == EINTR){
+			return false;
+		}
+		
+		std::stringstream s;
+		s << "io_uring_enter failed: " << strerror(error) << " (" << error << ")";
+		throw std::runtime_error(s.str());
+	}
+	
+	return __atomic_load_n(pCqTail, __ATOMIC_ACQUIRE) != *pCqHead;
+}
+
+bool denSocketUring::PrepareWait(intptr_t &handle){
+	if(pRingFd == -1){
+		return denSocketUnix::PrepareWait(handle);
+	}
+	
+	if(pReceivedPosition < pReceived.size()
+	|| __atomic_load_n(pCqTail, __ATOMIC_ACQUIRE) != *pCqHead){
+		handle = -1;
+		return true;
+	}
+	
+	// the ring becomes readable once completions are pending. submit the receive first
+	if(!pReceiveArmed){
+		pArmReceive();
+	}
+	if(pEnter(0, 0) < 0){
+		const int error = errno;
+		if(error != EINTR){
+			std::stringstream s;
+			s << "io_uring_enter failed: " << strerror(error) << " (" << error << ")";
+			throw std::runtime_error(s.str());
+		}
+	}
+	
+	handle = pRingFd;
+	return false;
+}
+
+bool denSocketUring::IsSupported(){
+	// initialization of local statics is thread safe. probes only once
+	static const bool supported = fUringProbe();
+	return supported;
+}
+
+
+
+bool denSocketUring::pSetupRing(){
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	
+	pRingFd = fUringSetup(vRingEntries, params);
+	if(pRingFd == -1){
+		return false;
+	}
+	
+	// map rings
+	pSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	pCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	
+	if((params.features & IORING_FEAT_SINGLE_MMAP) != 0){
+		pSqRingSize = pCqRingSize = std::max(pSqRingSize, pCqRingSize);
+	}
+	
+	pSqRing = mmap(nullptr, pSqRingSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, pRingFd, IORING_OFF_SQ_RING);
+	if(pSqRing == MAP_FAILED){
+		return false;
+	}
+	
+	if((params.features & IORING_FEAT_SINGLE_MMAP) != 0){
+		pCqRing = pSqRing;
+		
+	}else{
+		pCqRing = mmap(nullptr, pCqRingSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, pRingFd, IORING_OFF_CQ_RING);
+		if(pCqRing == MAP_FAILED){
+			return false;
+		}
+	}
+	
+	pSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	pSqes = (io_uring_sqe*)mmap(nullptr, pSqesSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, pRingFd, IORING_OFF_SQES);
+	if(pSqes == MAP_FAILED){
+		return false;
+	}
+	
+	uint8_t * const sq = (uint8_t*)pSqRing;
+	pSqHead = (unsigned int*)(sq + params.sq_off.head);
+	pSqTail = (unsigned int*)(sq + params.sq_off.tail);
+	pSqArray = (unsigned int*)(sq + params.sq_off.array);
+	pSqMask = *(unsigned int*)(sq + params.sq_off.ring_mask);
+	pSqEntries = *(unsigned int*)(sq + params.sq_off.ring_entries);
+	pSqLocalTail = *pSqTail;
+	
+	uint8_t * const cq = (uint8_t*)pCqRing;
+	pCqHead = (unsigned int*)(cq + params.cq_off.head);
+	pCqTail = (unsigned int*)(cq + params.cq_off.tail);
+	pCqMask = *(unsigned int*)(cq + params.cq_off.ring_mask);
+	pCqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+	
+	// register receive buffer ring. each buffer holds the recvmsg header, the
+	// source address and a maximum size datagram
+	pBufferCount = vReceiveBufferCount;
+	pBufRingSize = pBufferCount * sizeof(io_uring_buf);
+	pBufRing = (io_uring_buf_ring*)mmap(nullptr, pBufRingSize, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(pBufRing == MAP_FAILED){
+		return false;
+	}
+	
+	pBufferStride = (sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_storage)
+		+ sizeof(ControlBuffer::buffer) + pBufferLen + 63) & ~(size_t)63;
+	pBuffersSize = pBufferStride * pBufferCount;
+	pBuffers = (uint8_t*)mmap(nullptr, pBuffersSize, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(pBuffers == MAP_FAILED){
+		return false;
+	}
+	
+	io_uring_buf_reg bufReg;
+	memset(&bufReg, 0, sizeof(bufReg));
+	bufReg.ring_addr = (__u64)(uintptr_t)pBufRing;
+	bufReg.ring_entries = pBufferCount;
+	bufReg.bgid = vBufferGroup;
+	if(fUringRegister(pRingFd, IORING_REGISTER_PBUF_RING, &bufReg, 1) != 0){
+		return false;
+	}
+	
+	pBufRingTail = 0;
+	unsigned int i;
+	for(i=0; i<pBufferCount; i++){
+		pRecycleBuffer((int)i);
+	}
+	
+	pReceiveHeader.msg_namelen = sizeof(sockaddr_storage);
+	pReceiveHeader.msg_controllen = pReceiveOffload || pReceiveTimestamps || pReceiveDropCounter
+		? sizeof(ControlBuffer::buffer) : 0;
+	return true;
+}
+
+void denSocketUring::pCloseRing(){
+	if(pRingFd != -1){
+		close(pRingFd);
+		pRingFd = -1;
+	}
+	
+	if(pSqes != MAP_FAILED){
+		munmap(pSqes, pSqesSize);
+		pSqes = (io_uring_sqe*)MAP_FAILED;
+	}
+	if(pCqRing != MAP_FAILED && pCqRing != pSqRing){
+		munmap(pCqRing, pCqRingSize);
+	}
+	pCqRing = MAP_FAILED;
+	if(pSqRing != MAP_FAILED){
+		munmap(pSqRing, pSqRingSize);
+		pSqRing = MAP_FAILED;
+	}
+	
+	if(pBufRing != MAP_FAILED){
+		munmap(pBufRing, pBufRingSize);
+		pBufRing = (io_uring_buf_ring*)MAP_FAILED;
+	}
+	if(pBuffers != MAP_FAILED){
+		munmap(pBuffers, pBuffersSize);
+		pBuffers = (uint8_t*)MAP_FAILED;
+	}
+	
+	pReceiveArmed = false;
+	pSendsInFlight = 0;
+}
+
+io_uring_sqe *denSocketUring::pGetSqe(){
+	const unsigned int head = __atomic_load_n(pSqHead, __ATOMIC_ACQUIRE);
+	if(pSqLocalTail - head >= pSqEntries){
+		return nullptr;
+	}
+	
+	const unsigned int index = pSqLocalTail & pSqMask;
+	io_uring_sqe * const sqe = pSqes + index;
+	memset(sqe, 0, sizeof(io_uring_sqe));
+	pSqArray[index] = index;
+	pSqLocalTail++;
+	return sqe;
+}
+
+int denSocketUring::pEnter(unsigned int minComplete, unsigned int flags){
+	__atomic_store_n(pSqTail, pSqLocalTail, __ATOMIC_RELEASE);
+	const unsigned int toSubmit = pSqLocalTail - __atomic_load_n(pSqHead, __ATOMIC_ACQUIRE);
+	return fUringEnter(pRingFd, toSubmit, minComplete, flags);
+}
+
+bool denSocketUring::pArmReceive(){
+	io_uring_sqe * const sqe = pGetSqe();
+	if(!sqe){
+		return false;
+	}
+	
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = pSocket;
+	sqe->addr = (__u64)(uintptr_t)&pReceiveHeader;
+	sqe->len = 1;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = vBufferGroup;
+	sqe->user_data = vUserDataReceive;
+	
+	pReceiveArmed = true;
+	return true;
+}
+
+void denSocketUring::pReapCompletions(){
+	unsigned int head = *pCqHead;
+	const unsigned int tail = __atomic_load_n(pCqTail, __ATOMIC_ACQUIRE);
+	if(head == tail){
+		return;
+	}
+	
+	const ReceiveClock clock(pSampleReceiveClock());
+	
+	while(head != tail){
+		const io_uring_cqe &cqe = pCqes[head & pCqMask];
+		
+		switch(cqe.user_data){
+		case vUserDataReceive:
+			pProcessReceive(cqe, clock);
+			break;
+			
+		case vUserDataSend:
+			// send errors are ignored the same way as for sendto
+			pSendsInFlight--;
+			break;
+			
+		default:
+			break;
+		}
+		
+		head++;
+	}
+	
+	__atomic_store_n(pCqHead, head, __ATOMIC_RELEASE);
+}
+
+void denSocketUring::pProcessReceive(const io_uring_cqe &cqe, const ReceiveClock &clock){
+	if((cqe.flags & IORING_CQE_F_MORE) == 0){
+		pReceiveArmed = false; // multishot terminated. has to be armed again
+	}
+	
+	if(cqe.res < 0){
+		// ENOBUFS happens if all buffers are in use. receiving is armed again
+		// once buffers have been recycled. anything else is unsupported
+		if(cqe.res != -ENOBUFS){
+			pReceiveFailed = true;
+		}
+		return;
+	}
+	
+	if((cqe.flags & IORING_CQE_F_BUFFER) == 0){
+		return;
+	}
+	
+	const int index = (int)(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+	uint8_t * const buffer = pBuffers + pBufferStride * index;
+	const io_uring_recvmsg_out &out = *(const io_uring_recvmsg_out*)buffer;
+	const size_t headerLength = sizeof(io_uring_recvmsg_out)
+		+ pReceiveHeader.msg_namelen + pReceiveHeader.msg_controllen;
+	
+	if((size_t)cqe.res >= headerLength && out.payloadlen > 0 && (out.flags & MSG_TRUNC) == 0){
+		try{
+			const sockaddr_storage &name = *(const sockaddr_storage*)(buffer + sizeof(io_uring_recvmsg_out));
+			const denSocketAddress address(pAddressFromStorage(name));
+			if(pConnected && !(address == pRemoteAddress)){
+				// received before the socket has been connected
+				pRecycleBuffer(index);
+				return;
+			}
+			
+			int segmentSize = 0;
+			denMessage::Timestamp timestamp(clock.now);
+			if(out.controllen > 0){
+				msghdr control;
+				memset(&control, 0, sizeof(control));
+				control.msg_control = buffer + sizeof(io_uring_recvmsg_out) + pReceiveHeader.msg_namelen;
+				control.msg_controllen = out.controllen;
+				if(pReceiveOffload){
+					segmentSize = pSegmentSizeFromControl(control);
+				}
+				pUpdateDropCounter(control);
+				timestamp = pTimestampFromControl(control, clock);
+			}
+			
+			pAppendSegments(pReceived, buffer + headerLength, out.payloadlen, segmentSize, address, timestamp);
+			
+		}catch(const std::exception &){
+			// drop datagram with unsupported source address
+		}
+	}
+	
+	pRecycleBuffer(index);
+}
+
+void denSocketUring::pRecycleBuffer(int index){
+	// the ring tail overlaps the first buffer entry. the entries are addressed
+	// directly since the flexible array member in the kernel header is placed
+	// after the tail if compiled as C++
+	io_uring_buf &buffer = ((io_uring_buf*)pBufRing)[pBufRingTail & (pBufferCount - 1)];
+	buffer.addr = (__u64)(uintptr_t)(pBuffers + pBufferStride * index);
+	buffer.len = (__u32)pBufferStride;
+	buffer.bid = (__u16)index;
+	
+	pBufRingTail++;
+	__atomic_store_n(&pBufRing->tail, pBufRingTail, __ATOMIC_RELEASE);
+}
+
+#endif
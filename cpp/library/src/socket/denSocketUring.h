@@ -0,0 +1,135 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "../config.h"
+
+#if defined OS_UNIX && defined __linux__ && defined __has_include
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef IORING_RECV_MULTISHOT
+#define DEN_WITH_IO_URING 1
+#endif
+#endif
+#endif
+
+#ifdef DEN_WITH_IO_URING
+
+#include "denSocketUnix.h"
+
+/**
+ * \brief Socket using io_uring.
+ * 
+ * Keeps a multishot receive armed on the socket receiving into a registered buffer ring
+ * and submits queued datagrams with a single system call. Falls back to the behavior of
+ * denSocketUnix if the kernel does not support the required io_uring features.
+ */
+class denSocketUring : public denSocketUnix{
+public:
+	/** \brief Shared pointer. */
+	typedef std::shared_ptr<denSocketUring> Ref;
+	
+	/** \brief Create socket. */
+	denSocketUring();
+	
+	/** \brief Clean up socket. */
+	virtual ~denSocketUring() noexcept;
+	
+	/** \brief Bind socket to stored address. */
+	virtual void Bind();
+	
+	/** \brief Receive datagram from socket. */
+	virtual denMessage::Ref ReceiveDatagram(denSocketAddress &address);
+	
+	/** \brief Receive up to maxCount datagrams from socket. */
+	virtual int ReceiveDatagrams(Datagrams &datagrams, int maxCount);
+	
+	/** \brief Send all queued datagrams. */
+	virtual void FlushDatagrams();
+	
+	/** \brief Wait until datagrams are pending or timeout elapsed. */
+	virtual bool WaitForDatagram(float timeout);
+	
+	/** \brief Prepare waiting on multiple sockets together. */
+	virtual bool PrepareWait(intptr_t &handle);
+	
+	/** \brief io_uring is used. False if socket fell back to denSocketUnix behavior. */
+	inline bool GetUringActive() const{ return pRingFd != -1; }
+	
+	/** \brief Kernel supports io_uring. */
+	static bool IsSupported();
+	
+private:
+	bool pSetupRing();
+	void pCloseRing();
+	io_uring_sqe *pGetSqe();
+	int pEnter(unsigned int minComplete, unsigned int flags);
+	bool pArmReceive();
+	void pReapCompletions();
+	void pProcessReceive(const io_uring_cqe &cqe, const ReceiveClock &clock);
+	void pRecycleBuffer(int index);
+	
+	int pRingFd;
+	
+	void *pSqRing;
+	size_t pSqRingSize;
+	void *pCqRing;
+	size_t pCqRingSize;
+	io_uring_sqe *pSqes;
+	size_t pSqesSize;
+	
+	unsigned int *pSqHead;
+	unsigned int *pSqTail;
+	unsigned int *pSqArray;
+	unsigned int pSqMask;
+	unsigned int pSqEntries;
+	unsigned int pSqLocalTail;
+	
+	unsigned int *pCqHead;
+	unsigned int *pCqTail;
+	unsigned int pCqMask;
+	io_uring_cqe *pCqes;
+	
+	io_uring_buf_ring *pBufRing;
+	size_t pBufRingSize;
+	uint8_t *pBuffers;
+	size_t pBuffersSize;
+	size_t pBufferStride;
+	unsigned int pBufferCount;
+	unsigned short pBufRingTail;
+	
+	msghdr pReceiveHeader;
+	bool pReceiveArmed;
+	bool pReceiveFailed;
+	Datagrams pReceived;
+	size_t pReceivedPosition;
+	
+	std::vector<msghdr> pSendHeaders;
+	std::vector<iovec> pSendVectors;
+	std::vector<sockaddr_storage> pSendAddresses;
+	int pSendsInFlight;
+};
+
+#endif
@@ -0,0 +1,288 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+#include <errno.h>
+#include "denSocketWaitSet.h"
+
+#ifdef OS_UNIX
+#include <unistd.h>
+#include <sys/epoll.h>
+#elif defined OS_W32
+#include <WinSock2.h>
+#else
+#include <sys/poll.h>
+#endif
+
+// interval sockets without wait handle are checked in
+static const float vPollInterval = 0.001f;
+
+#ifdef OS_UNIX
+static const int vMaxEvents = 16;
+#endif
+
+
+denSocketWaitSet::denSocketWaitSet()
+#ifdef OS_UNIX
+: pEpoll(-1)
+#endif
+{
+}
+
+denSocketWaitSet::~denSocketWaitSet() noexcept{
+	Clear();
+}
+
+bool denSocketWaitSet::Wait(const std::vector<denSocket::Ref> &sockets, float timeout){
+	if(sockets.empty()){
+		return false;
+	}
+	
+	const std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+	
+	// waiting can end early without datagrams pending, for example if interrupted by
+	// io_uring completions. sockets are prepared again until the timeout elapsed
+	while(true){
+		pEntries.clear();
+		pPolledSockets.clear();
+		
+		std::vector<denSocket::Ref>::const_iterator iter;
+		for(iter = sockets.cbegin(); iter != sockets.cend(); iter++){
+			intptr_t handle;
+			if((*iter)->PrepareWait(handle)){
+				return true;
+			}
+			
+			if(handle == -1){
+				pPolledSockets.push_back(iter->get());
+				
+			}else{
+				pEntries.push_back({*iter, handle});
+			}
+		}
+		
+		float wait = -1.0f;
+		if(timeout >= 0.0f){
+			wait = timeout - std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+			if(wait < 0.0f){
+				wait = 0.0f;
+			}
+		}
+		
+		if(pEntries.empty() && pPolledSockets.size() == 1){
+			return pPolledSockets.front()->WaitForDatagram(wait);
+		}
+		
+		std::vector<denSocket*>::const_iterator iterPolled;
+		for(iterPolled = pPolledSockets.cbegin(); iterPolled != pPolledSockets.cend(); iterPolled++){
+			if((*iterPolled)->WaitForDatagram(0.0f)){
+				return true;
+			}
+		}
+		
+		if(wait == 0.0f){
+			return pEntries.empty() ? false : pWaitHandles(0.0f);
+		}
+		
+		if(!pPolledSockets.empty() && (wait < 0.0f || wait > vPollInterval)){
+			wait = vPollInterval;
+		}
+		
+		if(pEntries.empty()){
+			pPolledSockets.front()->WaitForDatagram(wait);
+			
+		}else if(pWaitHandles(wait)){
+			return true;
+		}
+	}
+}
+
+void denSocketWaitSet::Clear(){
+#ifdef OS_UNIX
+	if(pEpoll != -1){
+		close(pEpoll);
+		pEpoll = -1;
+	}
+	pRegistered.clear();
+#endif
+	pEntries.clear();
+	pPolledSockets.clear();
+}
+
+
+
+#ifdef OS_UNIX
+
+bool denSocketWaitSet::pWaitHandles(float timeout){
+	pUpdateEpoll();
+	
+	const int timeoutMs = timeout < 0.0f ? -1 : (int)std::ceil(timeout * 1000.0f);
+	epoll_event events[vMaxEvents];
+	const int result = epoll_wait(pEpoll, events, vMaxEvents, timeoutMs);
+	
+	if(result == -1){
+		const int error = errno;
+		if(error == EINTR){
+			return false;
+		}
+		
+		std::stringstream s;
+		s << "epoll_wait failed: " << strerror(error) << " (" << error << ")";
+		throw std::runtime_error(s.str());
+	}
+	
+	return result > 0;
+}
+
+void denSocketWaitSet::pUpdateEpoll(){
+	if(pEpoll == -1){
+		pEpoll = epoll_create1(EPOLL_CLOEXEC);
+		if(pEpoll == -1){
+			const int error = errno;
+			std::stringstream s;
+			s << "epoll_create1 failed: " << strerror(error) << " (" << error << ")";
+			throw std::runtime_error(s.str());
+		}
+	}
+	
+	// entries are compared sorted by socket. registered entries keep their socket alive
+	// so the handle can not be closed and reused while registered
+	const auto compare = [](const Entry &a, const Entry &b){
+		return a.socket.get() < b.socket.get();
+	};
+	std::sort(pEntries.begin(), pEntries.end(), compare);
+	
+	if(pEntries.size() == pRegistered.size() && std::equal(pEntries.cbegin(), pEntries.cend(),
+	pRegistered.cbegin(), [](const Entry &a, const Entry &b){
+		return a.socket == b.socket && a.handle == b.handle;
+	})){
+		return;
+	}
+	
+	std::vector<Entry>::const_iterator iterNew(pEntries.cbegin());
+	std::vector<Entry>::const_iterator iterOld(pRegistered.cbegin());
+	
+	while(iterNew != pEntries.cend() || iterOld != pRegistered.cend()){
+		const bool add = iterOld == pRegistered.cend()
+			|| (iterNew != pEntries.cend() && compare(*iterNew, *iterOld));
+		const bool remove = iterNew == pEntries.cend()
+			|| (iterOld != pRegistered.cend() && compare(*iterOld, *iterNew));
+		const bool changed = !add && !remove && iterNew->handle != iterOld->handle;
+		
+		if(remove || changed){
+			// fails if the handle has been closed already which removes it from the set
+			epoll_ctl(pEpoll, EPOLL_CTL_DEL, (int)iterOld->handle, nullptr);
+		}
+		
+		if(add || changed){
+			epoll_event event;
+			memset(&event, 0, sizeof(event));
+			event.events = EPOLLIN;
+			event.data.fd = (int)iterNew->handle;
+			if(epoll_ctl(pEpoll, EPOLL_CTL_ADD, (int)iterNew->handle, &event) == -1
+			&& (errno != EEXIST || epoll_ctl(pEpoll, EPOLL_CTL_MOD, (int)iterNew->handle, &event) == -1)){
+				const int error = errno;
+				pRegistered.clear();
+				close(pEpoll);
+				pEpoll = -1;
+				std::stringstream s;
+				s << "epoll_ctl failed: " << strerror(error) << " (" << error << ")";
+				throw std::runtime_error(s.str());
+			}
+		}
+		
+		if(!remove){
+			iterNew++;
+		}
+		if(!add){
+			iterOld++;
+		}
+	}
+	
+	pRegistered = pEntries;
+}
+
+#elif defined OS_W32
+
+bool denSocketWaitSet::pWaitHandles(float timeout){
+	// fd_set is limited to FD_SETSIZE sockets. allocate a larger set with the same layout
+	std::vector<SOCKET> storage(pEntries.size() + 1);
+	fd_set * const fds = (fd_set*)storage.data();
+	fds->fd_count = 0;
+	
+	std::vector<Entry>::const_iterator iter;
+	for(iter = pEntries.cbegin(); iter != pEntries.cend(); iter++){
+		fds->fd_array[fds->fd_count++] = (SOCKET)iter->handle;
+	}
+	
+	TIMEVAL tv;
+	if(timeout >= 0.0f){
+		tv.tv_sec = (long)timeout;
+		tv.tv_usec = (long)((timeout - (float)tv.tv_sec) * 1e6f);
+	}
+	
+	const int result = select(0, fds, nullptr, nullptr, timeout >= 0.0f ? &tv : nullptr);
+	if(result == SOCKET_ERROR){
+		std::stringstream s;
+		s << "select failed: " << WSAGetLastError();
+		throw std::runtime_error(s.str());
+	}
+	
+	return result > 0;
+}
+
+#else
+
+bool denSocketWaitSet::pWaitHandles(float timeout){
+	std::vector<pollfd> fds(pEntries.size());
+	size_t i;
+	for(i=0; i<pEntries.size(); i++){
+		fds[i].fd = (int)pEntries[i].handle;
+		fds[i].events = POLLIN;
+		fds[i].revents = 0;
+	}
+	
+	const int timeoutMs = timeout < 0.0f ? -1 : (int)std::ceil(timeout * 1000.0f);
+	const int result = poll(fds.data(), (nfds_t)fds.size(), timeoutMs);
+	
+	if(result == -1){
+		const int error = errno;
+		if(error == EINTR){
+			return false;
+		}
+		
+		std::stringstream s;
+		s << "poll failed: " << strerror(error) << " (" << error << ")";
+		throw std::runtime_error(s.str());
+	}
+	
+	return result > 0;
+}
+
+#endif
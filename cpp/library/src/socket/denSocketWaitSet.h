@@ -0,0 +1,83 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 DragonDreams (info@dragondreams.ch)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "../config.h"
+#include "denSocket.h"
+
+/**
+ * \brief Wait on multiple sockets at the same time.
+ * 
+ * Blocks until any of the sockets has datagrams pending or the timeout elapsed. On Unix
+ * the handles of the sockets are kept registered in an epoll set across waits. Only
+ * sockets added or removed since the last wait cause system calls. On Windows select is
+ * used over all sockets.
+ * 
+ * Sockets without wait handle, like in-process memory sockets and impairment wrappers,
+ * can not be waited on by the operating system. While such sockets are present they are
+ * checked every millisecond while waiting on the other sockets.
+ * 
+ * Not thread safe. Use one wait set per waiting thread.
+ */
+class denSocketWaitSet{
+public:
+	/** \brief Create wait set. */
+	denSocketWaitSet();
+	
+	/** \brief Clean up wait set. */
+	~denSocketWaitSet() noexcept;
+	
+	/**
+	 * \brief Wait until datagrams are pending on any socket or timeout elapsed.
+	 * \param[in] sockets Sockets to wait on.
+	 * \param[in] timeout Timeout in seconds. Negative value waits without timeout.
+	 * \returns true if datagrams are pending or false if timeout elapsed.
+	 */
+	bool Wait(const std::vector<denSocket::Ref> &sockets, float timeout);
+	
+	/** \brief Unregister all sockets. */
+	void Clear();
+	
+	
+private:
+	struct Entry{
+		denSocket::Ref socket;
+		intptr_t handle;
+	};
+	
+	bool pWaitHandles(float timeout);
+	
+	std::vector<Entry> pEntries;
+	std::vector<denSocket*> pPolledSockets;
+	
+#ifdef OS_UNIX
+	void pUpdateEpoll();
+	
+	int pEpoll;
+	std::vector<Entry> pRegistered;
+#endif
+};
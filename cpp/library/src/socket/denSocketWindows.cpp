@@ -45,7 +45,6 @@ pBufferLen(65535)
 {
 	pWSAStartup();
 	pWSAStarted = true;
-	pBuffer.assign(pBufferLen, 0);
 }
 
 denSocketWindows::~denSocketWindows() noexcept{
@@ -66,6 +65,9 @@ void denSocketWindows::Bind(){
 	if(pSocket != -1){
 		throw std::runtime_error("socket already bound");
 	}
+	if(pReusePort){
+		throw std::runtime_error("reuse port not supported");
+	}
 	
 	if(pAddress.type == denSocketAddress::Type::ipv6){
 		pSocket = socket(PF_INET6, SOCK_DGRAM, 0);
@@ -110,6 +112,55 @@ void denSocketWindows::Bind(){
 		}
 		pAddress = AddressFromSocket(sa);
 	}
+	
+	pApplyBufferSizes();
+}
+
+void denSocketWindows::Connect(const denSocketAddress &address){
+	if(pSocket == -1){
+		throw std::runtime_error("socket not bound");
+	}
+	
+	if(pAddress.type == denSocketAddress::Type::ipv6){
+		sockaddr_in6 sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sin6_family = AF_INET6;
+		SocketFromAddress(address, sa);
+		if(connect(pSocket, (SOCKADDR*)&sa, sizeof(sa)) == SOCKET_ERROR){
+			pThrowWSAError("connect failed");
+		}
+		
+	}else{
+		sockaddr_in sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sin_family = AF_INET;
+		SocketFromAddress(address, sa);
+		if(connect(pSocket, (SOCKADDR*)&sa, sizeof(sa)) == SOCKET_ERROR){
+			pThrowWSAError("connect failed");
+		}
+	}
+	
+	// datagrams received before connecting can be from any address. drop them like
+	// lost datagrams since received datagrams are now assumed to be from the remote
+	char buffer[1];
+	while(true){
+		fd_set fd;
+		FD_ZERO(&fd);
+		FD_SET(pSocket, &fd);
+		
+		TIMEVAL tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = 0;
+		
+		if(select(0, &fd, nullptr, nullptr, &tv) != 1){
+			break;
+		}
+		if(recv(pSocket, buffer, sizeof(buffer), 0) == SOCKET_ERROR && WSAGetLastError() != WSAEMSGSIZE){
+			break;
+		}
+	}
+	
+	denSocket::Connect(address);
 }
 
 denMessage::Ref denSocketWindows::ReceiveDatagram(denSocketAddress &address){
@@ -122,13 +173,29 @@ denMessage::Ref denSocketWindows::ReceiveDatagram(denSocketAddress &address){
 	tv.tv_usec = 0;
 
 	if(select(0, &fd, nullptr, nullptr, &tv) == 1){
-		const denMessage::Ref message(denMessage::Pool().Get());
-		std::string &data = message->Item().GetData();
+		// receive directly into the message data
+		const denMessage::Ref message(denMessage::ReceivePool().Get());
+		message->Item().SetLength(pBufferLen);
+		char * const data = (char*)message->Item().GetData().c_str();
 		
-		if(pAddress.type == denSocketAddress::Type::ipv6){
+		if(pConnected){
+			const int result = recv(pSocket, data, pBufferLen, 0);
+			
+			if(result == SOCKET_ERROR){
+				pThrowWSAError("recv failed");
+			}
+			
+			if(result > 0){
+				address = pRemoteAddress;
+				message->Item().SetLength(result);
+				message->Item().SetTimestamp(denMessage::Clock::now());
+				return message;
+			} // connection closed returns 0 length
+			
+		}else if(pAddress.type == denSocketAddress::Type::ipv6){
 			sockaddr_in6 sa;
 			int slen = sizeof(sa);
-			const int result = recvfrom(pSocket, (char*)pBuffer.c_str(), pBufferLen, 0, (SOCKADDR*)&sa, &slen);
+			const int result = recvfrom(pSocket, data, pBufferLen, 0, (SOCKADDR*)&sa, &slen);
 		
 			if(result == SOCKET_ERROR){
 				pThrowWSAError("recvfrom failed");
@@ -136,18 +203,15 @@ denMessage::Ref denSocketWindows::ReceiveDatagram(denSocketAddress &address){
 			
 			if(result > 0){
 				address = AddressFromSocket(sa);
-				if(data.size() < (std::size_t)result){
-					data.assign(result, 0);
-				}
-				pBuffer.copy((char*)data.c_str(), result, 0);
 				message->Item().SetLength(result);
+				message->Item().SetTimestamp(denMessage::Clock::now());
 				return message;
 			} // connection closed returns 0 length
 			
 		}else{
 			sockaddr_in sa;
 			int slen = sizeof(sa);
-			const int result = recvfrom(pSocket, (char*)pBuffer.c_str(), pBufferLen, 0, (SOCKADDR*)&sa, &slen);
+			const int result = recvfrom(pSocket, data, pBufferLen, 0, (SOCKADDR*)&sa, &slen);
 		
 			if(result == SOCKET_ERROR){
 				pThrowWSAError("recvfrom failed");
@@ -155,11 +219,8 @@ denMessage::Ref denSocketWindows::ReceiveDatagram(denSocketAddress &address){
 			
 			if(result > 0){
 				address = AddressFromSocket(sa);
-				if(data.size() < (std::size_t)result){
-					data.assign(result, 0);
-				}
-				pBuffer.copy((char*)data.c_str(), result, 0);
 				message->Item().SetLength(result);
+				message->Item().SetTimestamp(denMessage::Clock::now());
 				return message;
 			} // connection closed returns 0 length
 		}
@@ -176,7 +237,10 @@ void denSocketWindows::SendDatagram(const denMessage &message, const denSocketAd
 		throw std::runtime_error(s.str());
 	}
 	
-	if(pAddress.type == denSocketAddress::Type::ipv6){
+	if(pConnected && address == pRemoteAddress){
+		send(pSocket, (char*)message.GetData().c_str(), (int)message.GetLength(), 0);
+		
+	}else if(pAddress.type == denSocketAddress::Type::ipv6){
 		sockaddr_in6 sa;
 		memset(&sa, 0, sizeof(sa));
 		sa.sin6_family = AF_INET6;
@@ -194,6 +258,135 @@ void denSocketWindows::SendDatagram(const denMessage &message, const denSocketAd
 	}
 }
 
+bool denSocketWindows::SendProbeDatagram(const denMessage &message, const denSocketAddress &address){
+	if(message.GetLength() > 65500){
+		std::stringstream s;
+		s << "SendProbeDatagram: message size too long: " << message.GetLength() << " (max 65500)";
+		throw std::runtime_error(s.str());
+	}
+	
+	// fragmentation is disabled only while sending the probe
+	const bool ipv6 = pAddress.type == denSocketAddress::Type::ipv6;
+	const int level = ipv6 ? IPPROTO_IPV6 : IPPROTO_IP;
+	const int option = ipv6 ? IPV6_DONTFRAG : IP_DONTFRAGMENT;
+	
+	DWORD dontFragment = 1;
+	if(setsockopt(pSocket, level, option, (const char*)&dontFragment, sizeof(dontFragment))){
+		pThrowWSAError("setsockopt(IP_DONTFRAGMENT)");
+	}
+	
+	int result;
+	if(pConnected && address == pRemoteAddress){
+		result = send(pSocket, (char*)message.GetData().c_str(), (int)message.GetLength(), 0);
+		
+	}else if(ipv6){
+		sockaddr_in6 sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sin6_family = AF_INET6;
+		SocketFromAddress(address, sa);
+		
+		result = sendto(pSocket, (char*)message.GetData().c_str(), (int)message.GetLength(), 0, (SOCKADDR*)&sa, sizeof(sa));
+		
+	}else{
+		sockaddr_in sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sin_family = AF_INET;
+		SocketFromAddress(address, sa);
+		
+		result = sendto(pSocket, (char*)message.GetData().c_str(), (int)message.GetLength(), 0, (SOCKADDR*)&sa, sizeof(sa));
+	}
+	const int sendError = result == SOCKET_ERROR ? WSAGetLastError() : 0;
+	
+	dontFragment = 0;
+	setsockopt(pSocket, level, option, (const char*)&dontFragment, sizeof(dontFragment));
+	
+	return sendError != WSAEMSGSIZE;
+}
+
+void denSocketWindows::FlushDatagrams(){
+	if(pSendQueue.empty()){
+		return;
+	}
+	
+	sockaddr_in6 sa6;
+	sockaddr_in sa4;
+	WSABUF buffers[2];
+	DWORD sent;
+	
+	QueuedDatagrams::const_iterator iter;
+	for(iter = pSendQueue.cbegin(); iter != pSendQueue.cend(); iter++){
+		buffers[0].buf = (char*)iter->header;
+		buffers[0].len = (ULONG)iter->headerLength;
+		buffers[1].buf = (char*)iter->GetPayload();
+		buffers[1].len = (ULONG)iter->length;
+		
+		if(pConnected && iter->address == pRemoteAddress){
+			WSASend(pSocket, buffers, 2, &sent, 0, nullptr, nullptr);
+			
+		}else if(pAddress.type == denSocketAddress::Type::ipv6){
+			memset(&sa6, 0, sizeof(sa6));
+			sa6.sin6_family = AF_INET6;
+			SocketFromAddress(iter->address, sa6);
+			WSASendTo(pSocket, buffers, 2, &sent, 0, (SOCKADDR*)&sa6, sizeof(sa6), nullptr, nullptr);
+			
+		}else{
+			memset(&sa4, 0, sizeof(sa4));
+			sa4.sin_family = AF_INET;
+			SocketFromAddress(iter->address, sa4);
+			WSASendTo(pSocket, buffers, 2, &sent, 0, (SOCKADDR*)&sa4, sizeof(sa4), nullptr, nullptr);
+		}
+	}
+	
+	pSendQueue.clear();
+}
+
+void denSocketWindows::pApplyBufferSizes(){
+	if(pReceiveBufferSize > 0 && setsockopt(pSocket, SOL_SOCKET, SO_RCVBUF,
+	(const char*)&pReceiveBufferSize, sizeof(pReceiveBufferSize))){
+		pThrowWSAError("setsockopt(SO_RCVBUF) failed");
+	}
+	
+	if(pSendBufferSize > 0 && setsockopt(pSocket, SOL_SOCKET, SO_SNDBUF,
+	(const char*)&pSendBufferSize, sizeof(pSendBufferSize))){
+		pThrowWSAError("setsockopt(SO_SNDBUF) failed");
+	}
+	
+	int size;
+	int length = sizeof(size);
+	if(getsockopt(pSocket, SOL_SOCKET, SO_RCVBUF, (char*)&size, &length) == 0){
+		pReceiveBufferSize = size;
+	}
+	
+	length = sizeof(size);
+	if(getsockopt(pSocket, SOL_SOCKET, SO_SNDBUF, (char*)&size, &length) == 0){
+		pSendBufferSize = size;
+	}
+}
+
+bool denSocketWindows::WaitForDatagram(float timeout){
+	fd_set fd;
+	FD_ZERO(&fd);
+	FD_SET(pSocket, &fd);
+	
+	TIMEVAL tv;
+	if(timeout >= 0.0f){
+		tv.tv_sec = (long)timeout;
+		tv.tv_usec = (long)((timeout - (float)tv.tv_sec) * 1e6f);
+	}
+	
+	const int result = select(0, &fd, nullptr, nullptr, timeout >= 0.0f ? &tv : nullptr);
+	if(result == SOCKET_ERROR){
+		pThrowWSAError("select failed");
+	}
+	
+	return result > 0;
+}
+
+bool denSocketWindows::PrepareWait(intptr_t &handle){
+	handle = (intptr_t)pSocket;
+	return false;
+}
+
 denSocketAddress denSocketWindows::ResolveAddress(const std::string &address){
 	if(address.empty()){
 		throw std::invalid_argument("address is empty");
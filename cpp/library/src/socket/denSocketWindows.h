@@ -50,12 +50,27 @@ public:
 	/** \brief Bind socket to stored address. */
 	virtual void Bind();
 	
+	/** \brief Connect socket to remote address. */
+	virtual void Connect(const denSocketAddress &address);
+	
 	/** \brief Receive datagram from socket. */
 	virtual denMessage::Ref ReceiveDatagram(denSocketAddress &address);
 	
 	/** \brief Send datagram. */
 	virtual void SendDatagram(const denMessage &message, const denSocketAddress &address);
 	
+	/** \brief Send path MTU probe datagram with the don't fragment flag set. */
+	virtual bool SendProbeDatagram(const denMessage &message, const denSocketAddress &address);
+	
+	/** \brief Send all queued datagrams using WSASendTo with header and payload buffers. */
+	virtual void FlushDatagrams();
+	
+	/** \brief Wait until datagrams are pending or timeout elapsed. */
+	virtual bool WaitForDatagram(float timeout);
+	
+	/** \brief Prepare waiting on multiple sockets together. */
+	virtual bool PrepareWait(intptr_t &handle);
+	
 	/** \brief Resolve IPv4 address */
 	static denSocketAddress ResolveAddress(const std::string &address);
 	
@@ -74,6 +89,7 @@ protected:
 	
 private:
 	static uint32_t pScopeIdFor(const sockaddr_in6 &address);
+	void pApplyBufferSizes();
 	static void pThrowErrno(const char *message);
 	static void pThrowWSAError(const char *message);
 	static void pWSAStartup();
@@ -82,7 +98,6 @@ private:
 private:
 	SOCKET pSocket;
 	bool pWSAStarted;
-	std::string pBuffer;
 	int pBufferLen;
 
 	static int pWSAStartedCount;
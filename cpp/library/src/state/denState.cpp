@@ -29,7 +29,9 @@
 #include "../message/denMessageWriter.h"
 
 denState::denState(bool readOnly) :
-pReadOnly(readOnly){
+pReadOnly(readOnly),
+pValuesVersion(1),
+pSnapshotVersion(0){
 }
 
 denState::~denState() noexcept{
@@ -57,6 +59,8 @@ void denState::AddValue(const denValue::Ref &value){
 	}
 	
 	pValues.push_back(value);
+	pEncodedValues.push_back({std::string(), false});
+	pValuesVersion++;
 	
 	value->pState = this;
 	value->pIndex = pValues.size() - 1;
@@ -69,7 +73,9 @@ void denState::RemoveValue(const denValue::Ref &value){
 	}
 	
 	(*iter)->pState = nullptr;
+	pEncodedValues.erase(pEncodedValues.begin() + (iter - pValues.begin()));
 	pValues.erase(iter);
+	pValuesVersion++;
 	
 	size_t index = 0;
 	for(iter = pValues.begin(); iter != pValues.end(); iter++){
@@ -149,12 +155,8 @@ void denState::LinkWriteValues(denMessageWriter &writer){
 }
 
 void denState::LinkWriteValuesWithVerify(denMessageWriter &writer){
-	writer.WriteUShort((uint16_t)pValues.size());
-	Values::const_iterator iter;
-	for(iter = pValues.cbegin(); iter != pValues.cend(); iter++){
-		writer.WriteByte((uint8_t)(*iter)->GetDataType());
-		(*iter)->Write(writer);
-	}
+	const std::string &snapshot = pGetSnapshot();
+	writer.Write(snapshot.c_str(), snapshot.size());
 }
 
 void denState::LinkWriteValues(denMessageWriter &writer, denStateLink &link){
@@ -169,13 +171,25 @@ void denState::LinkWriteValues(denMessageWriter &writer, denStateLink &link){
 	
 	writer.WriteByte((uint8_t)changedCount);
 	
+	// states linked to multiple connections encode each changed value only once
+	const bool encoded = pLinks.size() > 1;
+	if(encoded){
+		pEncodeChangedValues(link);
+	}
+	
 	for(i=0; i<count; i++){
 		if(!link.GetValueChangedAt(i)){
 			continue;
 		}
 		
 		writer.WriteUShort((uint16_t)i);
-		pValues[i]->Write(writer);
+		if(encoded){
+			const std::string &data = pEncodedValues[i].data;
+			writer.Write(data.c_str(), data.size());
+			
+		}else{
+			pValues[i]->Write(writer);
+		}
 		
 		link.SetValueChangedAt(i, false);
 		
@@ -189,6 +203,8 @@ void denState::LinkWriteValues(denMessageWriter &writer, denStateLink &link){
 }
 
 void denState::InvalidateValueAt(size_t index){
+	pValuesChanged(index);
+	
 	StateLinks::const_iterator iter;
 	for(iter = pLinks.cbegin(); iter != pLinks.cend(); iter++){
 		(*iter)->SetValueChangedAt(index, true);
@@ -196,6 +212,8 @@ void denState::InvalidateValueAt(size_t index){
 }
 
 void denState::InvalidateValueAtExcept(size_t index, denStateLink &link){
+	pValuesChanged(index);
+	
 	StateLinks::const_iterator iter;
 	for(iter = pLinks.cbegin(); iter != pLinks.cend(); iter++){
 		(*iter)->SetValueChangedAt(index, iter->get() != &link);
@@ -203,7 +221,66 @@ void denState::InvalidateValueAtExcept(size_t index, denStateLink &link){
 }
 
 void denState::ValueChanged(denValue &value){
+	// values changing less than the threshold are not synchronized but are written with
+	// the next change. the encoded value has to match what the value writes
+	pValuesChanged(value.pIndex);
+	
 	if(value.UpdateValue(false)){
 		InvalidateValueAt(value.pIndex);
 	}
 }
+
+void denState::pEncodeChangedValues(const denStateLink &link){
+	// links of the same state are written in parallel by server serialize threads
+	const std::lock_guard<std::mutex> guard(pMutexEncode);
+	
+	const size_t count = pValues.size();
+	denMessage::Ref message;
+	size_t i;
+	
+	for(i=0; i<count; i++){
+		EncodedValue &encoded = pEncodedValues[i];
+		if(encoded.valid || !link.GetValueChangedAt(i)){
+			continue;
+		}
+		
+		if(!message){
+			message = denMessage::Pool().Get();
+		}
+		
+		{
+		denMessageWriter writer(message->Item());
+		pValues[i]->Write(writer);
+		}
+		
+		encoded.data.assign(message->Item().GetData(), 0, message->Item().GetLength());
+		encoded.valid = true;
+	}
+}
+
+const std::string &denState::pGetSnapshot(){
+	const std::lock_guard<std::mutex> guard(pMutexEncode);
+	
+	if(pSnapshotVersion != pValuesVersion){
+		const denMessage::Ref message(denMessage::Pool().Get());
+		{
+		denMessageWriter writer(message->Item());
+		writer.WriteUShort((uint16_t)pValues.size());
+		Values::const_iterator iter;
+		for(iter = pValues.cbegin(); iter != pValues.cend(); iter++){
+			writer.WriteByte((uint8_t)(*iter)->GetDataType());
+			(*iter)->Write(writer);
+		}
+		}
+		
+		pSnapshot.assign(message->Item().GetData(), 0, message->Item().GetLength());
+		pSnapshotVersion = pValuesVersion;
+	}
+	
+	return pSnapshot;
+}
+
+void denState::pValuesChanged(size_t index){
+	pEncodedValues[index].valid = false;
+	pValuesVersion++;
+}
@@ -27,6 +27,9 @@
 #include <memory>
 #include <vector>
 #include <list>
+#include <mutex>
+#include <stdint.h>
+#include <string>
 #include "../config.h"
 #include "denStateLink.h"
 #include "../denLogger.h"
@@ -88,11 +91,23 @@ public:
 	virtual void RemoteValueChanged(denValue &value);
 	
 private:
+	/** \brief Encoded value shared by all links writing the value. */
+	struct EncodedValue{
+		std::string data;
+		bool valid;
+	};
+	
 	Values pValues;
 	StateLinks pLinks;
 	bool pReadOnly;
 	denLogger::Ref pLogger;
 	
+	std::vector<EncodedValue> pEncodedValues;
+	uint64_t pValuesVersion;
+	std::string pSnapshot;
+	uint64_t pSnapshotVersion;
+	std::mutex pMutexEncode;
+	
 	friend denConnection;
 	StateLinks::iterator FindLink(denStateLink *link);
 	
@@ -141,4 +156,23 @@ private:
 	void InvalidateValueAtExcept(size_t index, denStateLink &link);
 	
 	void ValueChanged(denValue &value);
+	
+	/**
+	 * \brief Encode changed values not encoded yet.
+	 * 
+	 * Links of states linked to multiple connections write the encoded values instead
+	 * of encoding the same value once per link. Encoded values stay valid until the
+	 * value changes.
+	 */
+	void pEncodeChangedValues(const denStateLink &link);
+	
+	/**
+	 * \brief Snapshot of all values including types.
+	 * 
+	 * Linking the state to multiple connections encodes the values only once. The
+	 * snapshot is encoded again if values changed since the last snapshot.
+	 */
+	const std::string &pGetSnapshot();
+	
+	void pValuesChanged(size_t index);
 };